@@ -0,0 +1,75 @@
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <variant>
+
+#include <lsm/core.hpp>
+#include <lsm/cosm.hpp>
+
+#include "harness.hpp"
+
+namespace
+{
+
+enum class S { A, B };
+struct Go {};
+using Input = std::variant<Go>;
+using Machine = lsm::CoMachine<S, Input, int>;
+
+// dispatch_async on a transition with `effects` effects that complete
+// synchronously, so the numbers are the adapter and task overhead alone.
+lsm_bench::Body dispatch_async(int effects)
+{
+    struct Fixture
+    {
+        Machine machine;
+        lsm::co::Adapter<Machine> adapter;
+
+        explicit Fixture(Machine m) : machine(std::move(m)), adapter(machine) {}
+    };
+
+    Machine::Builder builder;
+    builder.set_initial(S::A);
+    builder.on<Go>(S::A, S::B);
+    builder.on<Go>(S::B, S::A);
+    auto fixture = std::make_unique<Fixture>(std::move(builder).build({}));
+    for(int e = 0; e < effects; ++e)
+    {
+        for(auto [from, to] : {std::pair{S::A, S::B}, std::pair{S::B, S::A}})
+        {
+            fixture->adapter.bind_async(from, to, [](const Input&, std::monostate&, lsm::co::CancelToken, auto&) -> lsm::co::Task<std::optional<int>> {
+                co_return 1;
+            });
+        }
+    }
+    return [fixture = std::move(fixture)](std::uint64_t iterations) mutable {
+        const Input go{Go{}};
+        for(std::uint64_t i = 0; i < iterations; ++i)
+        {
+            auto task = fixture->adapter.dispatch_async(go);
+            task.await_suspend(std::noop_coroutine()).resume();
+            lsm_bench::do_not_optimize(task.await_resume());
+        }
+    };
+}
+
+lsm_bench::Registrar no_effect{"dispatch_async/effects/0", [] { return dispatch_async(0); }};
+lsm_bench::Registrar one_effect{"dispatch_async/effects/1", [] { return dispatch_async(1); }};
+lsm_bench::Registrar four_effects{"dispatch_async/effects/4", [] { return dispatch_async(4); }};
+
+// The synchronous path for comparison.
+lsm_bench::Registrar sync_dispatch{"dispatch_async/sync_baseline", [] {
+    Machine::Builder builder;
+    builder.set_initial(S::A);
+    builder.on<Go>(S::A, S::B);
+    builder.on<Go>(S::B, S::A);
+    auto machine = std::move(builder).build({});
+    return lsm_bench::Body{[machine = std::move(machine)](std::uint64_t iterations) mutable {
+        const Input go{Go{}};
+        for(std::uint64_t i = 0; i < iterations; ++i) lsm_bench::do_not_optimize(machine.dispatch(go));
+    }};
+}};
+
+} // namespace
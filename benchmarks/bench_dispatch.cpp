@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+
+#include "harness.hpp"
+
+namespace
+{
+
+enum class S { A, B };
+
+// --- transitions per state --------------------------------------------------
+// N guarded transitions leave each state on the same event; the one that
+// matches is tried last, so this measures the cost of walking a route.
+
+struct Ping {};
+using PingInput = std::variant<Ping>;
+struct Key
+{
+    int key = 0;
+};
+using Guarded = lsm::Machine<S, PingInput, int, Key>;
+
+lsm_bench::Body transitions_per_state(int n)
+{
+    Guarded::Builder builder;
+    builder.set_initial(S::A);
+    for(int i = 0; i < n; ++i)
+    {
+        auto guard = [i](const PingInput&, const Key& ctx) { return ctx.key == i; };
+        builder.from(S::A).on<Ping>().guard(guard).to(S::B);
+        builder.from(S::B).on<Ping>().guard(guard).to(S::A);
+    }
+    auto machine = std::move(builder).build(Key{n - 1});
+    return [machine = std::move(machine)](std::uint64_t iterations) mutable {
+        const PingInput ping{Ping{}};
+        for(std::uint64_t i = 0; i < iterations; ++i) lsm_bench::do_not_optimize(machine.dispatch(ping));
+    };
+}
+
+lsm_bench::Registrar transitions_1{"dispatch/transitions_per_state/1", [] { return transitions_per_state(1); }};
+lsm_bench::Registrar transitions_10{"dispatch/transitions_per_state/10", [] { return transitions_per_state(10); }};
+lsm_bench::Registrar transitions_100{"dispatch/transitions_per_state/100", [] { return transitions_per_state(100); }};
+
+// --- wide variant -----------------------------------------------------------
+
+template <std::size_t I>
+struct Ev
+{
+};
+
+template <std::size_t... I>
+auto wide_variant(std::index_sequence<I...>) -> std::variant<Ev<I>...>;
+
+constexpr std::size_t wide = 64;
+using WideInput = decltype(wide_variant(std::make_index_sequence<wide>{}));
+using Wide = lsm::Machine<S, WideInput, int>;
+
+template <std::size_t... I>
+void add_wide(Wide::Builder& builder, std::index_sequence<I...>)
+{
+    (builder.on<Ev<I>>(S::A, S::A), ...);
+}
+
+template <std::size_t... I>
+std::array<WideInput, wide> wide_inputs(std::index_sequence<I...>)
+{
+    return {WideInput{Ev<I>{}}...};
+}
+
+lsm_bench::Registrar wide_variant_64{"dispatch/wide_variant/64", [] {
+    Wide::Builder builder;
+    builder.set_initial(S::A);
+    add_wide(builder, std::make_index_sequence<wide>{});
+    auto machine = std::move(builder).build({});
+    return lsm_bench::Body{[machine = std::move(machine), inputs = wide_inputs(std::make_index_sequence<wide>{})](std::uint64_t iterations) mutable {
+        for(std::uint64_t i = 0; i < iterations; ++i) lsm_bench::do_not_optimize(machine.dispatch(inputs[i % wide]));
+    }};
+}};
+
+// --- value-matched inputs ---------------------------------------------------
+
+using ValueInput = std::variant<int>;
+using Valued = lsm::Machine<S, ValueInput, int>;
+
+lsm_bench::Registrar value_match_16{"dispatch/value_match/16", [] {
+    Valued::Builder builder;
+    builder.set_initial(S::A);
+    for(int v = 0; v < 16; ++v) builder.from(S::A).on_value(ValueInput{v}).to(S::A);
+    auto machine = std::move(builder).build({});
+    return lsm_bench::Body{[machine = std::move(machine)](std::uint64_t iterations) mutable {
+        const ValueInput last{15};
+        for(std::uint64_t i = 0; i < iterations; ++i) lsm_bench::do_not_optimize(machine.dispatch(last));
+    }};
+}};
+
+// --- any-state fallback -----------------------------------------------------
+
+struct Other {};
+using FallbackInput = std::variant<Ping, Other>;
+using Fallback = lsm::Machine<S, FallbackInput, int>;
+
+lsm_bench::Registrar any_state{"dispatch/any_state_fallback", [] {
+    Fallback::Builder builder;
+    builder.set_initial(S::A);
+    builder.on<Ping>(S::A, S::B);
+    builder.on<Ping>(S::B, S::A);
+    builder.any().on<Other>().to(S::A);
+    auto machine = std::move(builder).build({});
+    return lsm_bench::Body{[machine = std::move(machine)](std::uint64_t iterations) mutable {
+        const FallbackInput other{Other{}};
+        for(std::uint64_t i = 0; i < iterations; ++i) lsm_bench::do_not_optimize(machine.dispatch(other));
+    }};
+}};
+
+// --- completion chains ------------------------------------------------------
+// One dispatch enters C1, then completions walk C1 -> ... -> C8 -> C0.
+
+enum class Chain { C0, C1, C2, C3, C4, C5, C6, C7, C8 };
+using Chained = lsm::Machine<Chain, PingInput, int>;
+
+lsm_bench::Registrar completion_chain_8{"dispatch/completion_chain/8", [] {
+    Chained::Builder builder;
+    builder.set_initial(Chain::C0);
+    builder.on<Ping>(Chain::C0, Chain::C1);
+    for(int c = 1; c <= 8; ++c) builder.completion(static_cast<Chain>(c)).to(static_cast<Chain>((c + 1) % 9));
+    auto machine = std::move(builder).build({});
+    return lsm_bench::Body{[machine = std::move(machine)](std::uint64_t iterations) mutable {
+        const PingInput ping{Ping{}};
+        for(std::uint64_t i = 0; i < iterations; ++i) lsm_bench::do_not_optimize(machine.dispatch(ping));
+    }};
+}};
+
+// --- hierarchical states ----------------------------------------------------
+// Eight leaves cycle on Ping; Other returns to L0. Nested declares Other once on
+// the leaves' parent, Flat repeats it on every leaf. An enter hook on L0 keeps
+// the hook path in the measurement.
+
+enum class Tree { Group, L0, L1, L2, L3, L4, L5, L6, L7 };
+using TreeInput = std::variant<Ping, Other>;
+using Nested = lsm::Machine<Tree, TreeInput, int, int>;
+
+template <bool Hierarchical>
+lsm_bench::Body leaves_of_8()
+{
+    Nested::Builder builder;
+    builder.set_initial(Tree::L0);
+    for(int i = 1; i <= 8; ++i)
+    {
+        const auto leaf = static_cast<Tree>(i);
+        builder.on<Ping>(leaf, static_cast<Tree>(i % 8 + 1));
+        if constexpr(Hierarchical)
+            builder.set_parent(leaf, Tree::Group);
+        else
+            builder.on<Other>(leaf, Tree::L0);
+    }
+    if constexpr(Hierarchical) builder.on<Other>(Tree::Group, Tree::L0);
+    builder.on_enter(Tree::L0, [](int& ctx, const Tree&, const Tree&, const TreeInput*) { ++ctx; });
+    auto machine = std::move(builder).build(0);
+    return [machine = std::move(machine)](std::uint64_t iterations) mutable {
+        const std::array<TreeInput, 4> inputs{TreeInput{Ping{}}, TreeInput{Ping{}}, TreeInput{Ping{}}, TreeInput{Other{}}};
+        for(std::uint64_t i = 0; i < iterations; ++i) lsm_bench::do_not_optimize(machine.dispatch(inputs[i % 4]));
+    };
+}
+
+lsm_bench::Registrar hierarchy_nested{"dispatch/hierarchy/nested", [] { return leaves_of_8<true>(); }};
+lsm_bench::Registrar hierarchy_flat{"dispatch/hierarchy/flat", [] { return leaves_of_8<false>(); }};
+
+// --- deferral replay --------------------------------------------------------
+// Each dispatch defers the input into B and replays it there.
+
+using Deferring = lsm::Machine<S, PingInput, int>;
+
+lsm_bench::Registrar deferral{"dispatch/deferral_replay", [] {
+    Deferring::Builder builder;
+    builder.set_initial(S::A);
+    builder.enable_deferral(true);
+    builder.from(S::A).on<Ping>().defer(true).to(S::B);
+    builder.on<Ping>(S::B, S::A);
+    auto machine = std::move(builder).build({});
+    return lsm_bench::Body{[machine = std::move(machine)](std::uint64_t iterations) mutable {
+        const PingInput ping{Ping{}};
+        for(std::uint64_t i = 0; i < iterations; ++i) lsm_bench::do_not_optimize(machine.dispatch(ping));
+    }};
+}};
+
+// --- dispatch_all drains ----------------------------------------------------
+// Reported per input: batches of 64 are queued and drained into a sink.
+
+using Draining = lsm::Machine<S, PingInput, int>;
+
+lsm_bench::Registrar drain_64{"dispatch_all/drain_batch/64", [] {
+    Draining::Builder builder;
+    builder.set_initial(S::A);
+    builder.on<Ping>(S::A, S::B, [](const Ping&, std::monostate&) -> std::optional<int> { return 1; });
+    builder.on<Ping>(S::B, S::A, [](const Ping&, std::monostate&) -> std::optional<int> { return 2; });
+    auto machine = std::move(builder).build({});
+    return lsm_bench::Body{[machine = std::move(machine)](std::uint64_t iterations) mutable {
+        const PingInput ping{Ping{}};
+        std::uint64_t sum = 0;
+        auto sink = [&sum](int&& out) { sum += static_cast<std::uint64_t>(out); };
+        for(std::uint64_t done = 0; done < iterations;)
+        {
+            const auto batch = std::min<std::uint64_t>(64, iterations - done);
+            for(std::uint64_t i = 0; i < batch; ++i) machine.enqueue(ping);
+            machine.dispatch_all(sink);
+            done += batch;
+        }
+        lsm_bench::do_not_optimize(sum);
+    }};
+}};
+
+// --- dispatch_batch ---------------------------------------------------------
+// Reported per input, against the same machine driven by dispatch() in a loop.
+
+template <bool Batch>
+lsm_bench::Body batch_of_256()
+{
+    Draining::Builder builder;
+    builder.set_initial(S::A);
+    builder.on<Ping>(S::A, S::B, [](const Ping&, std::monostate&) -> std::optional<int> { return 1; });
+    builder.on<Ping>(S::B, S::A, [](const Ping&, std::monostate&) -> std::optional<int> { return 2; });
+    auto machine = std::move(builder).build({});
+    return [machine = std::move(machine), inputs = std::vector<PingInput>(256)](std::uint64_t iterations) mutable {
+        std::uint64_t sum = 0;
+        auto sink = [&sum](int&& out) { sum += static_cast<std::uint64_t>(out); };
+        for(std::uint64_t done = 0; done < iterations;)
+        {
+            const auto batch = std::span<const PingInput>(inputs).first(std::min<std::uint64_t>(256, iterations - done));
+            if constexpr(Batch)
+            {
+                machine.dispatch_batch(batch, sink);
+            }
+            else
+            {
+                for(const auto& in : batch)
+                {
+                    if(auto out = machine.dispatch(in)) sink(std::move(*out));
+                }
+            }
+            done += batch.size();
+        }
+        lsm_bench::do_not_optimize(sum);
+    };
+}
+
+lsm_bench::Registrar batch_256{"dispatch_batch/256", [] { return batch_of_256<true>(); }};
+lsm_bench::Registrar loop_256{"dispatch_batch/loop_256", [] { return batch_of_256<false>(); }};
+
+} // namespace
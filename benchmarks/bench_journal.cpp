@@ -0,0 +1,65 @@
+#include <cstdint>
+#include <memory>
+#include <variant>
+
+#include <lsm/core.hpp>
+#include <lsm/journal.hpp>
+
+#include "harness.hpp"
+
+namespace
+{
+
+enum class S { A, B };
+struct Ping
+{
+    std::uint32_t id = 0;
+};
+using Input = std::variant<Ping>;
+using Machine = lsm::Machine<S, Input, int>;
+
+std::shared_ptr<const Machine::Definition> definition()
+{
+    Machine::Builder builder;
+    builder.set_initial(S::A);
+    builder.on<Ping>(S::A, S::B);
+    builder.on<Ping>(S::B, S::A);
+    return std::move(builder).build_definition();
+}
+
+// Journaled dispatch into an in-memory log; the log is reset every 64k
+// entries so the numbers reflect framing and checksumming, not reallocation.
+lsm_bench::Registrar journal_dispatch{"journal/dispatch", [] {
+    struct Fixture
+    {
+        Machine machine{definition()};
+        lsm::journal::MemoryLog log;
+        lsm::journal::Journal<Machine, lsm::journal::MemoryLog> journal{machine, log};
+    };
+    auto fixture = std::make_unique<Fixture>();
+    return lsm_bench::Body{[fixture = std::move(fixture)](std::uint64_t iterations) mutable {
+        for(std::uint64_t i = 0; i < iterations; ++i)
+        {
+            if((fixture->journal.sequence() & 0xFFFF) == 0xFFFF) fixture->log = {};
+            lsm_bench::do_not_optimize(fixture->journal.dispatch(Input{Ping{static_cast<std::uint32_t>(i)}}));
+        }
+    }};
+}};
+
+lsm_bench::Registrar journal_replay{"journal/replay", [] {
+    const auto def = definition();
+    Machine source(def);
+    lsm::journal::MemoryLog log;
+    lsm::journal::Journal<Machine, lsm::journal::MemoryLog> journal(source, log);
+    for(std::uint32_t i = 0; i < 4096; ++i) journal.dispatch(Input{Ping{i}});
+    auto machine = std::make_unique<Machine>(def);
+    return lsm_bench::Body{[machine = std::move(machine), log = std::move(log)](std::uint64_t iterations) mutable {
+        // Reported per entry.
+        for(std::uint64_t done = 0; done < iterations; done += 4096)
+        {
+            lsm_bench::do_not_optimize(lsm::journal::replay(*machine, log.contents()).applied);
+        }
+    }};
+}};
+
+} // namespace
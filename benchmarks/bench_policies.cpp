@@ -0,0 +1,129 @@
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <variant>
+
+#include <lsm/core.hpp>
+
+#include "harness.hpp"
+
+namespace
+{
+
+enum class S { A, B };
+struct Tick
+{
+    int value = 1;
+};
+using Input = std::variant<Tick>;
+
+struct Ctx
+{
+    std::uint64_t total = 0;
+};
+
+// --- effect policies --------------------------------------------------------
+// The same work, once returned as an output and once published.
+
+using Returning = lsm::Machine<S, Input, int, Ctx>;
+
+lsm_bench::Registrar return_output{"policy/effect/return_output", [] {
+    Returning::Builder builder;
+    builder.set_initial(S::A);
+    auto action = [](const Tick& tick, Ctx& ctx) -> std::optional<int> {
+        ctx.total += static_cast<std::uint64_t>(tick.value);
+        return tick.value;
+    };
+    builder.on<Tick>(S::A, S::B, action);
+    builder.on<Tick>(S::B, S::A, action);
+    auto machine = std::move(builder).build({});
+    return lsm_bench::Body{[machine = std::move(machine)](std::uint64_t iterations) mutable {
+        const Input tick{Tick{}};
+        for(std::uint64_t i = 0; i < iterations; ++i) lsm_bench::do_not_optimize(machine.dispatch(tick));
+    }};
+}};
+
+struct Sum
+{
+    std::uint64_t total = 0;
+    void publish(int value) noexcept
+    {
+        total += static_cast<std::uint64_t>(value);
+    }
+};
+
+using Publishing = lsm::Machine<S, Input, int, Ctx, lsm::policy::copy, lsm::policy::Publisher<Sum>>;
+
+lsm_bench::Registrar publisher{"policy/effect/publisher", [] {
+    Publishing::Builder builder;
+    builder.set_initial(S::A);
+    builder.set_publisher(Sum{});
+    auto action = [](const Tick& tick, Ctx& ctx, Sum& sum) {
+        ctx.total += static_cast<std::uint64_t>(tick.value);
+        sum.publish(tick.value);
+    };
+    builder.on<Tick>(S::A, S::B, action);
+    builder.on<Tick>(S::B, S::A, action);
+    auto machine = std::move(builder).build({});
+    return lsm_bench::Body{[machine = std::move(machine)](std::uint64_t iterations) mutable {
+        const Input tick{Tick{}};
+        for(std::uint64_t i = 0; i < iterations; ++i) machine.dispatch(tick);
+        lsm_bench::do_not_optimize(machine.publisher());
+    }};
+}};
+
+// --- callable policies ------------------------------------------------------
+// Guard and action capture 24 bytes, which fits every policy's inline buffer.
+
+template <class Policy>
+lsm_bench::Body callable_policy()
+{
+    using M = lsm::Machine<S, Input, int, Ctx, Policy>;
+    typename M::Builder builder;
+    builder.set_initial(S::A);
+    const std::array<int, 6> weights{1, 2, 3, 4, 5, 6};
+    for(auto [from, to] : {std::pair{S::A, S::B}, std::pair{S::B, S::A}})
+    {
+        builder.from(from)
+            .template on<Tick>()
+            .guard([weights](const Input&, const Ctx& ctx) { return ctx.total >= static_cast<std::uint64_t>(weights[0]) - 1; })
+            .action([weights](const Tick& tick, Ctx& ctx) -> std::optional<int> {
+                ctx.total += static_cast<std::uint64_t>(weights[5] * tick.value);
+                return weights[2];
+            })
+            .to(to);
+    }
+    auto machine = std::move(builder).build({});
+    return [machine = std::move(machine)](std::uint64_t iterations) mutable {
+        const Input tick{Tick{}};
+        for(std::uint64_t i = 0; i < iterations; ++i) lsm_bench::do_not_optimize(machine.dispatch(tick));
+    };
+}
+
+lsm_bench::Registrar policy_copy{"policy/callable/copy", [] { return callable_policy<lsm::policy::copy>(); }};
+lsm_bench::Registrar policy_move{"policy/callable/move", [] { return callable_policy<lsm::policy::move>(); }};
+lsm_bench::Registrar policy_inplace{"policy/callable/inplace<32>", [] { return callable_policy<lsm::policy::inplace<32>>(); }};
+
+// --- metrics policies -------------------------------------------------------
+
+template <class Metrics>
+lsm_bench::Body metrics_policy()
+{
+    using M = lsm::Machine<S, Input, int, Ctx, lsm::policy::copy, lsm::policy::ReturnOutput<int>, lsm::policy::deque_queue, Metrics>;
+    typename M::Builder builder;
+    builder.set_initial(S::A);
+    builder.template on<Tick>(S::A, S::B);
+    builder.template on<Tick>(S::B, S::A);
+    auto machine = std::move(builder).build({});
+    return [machine = std::move(machine)](std::uint64_t iterations) mutable {
+        const Input tick{Tick{}};
+        for(std::uint64_t i = 0; i < iterations; ++i) lsm_bench::do_not_optimize(machine.dispatch(tick));
+    };
+}
+
+lsm_bench::Registrar no_metrics{"policy/metrics/none", [] { return metrics_policy<lsm::policy::no_metrics>(); }};
+lsm_bench::Registrar counters{"policy/metrics/counters", [] { return metrics_policy<lsm::policy::metrics>(); }};
+lsm_bench::Registrar latency{"policy/metrics/latency", [] { return metrics_policy<lsm::policy::latency_metrics>(); }};
+
+} // namespace
@@ -0,0 +1,63 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+#include <lsm/pool.hpp>
+
+#include "harness.hpp"
+
+namespace
+{
+
+enum class S { A, B, C, D };
+struct Tick {};
+using Input = std::variant<Tick>;
+struct Device
+{
+    std::uint32_t id = 0;
+};
+using Machine = lsm::Machine<S, Input, int, Device>;
+
+constexpr std::size_t fleet = 65536;
+
+// A ring of four states advanced by Tick with nothing else to run, so a
+// broadcast is one table gather per device. Reported per device.
+std::shared_ptr<const Machine::Definition> definition()
+{
+    Machine::Builder builder;
+    builder.set_initial(S::A);
+    builder.on<Tick>(S::A, S::B);
+    builder.on<Tick>(S::B, S::C);
+    builder.on<Tick>(S::C, S::D);
+    builder.on<Tick>(S::D, S::A);
+    return std::move(builder).build_definition();
+}
+
+lsm_bench::Registrar pool_broadcast{"pool/broadcast/65536", [] {
+    auto pool = std::make_unique<lsm::MachinePool<Machine>>(definition());
+    pool->reserve(fleet);
+    for(std::size_t i = 0; i < fleet; ++i) pool->add(Device{static_cast<std::uint32_t>(i)});
+    return lsm_bench::Body{[pool = std::move(pool)](std::uint64_t iterations) mutable {
+        for(std::uint64_t done = 0; done < iterations; done += fleet) pool->broadcast(Input{Tick{}});
+        lsm_bench::do_not_optimize(pool->slots().data());
+    }};
+}};
+
+lsm_bench::Registrar dispatch_loop{"pool/dispatch_loop/65536", [] {
+    const auto def = definition();
+    std::vector<Machine> machines;
+    machines.reserve(fleet);
+    for(std::size_t i = 0; i < fleet; ++i) machines.emplace_back(def, Device{static_cast<std::uint32_t>(i)});
+    return lsm_bench::Body{[machines = std::move(machines)](std::uint64_t iterations) mutable {
+        const Input tick{Tick{}};
+        for(std::uint64_t done = 0; done < iterations; done += fleet)
+        {
+            for(auto& machine : machines) lsm_bench::do_not_optimize(machine.dispatch(tick));
+        }
+    }};
+}};
+
+} // namespace
@@ -0,0 +1,62 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+
+#include "harness.hpp"
+
+namespace
+{
+
+enum class S { A, B };
+struct Ping {};
+using Input = std::variant<Ping>;
+struct Session
+{
+    std::uint64_t id = 0;
+    std::uint32_t hits = 0;
+};
+using Machine = lsm::Machine<S, Input, int, Session>;
+
+std::shared_ptr<const Machine::Definition> definition()
+{
+    Machine::Builder builder;
+    builder.set_initial(S::A);
+    builder.on<Ping>(S::A, S::B);
+    builder.on<Ping>(S::B, S::A);
+    return std::move(builder).build_definition();
+}
+
+// One machine with two queued inputs per op, written to and read back from
+// a shared buffer as a checkpoint of many sessions would be.
+lsm_bench::Registrar snapshot{"snapshot/write", [] {
+    auto machine = std::make_unique<Machine>(definition(), Session{7, 3});
+    machine->enqueue(Input{Ping{}});
+    machine->enqueue(Input{Ping{}});
+    return lsm_bench::Body{[machine = std::move(machine), blob = std::vector<std::byte>{}](std::uint64_t iterations) mutable {
+        for(std::uint64_t i = 0; i < iterations; ++i)
+        {
+            if(blob.size() > (1u << 20)) blob.clear();
+            lsm::SnapshotWriter out(blob);
+            machine->snapshot(out);
+        }
+        lsm_bench::do_not_optimize(blob.data());
+    }};
+}};
+
+lsm_bench::Registrar restore{"snapshot/restore", [] {
+    const auto def = definition();
+    Machine source(def, Session{7, 3});
+    source.enqueue(Input{Ping{}});
+    source.enqueue(Input{Ping{}});
+    auto machine = std::make_unique<Machine>(def);
+    return lsm_bench::Body{[machine = std::move(machine), blob = source.snapshot()](std::uint64_t iterations) mutable {
+        for(std::uint64_t i = 0; i < iterations; ++i) lsm_bench::do_not_optimize(machine->restore(blob));
+    }};
+}};
+
+} // namespace
@@ -0,0 +1,272 @@
+#include "harness.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <string_view>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define LSM_BENCH_PERF 1
+#endif
+
+namespace
+{
+
+std::atomic<std::uint64_t> allocations{0};
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc{};
+}
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    const auto alignment = static_cast<std::size_t>(align);
+#if defined(_WIN32)
+    // The Windows CRTs have no aligned_alloc; their aligned blocks need _aligned_free.
+    if(void* p = _aligned_malloc(size ? size : 1, alignment)) return p;
+#else
+    if(void* p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)) return p;
+#endif
+    throw std::bad_alloc{};
+}
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept
+{
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Retired user-space instructions via perf_event_open, when permitted.
+class InstructionCounter
+{
+public:
+    InstructionCounter()
+    {
+#ifdef LSM_BENCH_PERF
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+    ~InstructionCounter()
+    {
+#ifdef LSM_BENCH_PERF
+        if(fd_ >= 0) close(fd_);
+#endif
+    }
+    InstructionCounter(const InstructionCounter&) = delete;
+    InstructionCounter& operator=(const InstructionCounter&) = delete;
+
+    bool available() const noexcept
+    {
+        return fd_ >= 0;
+    }
+
+    void start() noexcept
+    {
+#ifdef LSM_BENCH_PERF
+        if(fd_ < 0) return;
+        ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    std::optional<std::uint64_t> stop() noexcept
+    {
+#ifdef LSM_BENCH_PERF
+        if(fd_ < 0) return std::nullopt;
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        std::uint64_t count = 0;
+        if(read(fd_, &count, sizeof(count)) == static_cast<ssize_t>(sizeof(count))) return count;
+#endif
+        return std::nullopt;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+struct Options
+{
+    std::string_view filter;
+    double min_time_ms = 100.0;
+    int repetitions = 5;
+    bool csv = false;
+};
+
+struct Measurement
+{
+    double median_ns = 0;
+    double min_ns = 0;
+    double allocs = 0;
+    std::optional<double> instructions;
+    std::uint64_t iterations = 0;
+};
+
+double elapsed_ns(Clock::time_point start, Clock::time_point stop)
+{
+    return std::chrono::duration<double, std::nano>(stop - start).count();
+}
+
+Measurement measure(lsm_bench::Body& body, const Options& options, InstructionCounter& counter)
+{
+    body(1); // warm caches, pools and lazily built state
+
+    // Grow the batch until one run takes a tenth of the budget, then size it
+    // to fill the budget.
+    std::uint64_t iterations = 1;
+    for(;;)
+    {
+        const auto start = Clock::now();
+        body(iterations);
+        const auto took = elapsed_ns(start, Clock::now());
+        if(took >= options.min_time_ms * 1e5 || iterations >= (std::uint64_t{1} << 40))
+        {
+            const auto scale = options.min_time_ms * 1e6 / std::max(took, 1.0);
+            iterations = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(static_cast<double>(iterations) * scale));
+            break;
+        }
+        iterations *= 10;
+    }
+
+    std::vector<double> per_op;
+    Measurement result;
+    result.iterations = iterations;
+    for(int rep = 0; rep < options.repetitions; ++rep)
+    {
+        const auto allocs_before = allocations.load(std::memory_order_relaxed);
+        counter.start();
+        const auto start = Clock::now();
+        body(iterations);
+        const auto stop = Clock::now();
+        const auto instructions = counter.stop();
+        const auto allocs = allocations.load(std::memory_order_relaxed) - allocs_before;
+
+        per_op.push_back(elapsed_ns(start, stop) / static_cast<double>(iterations));
+        if(rep == 0)
+        {
+            result.allocs = static_cast<double>(allocs) / static_cast<double>(iterations);
+            if(instructions) result.instructions = static_cast<double>(*instructions) / static_cast<double>(iterations);
+        }
+    }
+    std::sort(per_op.begin(), per_op.end());
+    result.median_ns = per_op[per_op.size() / 2];
+    result.min_ns = per_op.front();
+    return result;
+}
+
+void usage(const char* argv0)
+{
+    std::printf("usage: %s [--filter SUBSTR] [--min-time-ms MS] [--reps N] [--csv] [--list]\n", argv0);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    bool list = false;
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if(arg == "--filter" && has_value)
+            options.filter = argv[++i];
+        else if(arg == "--min-time-ms" && has_value)
+            options.min_time_ms = std::atof(argv[++i]);
+        else if(arg == "--reps" && has_value)
+            options.repetitions = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "--csv")
+            options.csv = true;
+        else if(arg == "--list")
+            list = true;
+        else
+        {
+            usage(argv[0]);
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    auto cases = lsm_bench::registry();
+    std::sort(cases.begin(), cases.end(), [](const auto& a, const auto& b) { return a.name < b.name; });
+
+    InstructionCounter counter;
+    if(options.csv)
+        std::printf("name,ns_per_op,min_ns_per_op,allocs_per_op,instructions_per_op,iterations\n");
+    else if(!list)
+        std::printf("%-44s %12s %12s %10s %12s\n", "benchmark", "ns/op", "min ns/op", "allocs/op", "instr/op");
+
+    for(auto& bench : cases)
+    {
+        if(!options.filter.empty() && bench.name.find(options.filter) == std::string::npos) continue;
+        if(list)
+        {
+            std::printf("%s\n", bench.name.c_str());
+            continue;
+        }
+        auto body = bench.factory();
+        const auto result = measure(body, options, counter);
+        if(options.csv)
+        {
+            std::printf("%s,%.3f,%.3f,%.3f,", bench.name.c_str(), result.median_ns, result.min_ns, result.allocs);
+            if(result.instructions) std::printf("%.1f", *result.instructions);
+            std::printf(",%llu\n", static_cast<unsigned long long>(result.iterations));
+        }
+        else
+        {
+            char instructions[32] = "-";
+            if(result.instructions) std::snprintf(instructions, sizeof(instructions), "%.1f", *result.instructions);
+            std::printf("%-44s %12.2f %12.2f %10.3f %12s\n", bench.name.c_str(), result.median_ns, result.min_ns, result.allocs, instructions);
+        }
+        std::fflush(stdout);
+    }
+    if(!list && !options.csv && !counter.available())
+        std::printf("(instruction counts unavailable: perf_event_open not permitted)\n");
+    return 0;
+}
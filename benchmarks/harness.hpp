@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal self-contained benchmark harness. A case registers a factory that
+// builds its fixture outside the timed region and returns the body; the
+// body runs the measured operation `iterations` times. The harness picks the
+// iteration count, repeats the run and reports ns/op, allocations/op and,
+// where the kernel allows it, retired instructions/op.
+namespace lsm_bench
+{
+
+using Body = std::move_only_function<void(std::uint64_t iterations)>;
+using Factory = std::function<Body()>;
+
+struct Case
+{
+    std::string name;
+    Factory factory;
+};
+
+inline std::vector<Case>& registry()
+{
+    static std::vector<Case> cases;
+    return cases;
+}
+
+struct Registrar
+{
+    Registrar(std::string name, Factory factory)
+    {
+        registry().push_back({std::move(name), std::move(factory)});
+    }
+};
+
+// Keeps `value` alive as far as the optimizer is concerned.
+template <class T>
+inline void do_not_optimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    const volatile auto* sink = &value;
+    (void)sink;
+#endif
+}
+
+} // namespace lsm_bench
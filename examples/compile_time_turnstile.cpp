@@ -0,0 +1,60 @@
+#include <iostream>
+#include <optional>
+#include <string>
+#include <variant>
+
+#include <lsm/ctsm.hpp>
+
+enum class State { Locked, Unlocked };
+struct Coin {};
+struct Push {};
+using Input = std::variant<Coin, Push>;
+using Output = std::string;
+
+struct Context {
+    int coins = 0;
+};
+
+struct Accept {
+    std::optional<Output> operator()(const Coin&, Context& ctx) const {
+        ++ctx.coins;
+        return std::optional<Output>{"coin accepted"};
+    }
+};
+
+struct Report {
+    void operator()(Context&, const State& state, const Input&) const {
+        std::cout << "unhandled in state=" << (state == State::Locked ? "Locked" : "Unlocked") << "\n";
+    }
+};
+
+using Table = lsm::ct::table<
+    lsm::ct::transition<State::Locked, Coin, State::Unlocked>::action<Accept>,
+    lsm::ct::transition<State::Unlocked, Push, State::Locked>::action<
+        lsm::ct::fn<[](const Push&, Context&) -> std::optional<Output> { return std::optional<Output>{"pass through"}; }>>,
+    lsm::ct::transition<State::Unlocked, Coin, State::Unlocked>::priority<1>::suppress_enter_exit::action<
+        lsm::ct::fn<[](const Coin&, Context&) -> std::optional<Output> { return std::optional<Output>{"already unlocked"}; }>>,
+    lsm::ct::any_unhandled<Report>>;
+
+using Machine = lsm::ct::Machine<State, Input, Output, Context, Table>;
+
+int main() {
+    Machine machine(State::Locked);
+
+    auto step = [&](const Input& in) {
+        if (auto out = machine.dispatch(in)) {
+            std::cout << *out << "\n";
+        }
+        std::cout << "state=" << (machine.state() == State::Locked ? "Locked" : "Unlocked")
+                  << " coins=" << machine.context().coins << "\n";
+    };
+
+    step(Input{Push{}});
+    step(Input{Coin{}});
+    step(Input{Push{}});
+    step(Input{Coin{}});
+    step(Input{Coin{}});
+    step(Input{Push{}});
+
+    return 0;
+}
@@ -61,12 +61,12 @@ int main() {
     Input start = Input{Start{}};
     auto task = adapter.dispatch_async(start);
     if (!task.await_ready()) {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
     cancel_source.request_stop();
     gate.resume();
     while (!task.await_ready()) {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
     bool cancelled = false;
     try {
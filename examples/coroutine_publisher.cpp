@@ -45,7 +45,7 @@ int main() {
 
     auto task = adapter.dispatch_async(Input{Start{}});
     while (!task.await_ready()) {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
     auto out = task.await_resume();
     if (out) {
@@ -43,7 +43,7 @@ int main() {
 
     auto task = adapter.dispatch_async(Input{Fetch{}});
     while (!task.await_ready()) {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
     auto result = task.await_resume();
     std::cout << "attempts=" << machine.context().attempts << " result="
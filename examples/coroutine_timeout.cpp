@@ -17,19 +17,10 @@ struct Context {
 
 using Machine = lsm::CoMachine<State, Input, Output, Context>;
 
-struct FakeTimer {
-    std::coroutine_handle<> handle{};
-    bool await_ready() const noexcept { return false; }
-    void await_suspend(std::coroutine_handle<> h) noexcept { handle = h; }
-    void await_resume() const noexcept {}
-    void fire() {
-        if (handle) {
-            auto resume = handle;
-            handle = {};
-            resume.resume();
-        }
-    }
-};
+static lsm::co::Task<std::string> slow_fetch(lsm::co::scheduler sched) {
+    co_await sched.sleep_for(std::chrono::milliseconds(200));
+    co_return "payload";
+}
 
 int main() {
     Machine::Builder builder;
@@ -41,26 +32,24 @@ int main() {
 
     lsm::co::CancelSource cancel_source;
     lsm::co::Adapter<Machine> adapter(machine, &cancel_source);
-    FakeTimer timer;
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
 
     adapter.bind_async(State::Idle, State::Active,
-        [&timer](const Input&, Context& ctx, lsm::co::CancelToken token, auto&) -> lsm::co::Task<std::optional<Output>> {
+        [sched, &cancel_source](const Input&, Context& ctx, lsm::co::CancelToken, auto&) -> lsm::co::Task<std::optional<Output>> {
             ctx.timed_out = false;
-            co_await timer;
-            if (token.stop_requested()) {
-                co_return std::optional<Output>{"cancelled"};
+            try {
+                auto body = co_await lsm::co::with_timeout(slow_fetch(sched), std::chrono::milliseconds(20), sched, &cancel_source);
+                co_return std::optional<Output>{body};
+            } catch (const lsm::co::timeout_error&) {
+                ctx.timed_out = true;
             }
-            ctx.timed_out = true;
             co_return std::optional<Output>{"timeout"};
         }
     );
 
     auto task = adapter.dispatch_async(Input{Start{}});
-    task.await_suspend(std::noop_coroutine());
-    timer.fire();
-    while (!task.await_ready()) {
-        task.await_suspend(std::noop_coroutine());
-    }
+    loop.run(task);
     auto out = task.await_resume();
     if (out) {
         std::cout << *out << "\n";
@@ -69,4 +58,3 @@ int main() {
 
     return 0;
 }
-
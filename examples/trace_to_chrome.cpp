@@ -0,0 +1,65 @@
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+#include <lsm/trace.hpp>
+
+// Decodes a binary trace dump into Chrome trace JSON on stdout:
+//   example_trace_to_chrome dump.lsmt > trace.json
+// Without arguments it traces a small turnstile and decodes that instead.
+
+enum class State { Locked, Unlocked };
+struct Coin {};
+struct Push {};
+using Input = std::variant<Coin, Push>;
+
+using Machine = lsm::Machine<State, Input>;
+
+static std::optional<lsm::trace::Dump> demo_dump() {
+    Machine::Builder builder;
+    builder.set_initial(State::Locked);
+    builder.on<Coin>(State::Locked, State::Unlocked);
+    builder.on<Push>(State::Unlocked, State::Locked);
+    Machine machine = std::move(builder).build({});
+
+    lsm::trace::Ring ring(64);
+    machine.set_trace(&ring);
+    for (int i = 0; i < 3; ++i) {
+        machine.dispatch(Input{Coin{}});
+        machine.dispatch(Input{Push{}});
+    }
+
+    const auto& index = machine.state_index();
+    std::vector<std::string_view> names(index.size());
+    auto name = [&](State state, std::string_view text) {
+        if (const auto slot = index.find(state); slot != Machine::StateIndex::npos) names[slot] = text;
+    };
+    name(State::Locked, "Locked");
+    name(State::Unlocked, "Unlocked");
+
+    std::stringstream bytes;
+    lsm::trace::write_dump(bytes, ring, names);
+    return lsm::trace::read_dump(bytes);
+}
+
+int main(int argc, char** argv) {
+    std::optional<lsm::trace::Dump> dump;
+    if (argc > 1) {
+        std::ifstream file(argv[1], std::ios::binary);
+        dump = lsm::trace::read_dump(file);
+    } else {
+        dump = demo_dump();
+    }
+    if (!dump) {
+        std::cerr << "not an lsm trace dump\n";
+        return 1;
+    }
+    lsm::trace::write_chrome_json(std::cout, *dump);
+    std::cout << "\n";
+    return 0;
+}
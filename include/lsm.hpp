@@ -2,3 +2,8 @@
 
 #include <lsm/core.hpp>
 #include <lsm/cosm.hpp>
+#include <lsm/ctsm.hpp>
+#include <lsm/journal.hpp>
+#include <lsm/pool.hpp>
+#include <lsm/runtime.hpp>
+#include <lsm/trace.hpp>
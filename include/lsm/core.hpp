@@ -14,7 +14,18 @@ template <typename State,
           typename Output = std::monostate,
           typename Context = std::monostate,
           typename CallablePolicy = policy::copy,
-          typename EffectPolicy = policy::ReturnOutput<Output>>
-using Machine = MachineImpl<State, Input, Output, Context, CallablePolicy, EffectPolicy>;
+          typename EffectPolicy = policy::ReturnOutput<Output>,
+          typename QueuePolicy = policy::deque_queue,
+          typename MetricsPolicy = policy::no_metrics>
+using Machine = MachineImpl<State, Input, Output, Context, CallablePolicy, EffectPolicy, QueuePolicy, MetricsPolicy>;
+
+// Latency data exported by machines built with policy::latency_metrics.
+using LatencyHistogram = detail::LatencyHistogram;
+using LatencySnapshot = detail::LatencySnapshot;
+
+// Byte streams and the default codec used by snapshot() and restore().
+using SnapshotWriter = detail::SnapshotWriter;
+using SnapshotReader = detail::SnapshotReader;
+using TrivialCodec = detail::TrivialCodec;
 
 } // namespace lsm
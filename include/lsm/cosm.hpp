@@ -1,22 +1,30 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <cassert>
 #include <chrono>
 #include <concepts>
 #include <coroutine>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <functional>
+#include <memory_resource>
 #include <optional>
+#include <span>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <variant>
 #include <vector>
 
+#include <lsm/detail/frame_pool.hpp>
 #include <lsm/detail/helpers.hpp>
 #include <lsm/detail/machine_impl.hpp>
 #include <lsm/detail/policy.hpp>
+#include <lsm/detail/timer_wheel.hpp>
 
 namespace lsm
 {
@@ -26,8 +34,10 @@ template <typename State,
           typename Output = std::monostate,
           typename Context = std::monostate,
           typename CallablePolicy = policy::copy,
-          typename EffectPolicy = policy::ReturnOutput<Output>>
-using CoMachine = MachineImpl<State, Input, Output, Context, CallablePolicy, EffectPolicy>;
+          typename EffectPolicy = policy::ReturnOutput<Output>,
+          typename QueuePolicy = policy::deque_queue,
+          typename MetricsPolicy = policy::no_metrics>
+using CoMachine = MachineImpl<State, Input, Output, Context, CallablePolicy, EffectPolicy, QueuePolicy, MetricsPolicy>;
 
 namespace co
 {
@@ -35,6 +45,28 @@ namespace co
 template <class T = void>
 class Task;
 
+// Routes the frames of coroutine tasks created on this thread to `resource`
+// while the scope is alive. Without a scope, frames come from a per-thread
+// pool of size-classed blocks. A frame is always returned to where it came
+// from, so `resource` must outlive every task created under the scope.
+class frame_resource_scope
+{
+public:
+    explicit frame_resource_scope(std::pmr::memory_resource* resource) noexcept
+        : previous_(std::exchange(detail::frame_resource(), resource)) {}
+
+    frame_resource_scope(const frame_resource_scope&) = delete;
+    frame_resource_scope& operator=(const frame_resource_scope&) = delete;
+
+    ~frame_resource_scope()
+    {
+        detail::frame_resource() = previous_;
+    }
+
+private:
+    std::pmr::memory_resource* previous_;
+};
+
 template <class T>
 class Task
 {
@@ -43,7 +75,7 @@ class Task
 public:
     using value_t = T;
 
-    struct promise_type
+    struct promise_type : detail::PooledFrame
     {
         std::exception_ptr eptr;
         std::coroutine_handle<> continuation{};
@@ -64,9 +96,10 @@ public:
             {
                 return false;
             }
-            void await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
             {
-                if(h.promise().continuation) h.promise().continuation.resume();
+                if(auto continuation = h.promise().continuation) return continuation;
+                return std::noop_coroutine();
             }
             void await_resume() const noexcept {}
         };
@@ -110,10 +143,14 @@ public:
     {
         return !handle_ || handle_.done();
     }
-    void await_suspend(std::coroutine_handle<> c) noexcept
+    // Symmetric transfer: the awaiting coroutine jumps straight into this
+    // task and final_suspend jumps back, so chains of awaits run in constant
+    // stack. To start a task from plain code, resume the returned handle;
+    // discarding it leaves the task unstarted.
+    [[nodiscard]] std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) noexcept
     {
         handle_.promise().continuation = c;
-        handle_.resume();
+        return handle_;
     }
     value_t await_resume()
     {
@@ -131,7 +168,7 @@ class Task<void>
 public:
     using value_t = std::monostate;
 
-    struct promise_type
+    struct promise_type : detail::PooledFrame
     {
         std::exception_ptr eptr;
         std::coroutine_handle<> continuation{};
@@ -151,9 +188,10 @@ public:
             {
                 return false;
             }
-            void await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
             {
-                if(h.promise().continuation) h.promise().continuation.resume();
+                if(auto continuation = h.promise().continuation) return continuation;
+                return std::noop_coroutine();
             }
             void await_resume() const noexcept {}
         };
@@ -193,10 +231,14 @@ public:
     {
         return !handle_ || handle_.done();
     }
-    void await_suspend(std::coroutine_handle<> c) noexcept
+    // Symmetric transfer: the awaiting coroutine jumps straight into this
+    // task and final_suspend jumps back, so chains of awaits run in constant
+    // stack. To start a task from plain code, resume the returned handle;
+    // discarding it leaves the task unstarted.
+    [[nodiscard]] std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) noexcept
     {
         handle_.promise().continuation = c;
-        handle_.resume();
+        return handle_;
     }
     void await_resume()
     {
@@ -219,9 +261,17 @@ concept Awaitable =
 
 struct CancelToken;
 
+// A source may be linked under a parent: it then reads as stopped when it or
+// any ancestor is, while stopping or resetting it leaves the parent alone.
+// The parent must outlive the child.
 struct CancelSource
 {
     std::atomic<bool> stop{false};
+    const CancelSource* parent = nullptr;
+
+    CancelSource() noexcept = default;
+    explicit CancelSource(const CancelSource* parent_source) noexcept : parent(parent_source) {}
+
     void request_stop() noexcept
     {
         stop.store(true, std::memory_order_relaxed);
@@ -230,6 +280,14 @@ struct CancelSource
     {
         stop.store(false, std::memory_order_relaxed);
     }
+    bool stop_requested() const noexcept
+    {
+        for(auto* source = this; source; source = source->parent)
+        {
+            if(source->stop.load(std::memory_order_relaxed)) return true;
+        }
+        return false;
+    }
     CancelToken token() noexcept;
 };
 
@@ -240,7 +298,7 @@ struct CancelToken
     constexpr explicit CancelToken(const CancelSource* source) noexcept : src(source) {}
     bool stop_requested() const noexcept
     {
-        return src && src->stop.load(std::memory_order_relaxed);
+        return src && src->stop_requested();
     }
 };
 
@@ -287,34 +345,490 @@ inline auto cancelled(CancelToken token)
     return cancellation_awaitable{token};
 }
 
-struct scheduler
+// Single-threaded run loop for coroutine effects: a FIFO ready queue plus a
+// hierarchical timing wheel for sleeps. Drive it on the wall clock with run(),
+// or on a virtual clock with advance() (tests, simulations), but not both.
+// Suspended coroutines are linked through their awaiters, so neither posting
+// nor sleeping allocates. Not thread-safe; post and resume from one thread.
+class run_loop
+{
+public:
+    using clock = std::chrono::steady_clock;
+    using duration = std::chrono::nanoseconds;
+
+    explicit run_loop(duration tick = std::chrono::milliseconds(1)) noexcept
+        : tick_(tick > duration::zero() ? tick : duration{1}), origin_(clock::now()) {}
+
+    run_loop(const run_loop&) = delete;
+    run_loop& operator=(const run_loop&) = delete;
+
+    ~run_loop()
+    {
+        while(auto* node = ready_.front()) node->unlink();
+    }
+
+    // Loop time, in whole ticks since construction.
+    duration now() const noexcept
+    {
+        return tick_ * static_cast<duration::rep>(wheel_.now());
+    }
+    duration tick() const noexcept
+    {
+        return tick_;
+    }
+
+    std::size_t timers() const noexcept
+    {
+        return wheel_.size();
+    }
+    bool idle() const noexcept
+    {
+        return !ready_.linked() && wheel_.empty();
+    }
+
+    // Queues `node.handle` to resume on the next turn.
+    void post(detail::TimerNode& node) noexcept
+    {
+        node.unlink();
+        ready_.push_back(node);
+    }
+
+    // Queues `node.handle` to resume once `delay`, rounded up to whole ticks,
+    // has passed on the loop clock.
+    void schedule_after(detail::TimerNode& node, duration delay) noexcept
+    {
+        node.deadline = wheel_.now() + ticks(delay);
+        wheel_.arm(node, ready_);
+    }
+
+    // Resumes the coroutines that are ready now. Anything they post in turn
+    // waits for the next call, so a yielding coroutine cannot starve timers.
+    std::size_t run_ready()
+    {
+        detail::TimerNode batch;
+        ready_.splice_to(batch);
+        std::size_t resumed = 0;
+        while(auto* node = batch.front())
+        {
+            node->unlink();
+            ++resumed;
+            node->handle.resume();
+        }
+        return resumed;
+    }
+
+    // Virtual time: moves the loop clock forward by `elapsed` and resumes
+    // everything that falls due on the way, in deadline order. Coroutines that
+    // sleep again are timed from the tick they woke on.
+    std::size_t advance(duration elapsed)
+    {
+        const auto target = wheel_.now() + ticks(elapsed);
+        auto resumed = drain();
+        while(wheel_.now() < target)
+        {
+            wheel_.advance(wheel_.empty() ? target : std::min(target, wheel_.next_event()), ready_);
+            resumed += drain();
+        }
+        return resumed;
+    }
+
+    // Wall clock: runs until `done()` holds or nothing is ready or armed,
+    // sleeping the thread between deadlines. Returns whether `done()` held.
+    template <class Pred>
+    bool run_until(Pred&& done)
+    {
+        while(true)
+        {
+            run_ready();
+            if(done()) return true;
+            if(ready_.linked()) continue;
+            if(wheel_.empty()) return false;
+            const auto next = wheel_.next_event();
+            std::this_thread::sleep_until(origin_ + tick_ * static_cast<duration::rep>(next));
+            const auto elapsed = static_cast<std::uint64_t>((clock::now() - origin_) / tick_);
+            wheel_.advance(std::max(next, elapsed), ready_);
+        }
+    }
+
+    void run()
+    {
+        run_until([] { return false; });
+    }
+
+    // Starts `task` and runs the loop until it completes or the loop runs dry.
+    template <class T>
+    bool run(Task<T>& task)
+    {
+        if(!task.await_ready()) task.await_suspend(std::noop_coroutine()).resume();
+        return run_until([&task] { return task.await_ready(); });
+    }
+
+private:
+    std::uint64_t ticks(duration delay) const noexcept
+    {
+        if(delay <= duration::zero()) return 0;
+        return static_cast<std::uint64_t>((delay + tick_ - duration{1}) / tick_);
+    }
+
+    std::size_t drain()
+    {
+        std::size_t resumed = 0;
+        while(ready_.linked()) resumed += run_ready();
+        return resumed;
+    }
+
+    duration tick_;
+    clock::time_point origin_;
+    detail::TimerNode ready_;
+    detail::TimerWheel wheel_;
+};
+
+// Scheduling facade for effects. Bound to a run_loop, post() and yield()
+// requeue the coroutine behind the work already ready and sleep_for() parks it
+// on the loop's timing wheel. A default-constructed scheduler has no loop and
+// all three complete inline.
+class scheduler
 {
-    struct immediate
+public:
+    struct awaiter
     {
-        constexpr bool await_ready() const noexcept
+        run_loop* loop = nullptr;
+        run_loop::duration delay{};
+        bool timed = false;
+        detail::TimerNode node{};
+
+        bool await_ready() const noexcept
+        {
+            return loop == nullptr;
+        }
+        bool await_suspend(std::coroutine_handle<> h) noexcept
         {
+            if(!loop) return false;
+            node.handle = h;
+            if(timed)
+                loop->schedule_after(node, delay);
+            else
+                loop->post(node);
             return true;
         }
-        constexpr void await_suspend(std::coroutine_handle<>) const noexcept {}
-        constexpr void await_resume() const noexcept {}
+        void await_resume() const noexcept {}
     };
 
-    immediate post() const noexcept
+    constexpr scheduler() noexcept = default;
+    constexpr explicit scheduler(run_loop& loop) noexcept : loop_(&loop) {}
+
+    awaiter post() const noexcept
     {
-        return {};
+        return awaiter{loop_};
     }
-    immediate yield() const noexcept
+    awaiter yield() const noexcept
     {
-        return {};
+        return awaiter{loop_};
     }
 
     template <class Rep, class Period>
-    immediate sleep_for(std::chrono::duration<Rep, Period>) const noexcept
+    awaiter sleep_for(std::chrono::duration<Rep, Period> delay) const noexcept
     {
-        return {};
+        return awaiter{loop_, std::chrono::ceil<run_loop::duration>(delay), true};
+    }
+
+    run_loop* loop() const noexcept
+    {
+        return loop_;
+    }
+
+private:
+    run_loop* loop_ = nullptr;
+};
+
+} // namespace co
+
+namespace detail
+{
+
+// Shared by the children of a when_all or when_any. `remaining` starts one
+// above the number of finishes the waiter needs (every child, or just the
+// first), so the awaiting coroutine, which drops that extra count itself, is
+// never resumed from inside its own await_suspend.
+struct JoinLatch
+{
+    std::atomic<std::size_t> remaining{0};
+    std::coroutine_handle<> waiter{};
+    bool first_only = false;
+    std::atomic<bool> decided{false};
+    std::size_t winner = 0;
+
+    // Called by each child as it finishes; returns whom to transfer to.
+    std::coroutine_handle<> finished(std::size_t index) noexcept
+    {
+        if(first_only)
+        {
+            if(decided.exchange(true, std::memory_order_acq_rel)) return std::noop_coroutine();
+            winner = index;
+        }
+        if(remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) return waiter;
+        return std::noop_coroutine();
+    }
+
+    // Drops the waiter's own count; true if the waiter must suspend.
+    bool arrive() noexcept
+    {
+        return remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
     }
 };
 
+// Coroutine that awaits one task without consuming its result and then
+// reports to the latch.
+class JoinTask
+{
+public:
+    struct promise_type : PooledFrame
+    {
+        JoinLatch* latch = nullptr;
+        std::size_t index = 0;
+
+        JoinTask get_return_object()
+        {
+            return JoinTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        struct final_awaiter
+        {
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                return h.promise().latch->finished(h.promise().index);
+            }
+            void await_resume() const noexcept {}
+        };
+        final_awaiter final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {}
+    };
+
+    using handle = std::coroutine_handle<promise_type>;
+
+    explicit JoinTask(handle h) : handle_(h) {}
+    JoinTask(JoinTask&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    JoinTask& operator=(JoinTask&&) = delete;
+    ~JoinTask()
+    {
+        if(handle_) handle_.destroy();
+    }
+
+    void start(JoinLatch& latch, std::size_t index)
+    {
+        handle_.promise().latch = &latch;
+        handle_.promise().index = index;
+        handle_.resume();
+    }
+
+private:
+    handle handle_{};
+};
+
+// Awaits a task for completion only; the result stays in the task.
+template <class T>
+struct completion_of
+{
+    co::Task<T>& task;
+    bool await_ready() const noexcept
+    {
+        return task.await_ready();
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept
+    {
+        return task.await_suspend(h);
+    }
+    void await_resume() const noexcept {}
+};
+
+template <class T>
+JoinTask join(co::Task<T>& task)
+{
+    co_await completion_of<T>{task};
+}
+
+// Starts the tasks in order and resumes the awaiting coroutine once all of
+// them (or, with `first_only`, the first of them) have finished. In the
+// latter case tasks after a synchronous winner are never started, and every
+// task but the winner is destroyed before the join frames are, so no loser
+// can later finish into a freed join.
+template <class T>
+class Completed
+{
+public:
+    Completed(std::vector<co::Task<T>>& tasks, bool first_only) : tasks_(tasks)
+    {
+        latch_.first_only = first_only;
+    }
+
+    bool await_ready() const noexcept
+    {
+        return tasks_.empty();
+    }
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+        latch_.waiter = h;
+        latch_.remaining.store(latch_.first_only ? 2 : tasks_.size() + 1, std::memory_order_relaxed);
+        joins_.reserve(tasks_.size());
+        for(std::size_t index = 0; index < tasks_.size(); ++index)
+        {
+            if(latch_.first_only && latch_.decided.load(std::memory_order_acquire)) break;
+            joins_.push_back(join(tasks_[index]));
+            joins_.back().start(latch_, index);
+        }
+        return latch_.arrive();
+    }
+    std::size_t await_resume() noexcept
+    {
+        if(latch_.first_only)
+        {
+            for(std::size_t index = 0; index < tasks_.size(); ++index)
+            {
+                if(index != latch_.winner) tasks_[index] = co::Task<T>{};
+            }
+        }
+        return latch_.winner;
+    }
+
+private:
+    std::vector<co::Task<T>>& tasks_;
+    std::vector<JoinTask> joins_;
+    JoinLatch latch_;
+};
+
+// Owns `task` while it runs and hands it to `finished` once it has, so
+// destroying the racer unfinished destroys `task` with it.
+template <class T>
+co::Task<void> completion(co::Task<T> task, co::Task<T>& finished)
+{
+    co_await completion_of<T>{task};
+    finished = std::move(task);
+}
+
+inline co::Task<void> sleep(co::scheduler sched, co::run_loop::duration delay)
+{
+    co_await sched.sleep_for(delay);
+}
+
+} // namespace detail
+
+namespace co
+{
+
+// Runs `tasks` concurrently and completes once every one of them has. Results
+// come back in input order; if any task threw, the first exception in input
+// order is rethrown after all tasks have finished.
+template <class T>
+Task<std::vector<T>> when_all(std::vector<Task<T>> tasks)
+{
+    co_await detail::Completed<T>{tasks, false};
+    std::vector<T> results;
+    results.reserve(tasks.size());
+    for(auto& task : tasks) results.push_back(task.await_resume());
+    co_return results;
+}
+
+inline Task<void> when_all(std::vector<Task<void>> tasks)
+{
+    co_await detail::Completed<void>{tasks, false};
+    for(auto& task : tasks) task.await_resume();
+}
+
+template <class T>
+struct when_any_result
+{
+    std::size_t index;
+    T value;
+};
+
+// Races `tasks` and completes as soon as the first one finishes, with its
+// index and result (or its exception). Once the race is decided, every
+// other task is destroyed at its current suspension point, which every
+// lsm::co awaitable tolerates, and `losers`, if given, is stopped. `tasks`
+// must not be empty.
+template <class T>
+Task<when_any_result<T>> when_any(std::vector<Task<T>> tasks, CancelSource* losers = nullptr)
+{
+    assert(!tasks.empty());
+    const auto index = co_await detail::Completed<T>{tasks, true};
+    if(losers) losers->request_stop();
+    co_return when_any_result<T>{index, tasks[index].await_resume()};
+}
+
+inline Task<std::size_t> when_any(std::vector<Task<void>> tasks, CancelSource* losers = nullptr)
+{
+    assert(!tasks.empty());
+    const auto index = co_await detail::Completed<void>{tasks, true};
+    if(losers) losers->request_stop();
+    tasks[index].await_resume();
+    co_return index;
+}
+
+struct timeout_error : std::exception
+{
+    const char* what() const noexcept override
+    {
+        return "lsm::co timeout";
+    }
+};
+
+// Completes with the result of `task`, or throws timeout_error if `timeout`
+// passes on `sched`'s run loop first; `cancel`, if given, is stopped on
+// timeout. Needs a scheduler bound to a run_loop: without one the timer
+// fires at once unless `task` completes synchronously. On timeout `task` is
+// destroyed at its suspension point before the error is thrown.
+template <class T, class Rep, class Period>
+Task<T> with_timeout(Task<T> task, std::chrono::duration<Rep, Period> timeout, scheduler sched, CancelSource* cancel = nullptr)
+{
+    Task<T> finished;
+    std::vector<Task<void>> racers;
+    racers.push_back(detail::completion(std::move(task), finished));
+    racers.push_back(detail::sleep(sched, std::chrono::ceil<run_loop::duration>(timeout)));
+    if(co_await when_any(std::move(racers)) != 0)
+    {
+        if(cancel) cancel->request_stop();
+        throw timeout_error{};
+    }
+    if constexpr(std::is_void_v<T>)
+    {
+        finished.await_resume();
+    }
+    else
+    {
+        co_return finished.await_resume();
+    }
+}
+
+// How dispatch_async() picks one output when several effects produce one.
+// Both count in bind order, so the result does not depend on timing.
+enum class merge_policy
+{
+    first_wins,
+    last_wins,
+};
+
+// What dispatch_async() does with input that arrives while effects started by
+// an earlier dispatch are still in flight.
+enum class overlap_policy
+{
+    process,   // commit it right away; every effect's result arrives later
+    queue,     // hold it until the in-flight effects have finished, in FIFO order
+    supersede, // cancel the in-flight effects and drop their outputs
+};
+
 template <class CoMachine>
 struct types
 {
@@ -415,46 +929,256 @@ public:
         return FromStage(*this, state);
     }
 
+    // Frames of dispatch_async() and of the effects it starts are allocated
+    // from `resource`; null (the default) leaves the choice to the caller's
+    // frame_resource_scope, if any. The resource must outlive every task
+    // created through this adapter.
+    void set_frame_resource(std::pmr::memory_resource* resource) noexcept
+    {
+        frame_resource_ = resource;
+    }
+
+    // With several effects bound to one transition, which output
+    // dispatch_async() returns. Defaults to merge_policy::first_wins.
+    void set_merge_policy(merge_policy policy) noexcept
+    {
+        merge_ = policy;
+    }
+
+    // How a dispatch overlapping in-flight effects is handled. Defaults to
+    // overlap_policy::process. Input that selects no transition never
+    // supersedes anything.
+    void set_overlap_policy(overlap_policy policy) noexcept
+    {
+        overlap_ = policy;
+    }
+
+    // Commits the transition selected for `in`, then runs every effect bound to
+    // it concurrently and completes when all have. Yields the effect output
+    // picked by the merge policy, or the transition's own output if no effect
+    // produced one.
     Task<std::optional<Output>> dispatch_async(Input in)
     {
-        auto sel = machine_.select(in);
-        if(sel)
+        frame_resource_scope scope(frame_resource());
+        return run_dispatch<std::optional<Output>>(std::move(in));
+    }
+
+    // Like dispatch_async(in), but the effects observe `cancel`, so this
+    // dispatch can be cancelled on its own, e.g. once a newer event makes it
+    // stale. `cancel` is linked under the adapter's global source unless it
+    // already has a parent, and must outlive the returned task.
+    Task<std::optional<Output>> dispatch_async(Input in, CancelSource& cancel)
+    {
+        link(cancel);
+        frame_resource_scope scope(frame_resource());
+        return run_dispatch<std::optional<Output>>(std::move(in), &cancel);
+    }
+
+    // Like dispatch_async(), but collects every output: the transition's own
+    // output first, if any, then each effect's in bind order.
+    Task<std::vector<Output>> dispatch_async_all(Input in)
+    {
+        frame_resource_scope scope(frame_resource());
+        return run_dispatch<std::vector<Output>>(std::move(in));
+    }
+
+    Task<std::vector<Output>> dispatch_async_all(Input in, CancelSource& cancel)
+    {
+        link(cancel);
+        frame_resource_scope scope(frame_resource());
+        return run_dispatch<std::vector<Output>>(std::move(in), &cancel);
+    }
+
+private:
+    std::pmr::memory_resource* frame_resource() const noexcept
+    {
+        return frame_resource_ ? frame_resource_ : detail::frame_resource();
+    }
+
+    // A dispatch whose effects are running; lives in its coroutine frame.
+    struct Inflight : detail::TimerNode
+    {
+        CancelSource* source = nullptr;
+        bool superseded = false;
+    };
+
+    // Parks a queued dispatch until wake() picks it.
+    struct queued
+    {
+        Adapter& adapter;
+        detail::TimerNode node{};
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            node.handle = h;
+            adapter.waiting_.push_back(node);
+        }
+        void await_resume() const noexcept {}
+    };
+
+    void supersede() noexcept
+    {
+        for(auto* node = inflight_.front(); node && node != &inflight_; node = node->next)
+        {
+            auto& flight = static_cast<Inflight&>(*node);
+            flight.superseded = true;
+            flight.source->request_stop();
+        }
+    }
+
+    void finish(Inflight& flight)
+    {
+        flight.unlink();
+        machine_.end_async_effect();
+        wake();
+    }
+
+    // Finishes an in-flight dispatch exactly once: explicitly when its effects
+    // return, or from the frame's destruction when they throw or when the
+    // dispatch is destroyed while suspended (with_timeout does that).
+    struct EffectScope
+    {
+        Adapter* adapter;
+        Inflight* flight;
+
+        ~EffectScope()
         {
-            const State from = machine_.state();
-            const State to = sel.get()->to;
+            finish();
+        }
+        void finish()
+        {
+            if(auto* owner = std::exchange(adapter, nullptr)) owner->finish(*flight);
+        }
+    };
 
-            if(auto* actions = registry_.find(from, to); actions && !actions->empty())
+    // Resumes queued dispatches one at a time while nothing is in flight. A
+    // woken dispatch that completes synchronously re-enters here and returns
+    // at once, so the loop, not the stack, carries the rest of the queue.
+    void wake()
+    {
+        if(waking_) return;
+        waking_ = true;
+        while(!inflight_.linked())
+        {
+            auto* node = waiting_.front();
+            if(!node) break;
+            node->unlink();
+            node->handle.resume();
+        }
+        waking_ = false;
+    }
+
+    void link(CancelSource& cancel) const noexcept
+    {
+        if(!cancel.parent && &cancel != global_cancel_) cancel.parent = global_cancel_;
+    }
+
+    Task<std::optional<Output>> start_effect(CoAction& action, const Input& in, CancelToken token)
+    {
+        frame_resource_scope scope(frame_resource());
+        return action(in, machine_.context(), token, machine_.publisher());
+    }
+
+    template <class Result>
+    Result merge(std::optional<Output> committed, std::span<std::optional<Output>> effects) const
+    {
+        if constexpr(std::is_same_v<Result, std::vector<Output>>)
+        {
+            Result all;
+            if(committed) all.push_back(std::move(*committed));
+            for(auto& out : effects)
             {
-                auto completion_out = machine_.commit(sel, &in);
-                machine_.begin_async_effect();
-                CancelToken token{global_cancel_};
-                std::optional<Output> effect_out;
-                try
-                {
-                    effect_out = co_await (*actions)[0](in, machine_.context(), token, machine_.publisher());
-                } catch(...)
-                {
-                    machine_.end_async_effect();
-                    throw;
-                }
-                machine_.end_async_effect();
-                if(effect_out)
+                if(out) all.push_back(std::move(*out));
+            }
+            return all;
+        }
+        else
+        {
+            auto pick = [](auto first, auto last) -> std::optional<Output> {
+                for(; first != last; ++first)
                 {
-                    co_return effect_out;
+                    if(*first) return std::move(*first);
                 }
-                co_return completion_out;
-            }
+                return std::nullopt;
+            };
+            auto chosen = merge_ == merge_policy::first_wins ? pick(effects.begin(), effects.end())
+                                                             : pick(effects.rbegin(), effects.rend());
+            return chosen ? std::move(chosen) : std::move(committed);
+        }
+    }
+
+    // A single effect is awaited directly; only a fan-out pays for when_all.
+    // Without a caller-supplied source, each dispatch still gets its own child
+    // of the global one.
+    template <class Result>
+    Task<Result> run_dispatch(Input in, CancelSource* cancel = nullptr)
+    {
+        if(overlap_ == overlap_policy::queue && (inflight_.linked() || waiting_.linked()))
+        {
+            co_await queued{*this};
+        }
+        auto sel = machine_.select(in);
+        if(!sel)
+        {
+            co_return Result{};
+        }
+        if(overlap_ == overlap_policy::supersede) supersede();
 
-            co_return machine_.commit(sel, &in);
+        const State from = machine_.state();
+        const State to = sel.get()->to;
+        auto* actions = registry_.find(from, to);
+        if(!actions || actions->empty())
+        {
+            co_return merge<Result>(machine_.commit(sel, &in), {});
         }
 
-        co_return std::optional<Output>{};
+        auto completion_out = machine_.commit(sel, &in);
+        CancelSource own{global_cancel_};
+        Inflight flight;
+        flight.source = cancel ? cancel : &own;
+        inflight_.push_back(flight);
+        machine_.begin_async_effect();
+        EffectScope scope{this, &flight};
+        CancelToken token{flight.source};
+        const bool fan_out = actions->size() > 1;
+        std::optional<Output> single;
+        std::vector<std::optional<Output>> many;
+        if(!fan_out)
+        {
+            single = co_await start_effect(actions->front(), in, token);
+        }
+        else
+        {
+            std::vector<Task<std::optional<Output>>> effects;
+            effects.reserve(actions->size());
+            for(auto& action : *actions) effects.push_back(start_effect(action, in, token));
+            many = co_await when_all(std::move(effects));
+        }
+        scope.finish();
+        if(flight.superseded)
+        {
+            co_return merge<Result>(std::move(completion_out), {});
+        }
+        if(fan_out)
+        {
+            co_return merge<Result>(std::move(completion_out), many);
+        }
+        co_return merge<Result>(std::move(completion_out), {&single, 1});
     }
 
-private:
     CoMachine& machine_;
     Registry<CoMachine> registry_;
     CancelSource* global_cancel_ = nullptr;
+    std::pmr::memory_resource* frame_resource_ = nullptr;
+    merge_policy merge_ = merge_policy::first_wins;
+    overlap_policy overlap_ = overlap_policy::process;
+    detail::TimerNode inflight_;
+    detail::TimerNode waiting_;
+    bool waking_ = false;
 };
 
 template <class CoMachine>
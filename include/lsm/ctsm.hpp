@@ -0,0 +1,749 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <lsm/detail/concepts.hpp>
+#include <lsm/detail/effect.hpp>
+#include <lsm/detail/policy.hpp>
+#include <lsm/detail/types.hpp>
+
+namespace lsm
+{
+
+// Compile-time front-end: the transition table is a type, guards and actions are
+// stateless callables named by type, and dispatch is generated as a chain of
+// constant comparisons the compiler can turn into a switch. Resolution order,
+// any-state fallbacks, completions and deferral follow MachineImpl exactly.
+namespace ct
+{
+
+// Placeholder for "no guard" / "no action".
+struct none
+{
+};
+
+// Lifts a constexpr lambda (or function pointer) into a stateless callable type.
+template <auto F>
+struct fn
+{
+    template <class... Args>
+    constexpr decltype(auto) operator()(Args&&... args) const
+    {
+        return F(std::forward<Args>(args)...);
+    }
+};
+
+namespace detail
+{
+
+enum class row_kind
+{
+    transition,
+    any,
+    completion,
+    enter,
+    exit,
+    update,
+    state_unhandled,
+    unhandled
+};
+
+inline constexpr unsigned defer_flag = 1u;
+inline constexpr unsigned suppress_flag = 2u;
+
+struct row_base
+{
+    using event = void;
+    using action_fn = none;
+    using guard_fn = none;
+    static constexpr int priority_value = 0;
+    static constexpr unsigned flags = 0;
+};
+
+} // namespace detail
+
+template <auto From, class Event, auto To, class Action = none, class Guard = none, int Priority = 0, unsigned Flags = 0>
+struct transition : detail::row_base
+{
+    static constexpr auto kind = detail::row_kind::transition;
+    static constexpr auto from = From;
+    static constexpr auto to = To;
+    using event = Event;
+    using action_fn = Action;
+    using guard_fn = Guard;
+    static constexpr int priority_value = Priority;
+    static constexpr unsigned flags = Flags;
+
+    template <class A>
+    using action = transition<From, Event, To, A, Guard, Priority, Flags>;
+    template <class G>
+    using guard = transition<From, Event, To, Action, G, Priority, Flags>;
+    template <int P>
+    using priority = transition<From, Event, To, Action, Guard, P, Flags>;
+    using defer = transition<From, Event, To, Action, Guard, Priority, Flags | detail::defer_flag>;
+    using suppress_enter_exit = transition<From, Event, To, Action, Guard, Priority, Flags | detail::suppress_flag>;
+};
+
+template <class Event, auto To, class Action = none, class Guard = none, int Priority = 0, unsigned Flags = 0>
+struct any_transition : detail::row_base
+{
+    static constexpr auto kind = detail::row_kind::any;
+    static constexpr auto to = To;
+    using event = Event;
+    using action_fn = Action;
+    using guard_fn = Guard;
+    static constexpr int priority_value = Priority;
+    static constexpr unsigned flags = Flags;
+
+    template <class A>
+    using action = any_transition<Event, To, A, Guard, Priority, Flags>;
+    template <class G>
+    using guard = any_transition<Event, To, Action, G, Priority, Flags>;
+    template <int P>
+    using priority = any_transition<Event, To, Action, Guard, P, Flags>;
+    using defer = any_transition<Event, To, Action, Guard, Priority, Flags | detail::defer_flag>;
+    using suppress_enter_exit = any_transition<Event, To, Action, Guard, Priority, Flags | detail::suppress_flag>;
+};
+
+template <auto From, auto To, class Action = none, class Guard = none, int Priority = 0, unsigned Flags = 0>
+struct completion : detail::row_base
+{
+    static constexpr auto kind = detail::row_kind::completion;
+    static constexpr auto from = From;
+    static constexpr auto to = To;
+    using action_fn = Action;
+    using guard_fn = Guard;
+    static constexpr int priority_value = Priority;
+    static constexpr unsigned flags = Flags;
+
+    template <class A>
+    using action = completion<From, To, A, Guard, Priority, Flags>;
+    template <class G>
+    using guard = completion<From, To, Action, G, Priority, Flags>;
+    template <int P>
+    using priority = completion<From, To, Action, Guard, P, Flags>;
+    using suppress_enter_exit = completion<From, To, Action, Guard, Priority, Flags | detail::suppress_flag>;
+};
+
+template <auto State, class Fn>
+struct on_enter : detail::row_base
+{
+    static constexpr auto kind = detail::row_kind::enter;
+    static constexpr auto from = State;
+    using action_fn = Fn;
+};
+
+template <auto State, class Fn>
+struct on_exit : detail::row_base
+{
+    static constexpr auto kind = detail::row_kind::exit;
+    static constexpr auto from = State;
+    using action_fn = Fn;
+};
+
+template <auto State, class Fn>
+struct on_do : detail::row_base
+{
+    static constexpr auto kind = detail::row_kind::update;
+    static constexpr auto from = State;
+    using action_fn = Fn;
+};
+
+// Runs for input the machine drops while in `State`; takes precedence over
+// any_unhandled, as a per-state hook does in MachineImpl.
+template <auto State, class Fn>
+struct on_unhandled : detail::row_base
+{
+    static constexpr auto kind = detail::row_kind::state_unhandled;
+    static constexpr auto from = State;
+    using action_fn = Fn;
+};
+
+template <class Fn>
+struct any_unhandled : detail::row_base
+{
+    static constexpr auto kind = detail::row_kind::unhandled;
+    using action_fn = Fn;
+};
+
+template <class... Rows>
+struct table
+{
+};
+
+namespace detail
+{
+
+template <class Row>
+inline constexpr bool is_hook_v = Row::kind == row_kind::enter || Row::kind == row_kind::exit ||
+                                  Row::kind == row_kind::update || Row::kind == row_kind::state_unhandled ||
+                                  Row::kind == row_kind::unhandled;
+
+template <class A, class B>
+constexpr bool hooks_clash()
+{
+    if constexpr(!is_hook_v<A> || !is_hook_v<B> || A::kind != B::kind)
+    {
+        return false;
+    }
+    else if constexpr(A::kind == row_kind::unhandled)
+    {
+        return true;
+    }
+    else
+    {
+        return A::from == B::from;
+    }
+}
+
+template <std::size_t N>
+struct order_t
+{
+    std::array<std::size_t, N> index{};
+    std::size_t size = 0;
+};
+
+// Stable insertion of row `k` into an order sorted by descending priority.
+template <std::size_t N>
+constexpr void insert_by_priority(order_t<N>& order, const std::array<int, N>& priorities, std::size_t k)
+{
+    std::size_t pos = order.size;
+    while(pos > 0 && priorities[order.index[pos - 1]] < priorities[k])
+    {
+        order.index[pos] = order.index[pos - 1];
+        --pos;
+    }
+    order.index[pos] = k;
+    ++order.size;
+}
+
+} // namespace detail
+
+template <class State,
+          class Input,
+          class Output,
+          class Context,
+          class Table,
+          class EffectPolicy = policy::ReturnOutput<Output>>
+class Machine;
+
+template <class State, class Input, class Output, class Context, class... Rows, class EffectPolicy>
+class Machine<State, Input, Output, Context, table<Rows...>, EffectPolicy>
+{
+    static_assert(IsVariant<Input>, "lsm::ct::Machine requires Input to be std::variant<...>");
+
+    static constexpr bool publishes = lsm::detail::is_publisher_effect<EffectPolicy>::value;
+
+    template <class P, bool = publishes>
+    struct publisher_of
+    {
+        using type = lsm::detail::NullPublisher;
+    };
+    template <class P>
+    struct publisher_of<P, true>
+    {
+        using type = typename lsm::detail::is_publisher_effect<P>::publisher_type;
+    };
+
+public:
+    using State_t = State;
+    using Input_t = Input;
+    using Output_t = Output;
+    using Ctx_t = Context;
+    using Publisher_t = typename publisher_of<EffectPolicy>::type;
+
+    explicit Machine(State_t initial, Ctx_t ctx = {}, Publisher_t publisher = {})
+        : current_(std::move(initial)), ctx_(std::move(ctx)), publisher_(std::move(publisher))
+    {
+        run_enter(current_, current_, nullptr);
+        finalize_transition(std::nullopt);
+    }
+
+    std::optional<Output_t> dispatch(const Input_t& in)
+    {
+        std::optional<Output_t> out;
+        if(!route(in, out))
+        {
+            notify_unhandled(in);
+        }
+        return out;
+    }
+
+    void enqueue(const Input_t& in)
+    {
+        pending_inputs_.push_back(in);
+    }
+
+    void enqueue(Input_t&& in)
+    {
+        pending_inputs_.push_back(std::move(in));
+    }
+
+    std::vector<Output_t> dispatch_all()
+    {
+        std::vector<Output_t> outputs;
+        while(!pending_inputs_.empty())
+        {
+            Input_t next = std::move(pending_inputs_.front());
+            pending_inputs_.pop_front();
+            if(auto out = dispatch(next))
+            {
+                outputs.push_back(std::move(*out));
+            }
+        }
+        return outputs;
+    }
+
+    std::optional<Output_t> update()
+    {
+        std::optional<Output_t> out;
+        (run_update<Rows>(out), ...);
+        return out;
+    }
+
+    const State_t& state() const noexcept
+    {
+        return current_;
+    }
+    Ctx_t& context() noexcept
+    {
+        return ctx_;
+    }
+    const Ctx_t& context() const noexcept
+    {
+        return ctx_;
+    }
+    Publisher_t& publisher() noexcept
+    {
+        return publisher_;
+    }
+    const Publisher_t& publisher() const noexcept
+    {
+        return publisher_;
+    }
+    void set_state_direct(State_t next)
+    {
+        current_ = std::move(next);
+    }
+
+private:
+    using rows = std::tuple<Rows...>;
+    static constexpr std::size_t row_count = sizeof...(Rows);
+    static constexpr std::size_t alternatives = std::variant_size_v<Input_t>;
+
+    template <std::size_t K>
+    using row_t = std::tuple_element_t<K, rows>;
+
+    static constexpr std::array<int, row_count> priorities{Rows::priority_value...};
+
+    static constexpr bool hooks_unique = []<std::size_t... I>(std::index_sequence<I...>) {
+        return ([]<std::size_t A, std::size_t... J>(std::integral_constant<std::size_t, A>, std::index_sequence<J...>) {
+            return (!(A < J && detail::hooks_clash<row_t<A>, row_t<J>>()) && ...);
+        }(std::integral_constant<std::size_t, I>{}, std::index_sequence<I...>{}) && ...);
+    }(std::index_sequence_for<Rows...>{});
+    static_assert(hooks_unique, "lsm::ct::table declares more than one hook of the same kind for a state");
+
+    static constexpr bool deferral_enabled = (((Rows::flags & detail::defer_flag) != 0) || ... || false);
+    static constexpr std::size_t completion_count = ((Rows::kind == detail::row_kind::completion ? std::size_t{1} : std::size_t{0}) + ... + std::size_t{0});
+    static constexpr std::size_t completion_limit = completion_count ? completion_count + 1 : 0;
+
+    // Candidate rows for an event: state transitions by descending priority,
+    // then any-state transitions by descending priority.
+    template <class Event>
+    static constexpr auto candidates = [] {
+        detail::order_t<row_count> state_rows;
+        detail::order_t<row_count> any_rows;
+        constexpr std::array<bool, row_count> routed{std::is_same_v<typename Rows::event, Event>...};
+        constexpr std::array<detail::row_kind, row_count> kinds{Rows::kind...};
+        for(std::size_t k = 0; k < row_count; ++k)
+        {
+            if(!routed[k]) continue;
+            if(kinds[k] == detail::row_kind::transition) detail::insert_by_priority(state_rows, priorities, k);
+            if(kinds[k] == detail::row_kind::any) detail::insert_by_priority(any_rows, priorities, k);
+        }
+        for(std::size_t i = 0; i < any_rows.size; ++i)
+        {
+            state_rows.index[state_rows.size++] = any_rows.index[i];
+        }
+        return state_rows;
+    }();
+
+    static constexpr auto completion_order = [] {
+        detail::order_t<row_count> order;
+        constexpr std::array<detail::row_kind, row_count> kinds{Rows::kind...};
+        for(std::size_t k = 0; k < row_count; ++k)
+        {
+            if(kinds[k] == detail::row_kind::completion) detail::insert_by_priority(order, priorities, k);
+        }
+        return order;
+    }();
+
+    // Distinct states named by the table; deferral queues are kept per entry.
+    static constexpr auto known_states = [] {
+        std::array<State_t, row_count * 2 + 1> states{};
+        std::size_t size = 0;
+        auto add = [&](State_t s) {
+            for(std::size_t i = 0; i < size; ++i)
+            {
+                if(states[i] == s) return;
+            }
+            states[size++] = s;
+        };
+        (
+            [&] {
+                if constexpr(Rows::kind == detail::row_kind::transition || Rows::kind == detail::row_kind::completion)
+                {
+                    add(Rows::from);
+                    add(Rows::to);
+                }
+                else if constexpr(Rows::kind == detail::row_kind::any)
+                {
+                    add(Rows::to);
+                }
+            }(),
+            ...);
+        return std::pair{states, size};
+    }();
+
+    static constexpr std::size_t state_slot(const State_t& s) noexcept
+    {
+        for(std::size_t i = 0; i < known_states.second; ++i)
+        {
+            if(known_states.first[i] == s) return i;
+        }
+        return known_states.second;
+    }
+
+    bool route(const Input_t& in, std::optional<Output_t>& out)
+    {
+        return route_alternative<0>(in.index(), in, out);
+    }
+
+    template <std::size_t I>
+    bool route_alternative(std::size_t index, const Input_t& in, std::optional<Output_t>& out)
+    {
+        if constexpr(I < alternatives)
+        {
+            if(index == I)
+            {
+                using Event = std::variant_alternative_t<I, Input_t>;
+                constexpr auto& order = candidates<Event>;
+                return try_candidates<Event>(*std::get_if<I>(&in), in, out, std::make_index_sequence<order.size>{});
+            }
+            return route_alternative<I + 1>(index, in, out);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    template <class Event, std::size_t... I>
+    bool try_candidates(const Event& ev, const Input_t& in, std::optional<Output_t>& out, std::index_sequence<I...>)
+    {
+        return (try_row<row_t<candidates<Event>.index[I]>>(ev, in, out) || ...);
+    }
+
+    template <class Row, class Event>
+    bool try_row(const Event& ev, const Input_t& in, std::optional<Output_t>& out)
+    {
+        if constexpr(Row::kind == detail::row_kind::transition)
+        {
+            if(current_ != Row::from) return false;
+        }
+        if(!check_guard<typename Row::guard_fn>(ev, in)) return false;
+
+        if constexpr(deferral_enabled && (Row::flags & detail::defer_flag) != 0)
+        {
+            deferrals_[state_slot(Row::to)].push_back(in);
+            apply_transition<Row>(ev, &in, false);
+            out = finalize_transition(std::nullopt);
+        }
+        else
+        {
+            out = finalize_transition(apply_transition<Row>(ev, &in, true));
+        }
+        return true;
+    }
+
+    template <class Guard, class Event>
+    bool check_guard(const Event& ev, const Input_t& in) const
+    {
+        if constexpr(std::is_same_v<Guard, none>)
+        {
+            return true;
+        }
+        else if constexpr(std::is_invocable_r_v<bool, const Guard&, const Event&, const Ctx_t&>)
+        {
+            return static_cast<bool>(Guard{}(ev, ctx_));
+        }
+        else
+        {
+            static_assert(std::is_invocable_r_v<bool, const Guard&, const Input_t&, const Ctx_t&>,
+                          "guard must be bool(const Event&, const Ctx&) or bool(const Input&, const Ctx&)");
+            return static_cast<bool>(Guard{}(in, ctx_));
+        }
+    }
+
+    template <class Row, class Event>
+    std::optional<Output_t> apply_transition(const Event& ev, const Input_t* in, bool invoke_action)
+    {
+        const State_t from = current_;
+        constexpr State_t to = Row::to;
+        const bool skip_hooks = (Row::flags & detail::suppress_flag) != 0 && to == from;
+
+        if(!skip_hooks) run_exit(from, to, in);
+
+        std::optional<Output_t> output;
+        if(invoke_action)
+        {
+            output = invoke_action_fn<typename Row::action_fn>(ev);
+        }
+
+        current_ = to;
+
+        if(!skip_hooks) run_enter(from, to, in);
+        return output;
+    }
+
+    template <class Action, class Event>
+    std::optional<Output_t> invoke_action_fn(const Event& ev)
+    {
+        if constexpr(std::is_same_v<Action, none>)
+        {
+            return std::nullopt;
+        }
+        else if constexpr(publishes)
+        {
+            static_assert(lsm::detail::PublisherActionForEx<Action, Event, Ctx_t, Publisher_t>,
+                          "Action must be void(const Event&, Ctx&, Publisher&)");
+            Action{}(ev, ctx_, publisher_);
+            return std::nullopt;
+        }
+        else
+        {
+            static_assert(lsm::detail::ReturnActionForEx<Action, Event, Ctx_t, Output_t>,
+                          "Action must return std::optional<Output>(const Event&, Ctx&)");
+            return Action{}(ev, ctx_);
+        }
+    }
+
+    template <class Action>
+    std::optional<Output_t> invoke_completion_fn()
+    {
+        if constexpr(std::is_same_v<Action, none>)
+        {
+            return std::nullopt;
+        }
+        else if constexpr(publishes)
+        {
+            static_assert(lsm::detail::PublisherCompletionActionForEx<Action, Ctx_t, Publisher_t>,
+                          "Completion action must be void(Ctx&, Publisher&)");
+            Action{}(ctx_, publisher_);
+            return std::nullopt;
+        }
+        else
+        {
+            static_assert(lsm::detail::ReturnCompletionActionForEx<Action, Ctx_t, Output_t>,
+                          "Completion action must return std::optional<Output>(Ctx&)");
+            return Action{}(ctx_);
+        }
+    }
+
+    void run_exit(const State_t& from, const State_t& to, const Input_t* in)
+    {
+        (run_hook<Rows, detail::row_kind::exit>(from, from, to, in), ...);
+    }
+
+    void run_enter(const State_t& from, const State_t& to, const Input_t* in)
+    {
+        (run_hook<Rows, detail::row_kind::enter>(to, from, to, in), ...);
+    }
+
+    template <class Row, detail::row_kind Kind>
+    void run_hook(const State_t& owner, const State_t& from, const State_t& to, const Input_t* in)
+    {
+        if constexpr(Row::kind == Kind)
+        {
+            if(owner == Row::from)
+            {
+                typename Row::action_fn{}(ctx_, from, to, in);
+            }
+        }
+    }
+
+    template <class Row>
+    void run_update(std::optional<Output_t>& out)
+    {
+        if constexpr(Row::kind == detail::row_kind::update)
+        {
+            if(current_ == Row::from)
+            {
+                using Fn = typename Row::action_fn;
+                if constexpr(publishes)
+                {
+                    Fn{}(ctx_, current_, publisher_);
+                }
+                else
+                {
+                    out = Fn{}(ctx_, current_);
+                }
+            }
+        }
+    }
+
+    void notify_unhandled(const Input_t& in)
+    {
+        try
+        {
+            if(!(run_state_unhandled<Rows>(in) || ...)) (run_unhandled<Rows>(in), ...);
+        } catch(...)
+        {
+        }
+    }
+
+    template <class Row>
+    bool run_state_unhandled(const Input_t& in)
+    {
+        if constexpr(Row::kind == detail::row_kind::state_unhandled)
+        {
+            if(current_ == Row::from)
+            {
+                typename Row::action_fn{}(ctx_, current_, in);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <class Row>
+    void run_unhandled(const Input_t& in)
+    {
+        if constexpr(Row::kind == detail::row_kind::unhandled)
+        {
+            typename Row::action_fn{}(ctx_, current_, in);
+        }
+    }
+
+    std::optional<Output_t> finalize_transition(std::optional<Output_t> result)
+    {
+        auto completion_out = process_completions();
+        if(!result && completion_out)
+        {
+            result = std::move(completion_out);
+        }
+        drain_deferrals_for_current_state();
+        return result;
+    }
+
+    std::optional<Output_t> process_completions()
+    {
+        if constexpr(completion_limit == 0)
+        {
+            return std::nullopt;
+        }
+        else
+        {
+            if(processing_completions_) return std::nullopt;
+            processing_completions_ = true;
+            std::optional<Output_t> output;
+            std::size_t steps = 0;
+            try
+            {
+                while(steps++ <= completion_limit && try_completions(output, std::make_index_sequence<completion_order.size>{}))
+                {
+                }
+            } catch(...)
+            {
+                processing_completions_ = false;
+                throw;
+            }
+            processing_completions_ = false;
+            return output;
+        }
+    }
+
+    template <std::size_t... I>
+    bool try_completions(std::optional<Output_t>& output, std::index_sequence<I...>)
+    {
+        return (try_completion<row_t<completion_order.index[I]>>(output) || ...);
+    }
+
+    template <class Row>
+    bool try_completion(std::optional<Output_t>& output)
+    {
+        if(current_ != Row::from) return false;
+        using Guard = typename Row::guard_fn;
+        if constexpr(!std::is_same_v<Guard, none>)
+        {
+            if(!Guard{}(std::as_const(ctx_))) return false;
+        }
+
+        const State_t from = current_;
+        constexpr State_t to = Row::to;
+        const bool skip_hooks = (Row::flags & detail::suppress_flag) != 0 && to == from;
+
+        if(!skip_hooks) run_exit(from, to, nullptr);
+        auto result = invoke_completion_fn<typename Row::action_fn>();
+        current_ = to;
+        if(!skip_hooks) run_enter(from, to, nullptr);
+
+        if(result)
+        {
+            output = std::move(result);
+        }
+        return true;
+    }
+
+    void drain_deferrals_for_current_state()
+    {
+        if constexpr(deferral_enabled)
+        {
+            if(draining_deferrals_) return;
+            draining_deferrals_ = true;
+            try
+            {
+                for(;;)
+                {
+                    const auto slot = state_slot(current_);
+                    if(slot >= known_states.second || deferrals_[slot].empty()) break;
+                    Input_t next = std::move(deferrals_[slot].front());
+                    deferrals_[slot].pop_front();
+                    dispatch(next);
+                }
+            } catch(...)
+            {
+                draining_deferrals_ = false;
+                throw;
+            }
+            draining_deferrals_ = false;
+        }
+    }
+
+    struct no_deferrals
+    {
+    };
+    using Deferrals = std::conditional_t<deferral_enabled,
+                                         std::array<std::deque<Input_t>, known_states.second>,
+                                         no_deferrals>;
+
+    State_t current_{};
+    Ctx_t ctx_;
+    Publisher_t publisher_{};
+    std::deque<Input_t> pending_inputs_;
+    [[no_unique_address]] Deferrals deferrals_{};
+    bool draining_deferrals_ = false;
+    bool processing_completions_ = false;
+};
+
+} // namespace ct
+
+} // namespace lsm
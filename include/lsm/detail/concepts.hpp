@@ -2,6 +2,8 @@
 #define LSM_DETAIL_CONCEPTS_HPP
 
 #include <concepts>
+#include <cstddef>
+#include <functional>
 #include <optional>
 #include <type_traits>
 #include <variant>
@@ -23,6 +25,56 @@ struct is_std_variant<std::variant<Ts...>> : std::true_type
 };
 template <class T>
 constexpr bool is_std_variant_v = is_std_variant<std::remove_cvref_t<T>>::value;
+
+template <class>
+struct is_mutable_call : std::false_type
+{
+};
+template <class R, class C, class... A>
+struct is_mutable_call<R (C::*)(A...)> : std::true_type
+{
+};
+template <class R, class C, class... A>
+struct is_mutable_call<R (C::*)(A...) noexcept> : std::true_type
+{
+};
+template <class R, class C, class... A>
+struct is_mutable_call<R (C::*)(A...) &> : std::true_type
+{
+};
+template <class R, class C, class... A>
+struct is_mutable_call<R (C::*)(A...) & noexcept> : std::true_type
+{
+};
+
+template <class>
+struct is_erased_callable : std::false_type
+{
+};
+template <class Sig>
+struct is_erased_callable<std::move_only_function<Sig>> : std::true_type
+{
+};
+template <class Sig, std::size_t N>
+struct is_erased_callable<InplaceFunction<Sig, N>> : std::true_type
+{
+};
+
+// Whether calling an F may modify it (a mutable lambda, a stateful functor),
+// so one object must not be called by several machines at once. Only a
+// single non-template call operator is inspected; type-erased wrappers are
+// taken as they are.
+template <class F>
+constexpr bool has_mutable_call()
+{
+    using T = std::remove_cvref_t<F>;
+    if constexpr(!std::is_class_v<T> || is_erased_callable<T>::value)
+        return false;
+    else if constexpr(requires { &T::operator(); })
+        return is_mutable_call<decltype(&T::operator())>::value;
+    else
+        return false;
+}
 } // namespace detail
 
 template <class T>
@@ -51,6 +103,17 @@ concept PolicyHasCallableTemplate = requires {
     typename T::template Callable<void()>;
 };
 
+template<class T>
+concept PolicyHasQueueTemplate = requires {
+    typename T::template Queue<int>;
+};
+
+template<class T>
+concept PolicyHasMetrics = requires {
+    typename T::Metrics;
+    { T::Metrics::enabled } -> std::convertible_to<bool>;
+};
+
 // First-Class State Handler detection concepts
 // Optional member methods accepted; used to constrain object-centric builder overloads.
 template <class T, class State, class Input, class Output, class Ctx>
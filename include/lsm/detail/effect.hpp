@@ -160,6 +160,35 @@ struct EffectBindings<policy::ReturnOutput<Output>, CallablePolicy, State, Input
             }};
     }
 
+    // Binds a typed action straight into the variant-level Action, so the user
+    // callable is type-erased once rather than wrapped in a TypedAction first.
+    template <class Event, class Fn>
+    static Action bind_variant_action(Fn&& fn)
+    {
+        using Fn_t = std::decay_t<Fn>;
+        if constexpr(std::is_same_v<Fn_t, no_action_t>)
+        {
+            return Action{};
+        }
+        else if constexpr(std::is_same_v<Fn_t, Action>)
+        {
+            return std::forward<Fn>(fn);
+        }
+        else if constexpr(std::is_same_v<Fn_t, TypedAction<Event>>)
+        {
+            return lift_variant_action<Event>(Fn_t{std::forward<Fn>(fn)});
+        }
+        else
+        {
+            static_assert(ReturnActionForEx<Fn_t, Event, Context, Output>,
+                          "Typed action must return std::optional<Output>(const Event&, Ctx&)");
+            return Action{
+                [act = std::forward<Fn>(fn)](const Input& in, Context& ctx) mutable -> std::optional<Output> {
+                    return act(std::get<Event>(in), ctx);
+                }};
+        }
+    }
+
     template <class Fn>
     static StateAction bind_state_action(Fn&& fn)
     {
@@ -287,6 +316,33 @@ struct EffectBindings<policy::Publisher<Pub>, CallablePolicy, State, Input, Outp
             }};
     }
 
+    template <class Event, class Fn>
+    static Action bind_variant_action(Fn&& fn)
+    {
+        using Fn_t = std::decay_t<Fn>;
+        if constexpr(std::is_same_v<Fn_t, no_action_t>)
+        {
+            return Action{};
+        }
+        else if constexpr(std::is_same_v<Fn_t, Action>)
+        {
+            return std::forward<Fn>(fn);
+        }
+        else if constexpr(std::is_same_v<Fn_t, TypedAction<Event>>)
+        {
+            return lift_variant_action<Event>(Fn_t{std::forward<Fn>(fn)});
+        }
+        else
+        {
+            static_assert(PublisherActionForEx<Fn_t, Event, Context, Publisher>,
+                          "Typed action must be void(const Event&, Ctx&, Publisher&)");
+            return Action{
+                [act = std::forward<Fn>(fn)](const Input& in, Context& ctx, Publisher& publisher) mutable {
+                    act(std::get<Event>(in), ctx, publisher);
+                }};
+        }
+    }
+
     template <class Fn>
     static StateAction bind_state_action(Fn&& fn)
     {
@@ -0,0 +1,168 @@
+#ifndef LSM_DETAIL_FRAME_POOL_HPP
+#define LSM_DETAIL_FRAME_POOL_HPP
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+namespace lsm
+{
+namespace detail
+{
+
+// Per-thread cache of coroutine frame blocks, bucketed into 64-byte size
+// classes. Blocks are individual allocations, so a frame may be freed on a
+// different thread than the one that created it; it then simply joins that
+// thread's cache. Each class keeps at most `cache_limit` idle blocks, and
+// frames above `max_size` bypass the cache, as does every frame handled on a
+// thread whose cache has already been destroyed.
+class FramePool
+{
+public:
+    static constexpr std::size_t granularity = 64;
+    static constexpr std::size_t classes = 32;
+    static constexpr std::size_t max_size = granularity * classes;
+    static constexpr std::size_t cache_limit = 64;
+
+    static void* allocate(std::size_t size)
+    {
+        if(size > max_size) return ::operator new(size);
+        const auto index = class_of(size);
+        if(torn_down()) return ::operator new((index + 1) * granularity);
+        auto& cache = local();
+        if(auto* block = cache.heads[index])
+        {
+            cache.heads[index] = block->next;
+            --cache.counts[index];
+            return block;
+        }
+        return ::operator new((index + 1) * granularity);
+    }
+
+    static void deallocate(void* p, std::size_t size) noexcept
+    {
+        if(size > max_size)
+        {
+            ::operator delete(p, size);
+            return;
+        }
+        const auto index = class_of(size);
+        if(torn_down())
+        {
+            ::operator delete(p, (index + 1) * granularity);
+            return;
+        }
+        auto& cache = local();
+        if(cache.counts[index] >= cache_limit)
+        {
+            ::operator delete(p, (index + 1) * granularity);
+            return;
+        }
+        auto* block = static_cast<Block*>(p);
+        block->next = cache.heads[index];
+        cache.heads[index] = block;
+        ++cache.counts[index];
+    }
+
+    // Idle blocks cached on the calling thread.
+    static std::size_t cached() noexcept
+    {
+        std::size_t n = 0;
+        if(torn_down()) return n;
+        for(auto count : local().counts) n += count;
+        return n;
+    }
+
+private:
+    struct Block
+    {
+        Block* next;
+    };
+
+    struct Cache
+    {
+        std::array<Block*, classes> heads{};
+        std::array<std::size_t, classes> counts{};
+
+        ~Cache()
+        {
+            for(std::size_t index = 0; index < classes; ++index)
+            {
+                while(auto* block = heads[index])
+                {
+                    heads[index] = block->next;
+                    ::operator delete(block, (index + 1) * granularity);
+                }
+                counts[index] = 0;
+            }
+            torn_down() = true;
+        }
+    };
+
+    static std::size_t class_of(std::size_t size) noexcept
+    {
+        return (size + granularity - 1) / granularity - 1;
+    }
+
+    static Cache& local() noexcept
+    {
+        thread_local Cache cache;
+        return cache;
+    }
+
+    // Set once this thread's cache is destroyed; frames freed later during
+    // thread teardown must not touch it. Trivially destructible, so it stays
+    // valid until the thread is gone.
+    static bool& torn_down() noexcept
+    {
+        thread_local bool flag = false;
+        return flag;
+    }
+};
+
+// Memory resource used for coroutine frames created on this thread, or null
+// for the FramePool.
+inline std::pmr::memory_resource*& frame_resource() noexcept
+{
+    thread_local std::pmr::memory_resource* resource = nullptr;
+    return resource;
+}
+
+// Base for promise types whose frames come from frame_resource() or the
+// FramePool. A header in front of the frame remembers where it came from, so
+// the frame is returned to the right place wherever it is destroyed.
+struct PooledFrame
+{
+    static void* operator new(std::size_t size)
+    {
+        auto* resource = frame_resource();
+        const auto total = size + header_size;
+        void* raw = resource ? resource->allocate(total, alignof(std::max_align_t)) : FramePool::allocate(total);
+        auto* header = ::new(raw) Header{resource};
+        return reinterpret_cast<std::byte*>(header) + header_size;
+    }
+
+    static void operator delete(void* frame, std::size_t size) noexcept
+    {
+        auto* raw = static_cast<std::byte*>(frame) - header_size;
+        auto* resource = reinterpret_cast<Header*>(raw)->resource;
+        const auto total = size + header_size;
+        if(resource)
+            resource->deallocate(raw, total, alignof(std::max_align_t));
+        else
+            FramePool::deallocate(raw, total);
+    }
+
+private:
+    struct Header
+    {
+        std::pmr::memory_resource* resource;
+    };
+    static constexpr std::size_t header_size = alignof(std::max_align_t) > sizeof(Header) ? alignof(std::max_align_t) : sizeof(Header);
+};
+
+} // namespace detail
+} // namespace lsm
+
+#endif
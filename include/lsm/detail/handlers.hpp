@@ -41,10 +41,13 @@ struct StateHandlers
     template <typename Sig>
     using Callable = typename CallablePolicy::template Callable<Sig>;
 
-    Callable<EnterExitSig> on_enter;
-    Callable<EnterExitSig> on_exit;
-    typename Effect::StateAction on_do;
-    Callable<UnhandledSig> on_unhandled;
+    // Mutable so they can be called through the shared const Definition. Every
+    // instance calls the same object, so build_definition() rejects callables
+    // whose call operator is not const.
+    mutable Callable<EnterExitSig> on_enter;
+    mutable Callable<EnterExitSig> on_exit;
+    mutable typename Effect::StateAction on_do;
+    mutable Callable<UnhandledSig> on_unhandled;
 };
 
 // Helper adaptors that turn handler objects or pointers into stored callables
@@ -0,0 +1,202 @@
+#ifndef LSM_DETAIL_INBOX_HPP
+#define LSM_DETAIL_INBOX_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <utility>
+
+#include <lsm/detail/concepts.hpp>
+#include <lsm/detail/policy.hpp>
+
+namespace lsm
+{
+namespace detail
+{
+
+// Intrusive multi-producer single-consumer queue (Vyukov). Producers publish
+// with one atomic exchange and never wait on each other or on the consumer.
+// A pop may briefly report empty while a producer is between its exchange and
+// its link store; the element becomes visible once that store lands.
+template <class T>
+class MpscQueue
+{
+    struct Link
+    {
+        std::atomic<Link*> next{nullptr};
+    };
+    struct Node : Link
+    {
+        template <class U>
+        explicit Node(U&& v) : value(std::forward<U>(v)) {}
+        T value;
+    };
+
+public:
+    MpscQueue() noexcept : head_(&stub_), tail_(&stub_) {}
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ~MpscQueue()
+    {
+        Link* cur = tail_;
+        while(cur)
+        {
+            Link* next = cur->next.load(std::memory_order_relaxed);
+            if(cur != &stub_) delete static_cast<Node*>(cur);
+            cur = next;
+        }
+    }
+
+    // Safe to call from any thread.
+    template <class U>
+    void push(U&& value)
+    {
+        link(new Node(std::forward<U>(value)));
+    }
+
+    // Consumer thread only.
+    bool try_pop(T& out)
+    {
+        Link* tail = tail_;
+        Link* next = tail->next.load(std::memory_order_acquire);
+        if(tail == &stub_)
+        {
+            if(!next) return false;
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if(!next)
+        {
+            if(tail != head_.load(std::memory_order_acquire)) return false;
+            link(&stub_);
+            next = tail->next.load(std::memory_order_acquire);
+            if(!next) return false;
+        }
+        tail_ = next;
+        auto* node = static_cast<Node*>(tail);
+        out = std::move(node->value);
+        delete node;
+        return true;
+    }
+
+private:
+    void link(Link* node) noexcept
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Link* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    Link stub_;
+    alignas(64) std::atomic<Link*> head_;
+    alignas(64) Link* tail_;
+};
+
+// Thread-safe input mailbox for a machine. Any thread may post(); the owning
+// thread drains it, usually through MachineImpl::dispatch_inbox(). The wake
+// hook runs on the posting thread whenever the inbox goes from empty to
+// non-empty, which is the moment a sleeping consumer needs a nudge (write an
+// eventfd, signal a condition variable, schedule an actor...), and again on
+// the consumer thread when a drain leaves inputs behind, so a consumer driven
+// only by the hook never sleeps on a non-empty inbox. Consumers without an
+// event loop can block in wait() instead.
+template <class Input, PolicyHasCallableTemplate CallablePolicy = policy::copy>
+class Inbox
+{
+public:
+    using Input_t = Input;
+    using WakeHook = typename CallablePolicy::template Callable<void()>;
+
+    Inbox() = default;
+    explicit Inbox(WakeHook wake) : wake_(std::move(wake)) {}
+    Inbox(const Inbox&) = delete;
+    Inbox& operator=(const Inbox&) = delete;
+
+    // Installs the wake hook; call before producers start posting.
+    void set_wake(WakeHook wake)
+    {
+        wake_ = std::move(wake);
+    }
+
+    // Counts the input before linking it, so the consumer can never pop it
+    // first and wrap pending_ below zero.
+    template <class U>
+    void post(U&& in)
+    {
+        const bool was_empty = pending_.fetch_add(1) == 0;
+        queue_.push(std::forward<U>(in));
+        if(was_empty)
+        {
+            pending_.notify_one();
+            if(wake_) wake_();
+        }
+    }
+
+    // Pops one input. Consumer thread only; call finish_drain() once done.
+    bool try_pop(Input_t& out)
+    {
+        if(!queue_.try_pop(out)) return false;
+        pending_.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    // Hands up to `max_inputs` inputs to `fn` and returns how many were taken.
+    template <class Fn>
+    std::size_t drain(Fn&& fn, std::size_t max_inputs = std::numeric_limits<std::size_t>::max())
+    {
+        std::size_t taken = 0;
+        Input_t next;
+        while(taken < max_inputs && queue_.try_pop(next))
+        {
+            ++taken;
+            fn(std::move(next));
+        }
+        if(taken) pending_.fetch_sub(taken, std::memory_order_acq_rel);
+        finish_drain();
+        return taken;
+    }
+
+    // Ends a run of try_pop() calls. Posts that landed during the drain saw a
+    // non-empty inbox and did not wake anyone, and one may not be visible to
+    // try_pop() yet, so the hook runs here if anything is still pending.
+    void finish_drain()
+    {
+        if(pending_.load() != 0 && wake_) wake_();
+    }
+
+    // Blocks the consumer until at least one input has been posted.
+    void wait() const noexcept
+    {
+        pending_.wait(0, std::memory_order_acquire);
+    }
+
+    // Approximate while producers are active, but never below the number of
+    // inputs try_pop() can still return. Sequentially consistent so a
+    // consumer that clears a "scheduled" flag and then checks the inbox cannot
+    // miss a concurrent post.
+    std::size_t pending() const noexcept
+    {
+        return pending_.load();
+    }
+
+    bool empty() const noexcept
+    {
+        return pending() == 0;
+    }
+
+private:
+    MpscQueue<Input_t> queue_;
+    alignas(64) std::atomic<std::size_t> pending_{0};
+    WakeHook wake_{};
+};
+
+} // namespace detail
+
+template <class Input, class CallablePolicy = policy::copy>
+using Inbox = detail::Inbox<Input, CallablePolicy>;
+
+} // namespace lsm
+
+#endif
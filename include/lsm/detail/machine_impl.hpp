@@ -3,10 +3,16 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <concepts>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <iterator>
 #include <memory>
 #include <optional>
+#include <span>
+#include <stdexcept>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
@@ -16,7 +22,11 @@
 #include <lsm/detail/concepts.hpp>
 #include <lsm/detail/effect.hpp>
 #include <lsm/detail/handlers.hpp>
+#include <lsm/detail/inbox.hpp>
 #include <lsm/detail/policy.hpp>
+#include <lsm/detail/snapshot.hpp>
+#include <lsm/detail/state_index.hpp>
+#include <lsm/detail/trace_ring.hpp>
 #include <lsm/detail/types.hpp>
 
 namespace lsm
@@ -27,12 +37,17 @@ template <typename State,
           typename Output = std::monostate,
           typename Context = std::monostate,
           PolicyHasCallableTemplate CallablePolicy = policy::copy,
-          typename EffectPolicy = policy::ReturnOutput<Output>>
+          typename EffectPolicy = policy::ReturnOutput<Output>,
+          PolicyHasQueueTemplate QueuePolicy = policy::deque_queue,
+          PolicyHasMetrics MetricsPolicy = policy::no_metrics>
 class MachineImpl
 {
 public:
     template <typename Sig>
     using Callable = typename CallablePolicy::template Callable<Sig>;
+    template <typename T>
+    using Queue = typename QueuePolicy::template Queue<T>;
+    using Metrics = typename MetricsPolicy::Metrics;
 
     using State_t = State;
     using Input_t = Input;
@@ -50,9 +65,93 @@ public:
     using AnyState_t = detail::AnyState_t;
     using Policy = CallablePolicy;
     using Publisher_t = typename Effect::PublisherStorage;
+    using StateIndex = detail::StateIndex<State_t>;
 
     static constexpr AnyState_t AnyState{};
 
+    static constexpr std::size_t route_count = detail::route_count<Input_t>();
+
+    // Immutable machine topology produced by Builder::build_definition() and
+    // shared by every instance created from it. Per-state data lives in arrays
+    // addressed through `index`; transitions and completions are stored flat,
+    // with each slot owning a span of them.
+    //
+    // Dispatch goes through `routes`: for every (slot, input alternative) pair it
+    // lists the priority-ordered transitions that can match, so type-routed
+    // transitions are never looked at for other alternatives. Any-state
+    // transitions use the pseudo-slot `index.size()`.
+    //
+    // Hierarchy tables are empty for flat machines. Otherwise a substate's
+    // routes continue with its ancestors' candidates, and every transition has
+    // a precomputed domain: the innermost state it does not leave. Firing it
+    // exits from the current state up to the domain and enters the target's
+    // `lineage` below it.
+    struct Definition
+    {
+        static constexpr std::uint32_t root = static_cast<std::uint32_t>(-1);
+        static constexpr std::uint32_t internal = static_cast<std::uint32_t>(-2);
+
+        State_t initial{};
+        StateIndex index;
+        std::vector<StateHandlers> handlers;
+        std::vector<Transition> transitions;
+        detail::Span any_row;
+        std::vector<std::uint32_t> routes;
+        std::vector<std::uint32_t> route_offsets;
+        std::vector<Completion> completions;
+        std::vector<detail::Span> completion_rows;
+        mutable Callable<void(Ctx_t&, const State_t&, const Input_t&)> unhandled{};
+        bool deferral_enabled = false;
+        std::size_t completion_limit = 0;
+
+        // Parent slot per slot, or `root`.
+        std::vector<std::uint32_t> parents;
+        // Per slot, a span of `lineage_slots` listing its ancestors outermost
+        // first and ending with the slot itself.
+        std::vector<detail::Span> lineage;
+        std::vector<std::uint32_t> lineage_slots;
+        // Domain per transition and per completion; any-state transitions have
+        // one per (slot, transition) since their source is the current state.
+        std::vector<std::uint32_t> domains;
+        std::vector<std::uint32_t> any_domains;
+        std::vector<std::uint32_t> completion_domains;
+
+        detail::Span route(std::size_t slot, std::size_t alternative) const noexcept
+        {
+            const auto key = slot * route_count + alternative;
+            return {route_offsets[key], route_offsets[key + 1]};
+        }
+
+        bool hierarchical() const noexcept
+        {
+            return !parents.empty();
+        }
+
+        std::uint32_t parent(std::size_t slot) const noexcept
+        {
+            return slot < parents.size() ? parents[slot] : root;
+        }
+
+        // Number of lineage entries that lie at or above `domain`.
+        std::uint32_t depth(std::uint32_t domain) const noexcept
+        {
+            return domain < lineage.size() ? lineage[domain].end - lineage[domain].begin : 0;
+        }
+
+        // Domain of `transition` when taken from `slot`; `internal` when it
+        // neither exits nor enters anything.
+        std::uint32_t domain(std::size_t slot, std::size_t transition) const noexcept
+        {
+            if(transition < any_row.begin) return domains[transition];
+            if(slot >= index.size()) return root;
+            return any_domains[slot * (any_row.end - any_row.begin) + (transition - any_row.begin)];
+        }
+    };
+
+    // Instances are cheap: they hold the current state, context, queues and
+    // publisher, and share the Definition they were created from.
+    using Instance = MachineImpl;
+
     class Selection
     {
         friend class MachineImpl;
@@ -80,6 +179,9 @@ public:
 
     class Builder
     {
+        using EnterExitHook = Callable<void(Ctx_t&, const State_t&, const State_t&, const Input_t*)>;
+        using UnhandledHook = Callable<void(Ctx_t&, const State_t&, const Input_t&)>;
+
     public:
         using Policy = CallablePolicy;
         Builder& set_initial(State_t s)
@@ -88,6 +190,17 @@ public:
             return *this;
         }
 
+        // Nests `child` inside `parent`. A substate inherits its ancestors'
+        // transitions, tried after its own whatever their priority, and moving
+        // between states runs the exit and enter hooks of every state left or
+        // entered, innermost exits first and outermost enters first. Building
+        // throws std::invalid_argument if the declarations form a cycle.
+        Builder& set_parent(const State_t& child, const State_t& parent)
+        {
+            parents_[child] = parent;
+            return *this;
+        }
+
         Builder& enable_deferral(bool v = true)
         {
             deferral_enabled_ = v;
@@ -102,34 +215,43 @@ public:
             return *this;
         }
 
-        Builder& on_enter(const State_t& s, Callable<void(Ctx_t&, const State_t&, const State_t&, const Input_t*)> fn)
+        template <class Fn = EnterExitHook>
+        Builder& on_enter(const State_t& s, Fn&& fn)
         {
-            states_[s].on_enter = std::move(fn);
+            note_callable<Fn>();
+            states_[s].on_enter = EnterExitHook(std::forward<Fn>(fn));
             return *this;
         }
 
-        Builder& on_exit(const State_t& s, Callable<void(Ctx_t&, const State_t&, const State_t&, const Input_t*)> fn)
+        template <class Fn = EnterExitHook>
+        Builder& on_exit(const State_t& s, Fn&& fn)
         {
-            states_[s].on_exit = std::move(fn);
+            note_callable<Fn>();
+            states_[s].on_exit = EnterExitHook(std::forward<Fn>(fn));
             return *this;
         }
 
         template <class Fn = detail::no_action_t>
         Builder& on_do(const State_t& s, Fn&& fn = {})
         {
+            note_callable<Fn>();
             states_[s].on_do = Effect::bind_state_action(std::forward<Fn>(fn));
             return *this;
         }
 
-        Builder& on_unhandled(Callable<void(Ctx_t&, const State_t&, const Input_t&)> fn)
+        template <class Fn = UnhandledHook>
+        Builder& on_unhandled(Fn&& fn)
         {
-            unhandled_ = std::move(fn);
+            note_callable<Fn>();
+            unhandled_ = UnhandledHook(std::forward<Fn>(fn));
             return *this;
         }
 
-        Builder& on_unhandled(const State_t& s, Callable<void(Ctx_t&, const State_t&, const Input_t&)> fn)
+        template <class Fn = UnhandledHook>
+        Builder& on_unhandled(const State_t& s, Fn&& fn)
         {
-            states_[s].on_unhandled = std::move(fn);
+            note_callable<Fn>();
+            states_[s].on_unhandled = UnhandledHook(std::forward<Fn>(fn));
             return *this;
         }
 
@@ -229,12 +351,12 @@ public:
                     bool suppress_enter_exit = false,
                     bool defer = false)
         {
+            note_callable<ActionFn>();
+            note_callable<GuardFn>();
             Transition tr = make_transition(from, to, priority, suppress_enter_exit, defer);
-            auto type_guard = make_variant_guard<T>();
-            auto extra_guard = make_guard(std::move(guard_fn));
-            tr.guard = combine_guards(std::move(type_guard), std::move(extra_guard));
-            auto typed_action = make_variant_action<T>(std::move(action_fn));
-            tr.action = lift_variant_action<T>(std::move(typed_action));
+            tr.input_index = routed_index<T>();
+            tr.guard = make_guard(std::move(guard_fn));
+            tr.action = make_variant_action<T>(std::move(action_fn));
             return add_transition(std::move(tr));
         }
 
@@ -248,9 +370,12 @@ public:
                           bool defer = false)
             requires EqComparable<Input_t>
         {
+            note_callable<ActionFn>();
+            note_callable<GuardFn>();
             Transition tr = make_transition(from, to, priority, suppress_enter_exit, defer);
-            auto base_guard = make_value_guard(std::move(value));
-            tr.guard = combine_guards(std::move(base_guard), make_guard(std::move(guard_fn)));
+            tr.input_index = value_route(value);
+            tr.value_guard = std::is_same_v<GuardFn, detail::no_guard_t> || std::is_null_pointer_v<GuardFn>;
+            tr.guard = make_value_guard(std::move(value), std::move(guard_fn));
             tr.action = make_input_action(std::move(action_fn));
             return add_transition(std::move(tr));
         }
@@ -266,11 +391,12 @@ public:
                         bool suppress_enter_exit = false,
                         bool defer = false)
         {
+            note_callable<ActionFn>();
+            note_callable<GuardFn>();
             Transition tr = make_any_transition(to, priority, suppress_enter_exit, defer);
-            auto type_guard = make_variant_guard<T>();
-            tr.guard = combine_guards(std::move(type_guard), make_guard(std::move(guard_fn)));
-            auto typed_action = make_variant_action<T>(std::move(action_fn));
-            tr.action = lift_variant_action<T>(std::move(typed_action));
+            tr.input_index = routed_index<T>();
+            tr.guard = make_guard(std::move(guard_fn));
+            tr.action = make_variant_action<T>(std::move(action_fn));
             any_.push_back(std::move(tr));
             return *this;
         }
@@ -285,28 +411,33 @@ public:
                               bool defer = false)
             requires EqComparable<Input_t>
         {
+            note_callable<ActionFn>();
+            note_callable<GuardFn>();
             Transition tr = make_any_transition(to, priority, suppress_enter_exit, defer);
-            auto base_guard = make_value_guard(std::move(value));
-            tr.guard = combine_guards(std::move(base_guard), make_guard(std::move(guard_fn)));
+            tr.input_index = value_route(value);
+            tr.value_guard = std::is_same_v<GuardFn, detail::no_guard_t> || std::is_null_pointer_v<GuardFn>;
+            tr.guard = make_value_guard(std::move(value), std::move(guard_fn));
             tr.action = make_input_action(std::move(action_fn));
             any_.push_back(std::move(tr));
             return *this;
         }
 
-        template <class ActionFn = detail::no_action_t>
+        template <class ActionFn = detail::no_action_t, class GuardFn = CompletionGuard>
         Builder& on_completion(const State_t& from, const State_t& to,
                                ActionFn action_fn = {},
                                bool suppress_enter_exit = false,
                                int priority = 0,
-                               CompletionGuard guard = {})
+                               GuardFn guard = {})
         {
+            note_callable<ActionFn>();
+            note_callable<GuardFn>();
             Completion comp;
             comp.from = from;
             comp.to = to;
             comp.suppress_enter_exit = suppress_enter_exit;
             comp.priority = priority;
             comp.action = Effect::bind_completion_action(std::forward<ActionFn>(action_fn));
-            comp.guard = std::move(guard);
+            comp.guard = CompletionGuard(std::move(guard));
             return add_completion(std::move(comp));
         }
 
@@ -332,26 +463,25 @@ public:
 
         MachineImpl build(Ctx_t initial_ctx = {}) &&
         {
-            auto cmp = [](const Transition& a, const Transition& b) {
-                return a.priority > b.priority;
-            };
-            for(auto& [st, vec] : trans_)
-            {
-                std::stable_sort(vec.begin(), vec.end(), cmp);
-            }
-            std::stable_sort(any_.begin(), any_.end(), cmp);
-
-            auto cmp_completion = [](const Completion& a, const Completion& b) {
-                return a.priority > b.priority;
-            };
-            for(auto& [st, vec] : completions_)
-            {
-                std::stable_sort(vec.begin(), vec.end(), cmp_completion);
-            }
+            auto publisher = take_publisher();
+            return MachineImpl(std::make_shared<const Definition>(compile_definition()), std::move(initial_ctx),
+                               std::move(publisher));
+        }
 
-            return MachineImpl(std::move(initial_), std::move(states_),
-                               std::move(trans_), std::move(any_), std::move(completions_), std::move(initial_ctx),
-                               std::move(unhandled_), take_publisher(), deferral_enabled_);
+        // Compiles the builder into a Definition that any number of instances can
+        // share. A publisher set on the builder is not part of the definition;
+        // pass one to each instance instead.
+        //
+        // Every instance calls the definition's guards, actions and hooks in
+        // place, possibly from several threads, so a callable whose call
+        // operator is not const (a mutable lambda, a stateful functor) makes
+        // this throw std::invalid_argument; build() still accepts one.
+        // Type-erased callables and handler objects are not inspected.
+        std::shared_ptr<const Definition> build_definition() &&
+        {
+            if(shared_unsafe_)
+                throw std::invalid_argument("lsm::Builder: build_definition() needs const-callable guards, actions and hooks");
+            return std::make_shared<const Definition>(compile_definition());
         }
 
         class FromStage
@@ -418,13 +548,15 @@ public:
             template <class Fn>
             OnTypeStage& action(Fn&& fn)
             {
-                action_T_ = Builder::template make_variant_action<T>(std::forward<Fn>(fn));
+                b_.template note_callable<Fn>();
+                action_ = Builder::template make_variant_action<T>(std::forward<Fn>(fn));
                 return *this;
             }
 
             template <class Fn>
             OnTypeStage& guard(Fn&& fn)
             {
+                b_.template note_callable<Fn>();
                 guard_ = Builder::make_guard(std::forward<Fn>(fn));
                 return *this;
             }
@@ -450,7 +582,7 @@ public:
                 if(from_)
                 {
                     b_.on<T>(*from_, to,
-                             std::move(action_T_),
+                             std::move(action_),
                              std::move(guard_),
                              priority_,
                              suppress_enter_exit_,
@@ -459,7 +591,7 @@ public:
                 else
                 {
                     b_.on_any<T>(to,
-                                 std::move(action_T_),
+                                 std::move(action_),
                                  std::move(guard_),
                                  priority_,
                                  suppress_enter_exit_,
@@ -474,8 +606,7 @@ public:
             const AnyState_t* any_ = nullptr;
             int priority_ = 0;
             bool suppress_enter_exit_ = false;
-            using TypedAction = typename Effect::template TypedAction<T>;
-            TypedAction action_T_{};
+            Action action_{};
             Guard guard_{};
             bool defer_ = false;
         };
@@ -489,14 +620,18 @@ public:
             template <class Fn>
             OnValueStage& action(Fn&& fn)
             {
+                b_.template note_callable<Fn>();
                 action_ = Builder::make_input_action(std::forward<Fn>(fn));
                 return *this;
             }
 
+            // The value comparison and the user guard are fused into one callable
+            // here, rather than wrapping one erased guard inside another.
             template <class Fn>
             OnValueStage& guard(Fn&& fn)
             {
-                guard_ = Builder::make_guard(std::forward<Fn>(fn));
+                b_.template note_callable<Fn>();
+                guard_ = Builder::make_value_guard(value_, std::forward<Fn>(fn));
                 return *this;
             }
 
@@ -518,10 +653,16 @@ public:
 
             OnValueStage& to(const State_t& to)
             {
+                Transition tr = from_ ? Builder::make_transition(*from_, to, priority_, suppress_enter_exit_, defer_)
+                                      : Builder::make_any_transition(to, priority_, suppress_enter_exit_, defer_);
+                tr.input_index = Builder::value_route(value_);
+                tr.value_guard = !guard_;
+                tr.guard = guard_ ? std::move(guard_) : Builder::make_value_guard(value_, detail::no_guard);
+                tr.action = std::move(action_);
                 if(from_)
-                    b_.on_value(*from_, to, std::move(value_), std::move(action_), std::move(guard_), priority_, suppress_enter_exit_, defer_);
+                    b_.add_transition(std::move(tr));
                 else
-                    b_.on_any_value(to, std::move(value_), std::move(action_), std::move(guard_), priority_, suppress_enter_exit_, defer_);
+                    b_.any_.push_back(std::move(tr));
                 return *this;
             }
 
@@ -543,14 +684,18 @@ public:
             CompletionStage(Builder& b, const State_t& from)
                 : b_(b), from_(from) {}
 
-            CompletionStage& action(CompletionAction a)
+            template <class Fn>
+            CompletionStage& action(Fn&& fn)
             {
-                action_ = std::move(a);
+                b_.template note_callable<Fn>();
+                action_ = CompletionAction(std::forward<Fn>(fn));
                 return *this;
             }
-            CompletionStage& guard(CompletionGuard g)
+            template <class Fn>
+            CompletionStage& guard(Fn&& fn)
             {
-                guard_ = std::move(g);
+                b_.template note_callable<Fn>();
+                guard_ = CompletionGuard(std::forward<Fn>(fn));
                 return *this;
             }
             CompletionStage& suppress_enter_exit(bool v = true)
@@ -590,6 +735,14 @@ public:
         friend class OnTypeStage;
         friend class OnValueStage;
 
+        // Marks the builder when a callable may modify itself when called; see
+        // build_definition().
+        template <class Fn>
+        void note_callable() noexcept
+        {
+            if constexpr(detail::has_mutable_call<Fn>()) shared_unsafe_ = true;
+        }
+
         static Transition make_transition(const State_t& from,
                                           const State_t& to,
                                           int priority,
@@ -625,15 +778,9 @@ public:
         }
 
         template <class Event, class Fn>
-        static auto make_variant_action(Fn&& fn) -> typename Effect::template TypedAction<Event>
+        static Action make_variant_action(Fn&& fn)
         {
-            return Effect::template bind_typed_action<Event>(std::forward<Fn>(fn));
-        }
-
-        template <class Event>
-        static Action lift_variant_action(typename Effect::template TypedAction<Event>&& action)
-        {
-            return Effect::template lift_variant_action<Event>(std::move(action));
+            return Effect::template bind_variant_action<Event>(std::forward<Fn>(fn));
         }
 
         template <class Fn>
@@ -657,28 +804,227 @@ public:
         }
 
         template <class Event>
-        static Guard make_variant_guard()
+        static constexpr std::size_t routed_index()
         {
-            return Guard{[](const Input_t& in, const Ctx_t&) { return std::holds_alternative<Event>(in); }};
+            constexpr auto index = detail::variant_index_v<Event, Input_t>;
+            static_assert(index != detail::unrouted, "on<T>() requires T to be an alternative of Input");
+            return index;
         }
 
-        static Guard make_value_guard(Input_t value)
+        static std::size_t value_route(const Input_t& value)
         {
-            return Guard{[value = std::move(value)](const Input_t& in, const Ctx_t&) { return in == value; }};
+            if constexpr(IsVariant<Input_t>)
+            {
+                return detail::input_route(value);
+            }
+            else
+            {
+                return detail::unrouted;
+            }
         }
 
-        static Guard combine_guards(Guard primary, Guard extra)
+        // Builds the guard of a value transition: equality with `value`, and then
+        // the optional user guard, captured together in a single callable.
+        template <class Fn>
+        static Guard make_value_guard(Input_t value, Fn&& fn)
         {
-            const bool has_primary = static_cast<bool>(primary);
-            const bool has_extra = static_cast<bool>(extra);
-            if(has_primary && has_extra)
+            using Fn_t = std::decay_t<Fn>;
+            if constexpr(std::is_same_v<Fn_t, detail::no_guard_t> || std::is_same_v<Fn_t, std::nullptr_t>)
             {
+                return Guard{[value = std::move(value)](const Input_t& in, const Ctx_t&) { return in == value; }};
+            }
+            else
+            {
+                static_assert(GuardFor<Fn_t, Input_t, Ctx_t>,
+                              "guard must satisfy GuardFor<Input_t, Context>");
+                if constexpr(std::is_same_v<Fn_t, Guard>)
+                {
+                    if(!fn) return make_value_guard(std::move(value), detail::no_guard);
+                }
                 return Guard{
-                    [primary = std::move(primary), extra = std::move(extra)](const Input_t& in, const Ctx_t& ctx) mutable {
-                        return primary(in, ctx) && extra(in, ctx);
+                    [value = std::move(value), extra = std::forward<Fn>(fn)](const Input_t& in, const Ctx_t& ctx) mutable {
+                        return in == value && extra(in, ctx);
                     }};
             }
-            return has_primary ? std::move(primary) : std::move(extra);
+        }
+
+        // Flattens the builder maps into slot-indexed arrays: every state known to
+        // the machine gets a slot, and each slot owns a priority-sorted span of the
+        // flat transition and completion tables.
+        Definition compile_definition()
+        {
+            auto cmp = [](const Transition& a, const Transition& b) {
+                return a.priority > b.priority;
+            };
+            for(auto& [st, vec] : trans_)
+            {
+                std::stable_sort(vec.begin(), vec.end(), cmp);
+            }
+            std::stable_sort(any_.begin(), any_.end(), cmp);
+
+            auto cmp_completion = [](const Completion& a, const Completion& b) {
+                return a.priority > b.priority;
+            };
+            for(auto& [st, vec] : completions_)
+            {
+                std::stable_sort(vec.begin(), vec.end(), cmp_completion);
+            }
+
+            std::vector<State_t> known{initial_};
+            for(const auto& [st, handlers] : states_) known.push_back(st);
+            for(const auto& [st, vec] : trans_)
+            {
+                known.push_back(st);
+                for(const auto& t : vec) known.push_back(t.to);
+            }
+            for(const auto& t : any_) known.push_back(t.to);
+            for(const auto& [st, vec] : completions_)
+            {
+                known.push_back(st);
+                for(const auto& c : vec) known.push_back(c.to);
+            }
+            for(const auto& [child, parent] : parents_)
+            {
+                known.push_back(child);
+                known.push_back(parent);
+            }
+
+            Definition tables;
+            tables.initial = initial_;
+            tables.unhandled = std::move(unhandled_);
+            tables.deferral_enabled = deferral_enabled_;
+            tables.index = StateIndex(known);
+            const auto slots = tables.index.size();
+            tables.handlers.resize(slots);
+            tables.completion_rows.resize(slots);
+
+            for(auto& [st, handlers] : states_)
+            {
+                tables.handlers[tables.index.find(st)] = std::move(handlers);
+            }
+            link_hierarchy(tables);
+
+            std::vector<detail::Span> rows(slots + 1);
+            for(auto& [st, vec] : trans_)
+            {
+                auto& row = rows[tables.index.find(st)];
+                row.begin = static_cast<std::uint32_t>(tables.transitions.size());
+                for(auto& t : vec) tables.transitions.push_back(std::move(t));
+                row.end = static_cast<std::uint32_t>(tables.transitions.size());
+            }
+            tables.any_row.begin = static_cast<std::uint32_t>(tables.transitions.size());
+            for(auto& t : any_) tables.transitions.push_back(std::move(t));
+            tables.any_row.end = static_cast<std::uint32_t>(tables.transitions.size());
+            rows[slots] = tables.any_row;
+
+            // A slot's routes list its own candidates, then each ancestor's.
+            tables.route_offsets.reserve((slots + 1) * route_count + 1);
+            for(std::size_t slot = 0; slot <= slots; ++slot)
+            {
+                for(std::size_t alternative = 0; alternative < route_count; ++alternative)
+                {
+                    tables.route_offsets.push_back(static_cast<std::uint32_t>(tables.routes.size()));
+                    for(auto owner = slot; owner != Definition::root; owner = slot < slots ? tables.parent(owner) : Definition::root)
+                    {
+                        const auto row = rows[owner];
+                        for(auto i = row.begin; i != row.end; ++i)
+                        {
+                            const auto routed = tables.transitions[i].input_index;
+                            if(routed == detail::unrouted || routed == alternative)
+                            {
+                                tables.routes.push_back(i);
+                            }
+                        }
+                    }
+                }
+            }
+            tables.route_offsets.push_back(static_cast<std::uint32_t>(tables.routes.size()));
+            for(auto& [st, vec] : completions_)
+            {
+                auto& row = tables.completion_rows[tables.index.find(st)];
+                row.begin = static_cast<std::uint32_t>(tables.completions.size());
+                for(auto& c : vec) tables.completions.push_back(std::move(c));
+                row.end = static_cast<std::uint32_t>(tables.completions.size());
+            }
+            tables.completion_limit = tables.completions.empty() ? 0 : tables.completions.size() + 1;
+            // Firing a transition then needs no state lookup.
+            for(auto& t : tables.transitions) t.to_slot = tables.index.find(t.to);
+            for(auto& c : tables.completions) c.to_slot = tables.index.find(c.to);
+            if(tables.hierarchical()) compute_domains(tables);
+            return tables;
+        }
+
+        // Fills the parent and lineage tables from set_parent() declarations.
+        void link_hierarchy(Definition& tables) const
+        {
+            if(parents_.empty()) return;
+            const auto slots = tables.index.size();
+            tables.parents.assign(slots, Definition::root);
+            for(const auto& [child, parent] : parents_)
+            {
+                tables.parents[tables.index.find(child)] = static_cast<std::uint32_t>(tables.index.find(parent));
+            }
+
+            tables.lineage.resize(slots);
+            std::vector<std::uint32_t> chain;
+            for(std::size_t slot = 0; slot < slots; ++slot)
+            {
+                chain.clear();
+                for(auto s = static_cast<std::uint32_t>(slot); s != Definition::root; s = tables.parents[s])
+                {
+                    if(chain.size() == slots) throw std::invalid_argument("lsm::Builder: set_parent() declarations form a cycle");
+                    chain.push_back(s);
+                }
+                auto& line = tables.lineage[slot];
+                line.begin = static_cast<std::uint32_t>(tables.lineage_slots.size());
+                tables.lineage_slots.insert(tables.lineage_slots.end(), chain.rbegin(), chain.rend());
+                line.end = static_cast<std::uint32_t>(tables.lineage_slots.size());
+            }
+        }
+
+        // Innermost common ancestor of `from` and `to` that is neither of them,
+        // so that a transition between nested states leaves and re-enters the
+        // outer one.
+        static std::uint32_t common_domain(const Definition& tables, std::uint32_t from, std::uint32_t to)
+        {
+            for(auto a = tables.parents[from]; a != Definition::root; a = tables.parents[a])
+            {
+                for(auto s = tables.parents[to]; s != Definition::root; s = tables.parents[s])
+                {
+                    if(s == a) return a;
+                }
+            }
+            return Definition::root;
+        }
+
+        static void compute_domains(Definition& tables)
+        {
+            const auto slot_of = [&](const State_t& s) { return static_cast<std::uint32_t>(tables.index.find(s)); };
+            const auto domain_of = [&](std::uint32_t from, std::uint32_t to, bool suppress) {
+                return suppress && from == to ? Definition::internal : common_domain(tables, from, to);
+            };
+
+            tables.domains.reserve(tables.any_row.begin);
+            for(std::uint32_t i = 0; i < tables.any_row.begin; ++i)
+            {
+                const auto& t = tables.transitions[i];
+                tables.domains.push_back(domain_of(slot_of(t.from), slot_of(t.to), t.suppress_enter_exit));
+            }
+            const auto slots = static_cast<std::uint32_t>(tables.index.size());
+            tables.any_domains.reserve(std::size_t{slots} * (tables.any_row.end - tables.any_row.begin));
+            for(std::uint32_t slot = 0; slot < slots; ++slot)
+            {
+                for(auto i = tables.any_row.begin; i != tables.any_row.end; ++i)
+                {
+                    const auto& t = tables.transitions[i];
+                    tables.any_domains.push_back(domain_of(slot, slot_of(t.to), t.suppress_enter_exit));
+                }
+            }
+            tables.completion_domains.reserve(tables.completions.size());
+            for(const auto& c : tables.completions)
+            {
+                tables.completion_domains.push_back(domain_of(slot_of(c.from), slot_of(c.to), c.suppress_enter_exit));
+            }
         }
 
         Publisher_t take_publisher()
@@ -695,8 +1041,10 @@ public:
         std::unordered_map<State_t, std::vector<Transition>> trans_;
         std::vector<Transition> any_;
         std::unordered_map<State_t, std::vector<Completion>> completions_;
+        std::unordered_map<State_t, State_t> parents_;
         Callable<void(Ctx_t&, const State_t&, const Input_t&)> unhandled_{};
         bool deferral_enabled_ = false;
+        bool shared_unsafe_ = false;
         std::optional<Publisher_t> publisher_{};
     };
 
@@ -709,9 +1057,13 @@ public:
     {
         if(!sel) return std::nullopt;
         const auto* t = sel.get();
-        if(deferral_enabled_ && t->defer && inptr)
+        if(def_->deferral_enabled && t->defer && inptr)
         {
-            deferrals_[t->to].push_back(*inptr);
+            if(!defer_input(*t, *inptr))
+            {
+                notify_unhandled(*inptr);
+                return std::nullopt;
+            }
             apply_transition(*t, inptr, false);
             return finalize_transition(std::nullopt);
         }
@@ -721,61 +1073,141 @@ public:
 
     std::optional<Output_t> dispatch(const Input_t& in)
     {
-        auto sel = select(in);
-        if(sel)
+        const auto started = metrics_.stamp();
+        std::optional<Output_t> out;
+        if(auto sel = select(in))
         {
-            return commit(sel, &in);
+            out = commit(sel, &in);
         }
-        try
-        {
-            if(auto it = handlers_.find(current_); it != handlers_.end())
-            {
-                if(it->second.on_unhandled)
-                {
-                    it->second.on_unhandled(ctx_, current_, in);
-                    return std::nullopt;
-                }
-            }
-            if(machine_unhandled_)
-            {
-                machine_unhandled_(ctx_, current_, in);
-            }
-        } catch(...)
+        else
         {
+            notify_unhandled(in);
         }
-        return std::nullopt;
+        metrics_.record(detail::Phase::dispatch, started);
+        return out;
+    }
+
+    // Returns false if a fixed-capacity queue rejected the input.
+    bool enqueue(const Input_t& in)
+    {
+        return detail::queue_push(pending_inputs_, in);
     }
 
-    void enqueue(const Input_t& in)
+    bool enqueue(Input_t&& in)
     {
-        pending_inputs_.push_back(in);
+        return detail::queue_push(pending_inputs_, std::move(in));
     }
 
-    void enqueue(Input_t&& in)
+    std::size_t pending() const noexcept
     {
-        pending_inputs_.push_back(std::move(in));
+        return pending_inputs_.size();
+    }
+
+    // Drains inputs posted to `inbox` from other threads. Must be called from
+    // the thread that owns the machine. Returns the number of inputs consumed.
+    template <class InboxPolicy, class Sink>
+        requires std::invocable<Sink&, Output_t&&>
+    std::size_t dispatch_inbox(detail::Inbox<Input_t, InboxPolicy>& inbox, Sink&& sink, DrainLimit limit = {})
+    {
+        const auto consumed =
+            drain_from([&inbox](Input_t& in) { return inbox.try_pop(in); }, sink, limit, [] { return false; });
+        inbox.finish_drain();
+        return consumed;
     }
 
     std::vector<Output_t> dispatch_all()
     {
         std::vector<Output_t> outputs;
-        while(!pending_inputs_.empty())
+        dispatch_all([&outputs](Output_t&& out) { outputs.push_back(std::move(out)); });
+        return outputs;
+    }
+
+    // Drains the queue into `sink`, which is called once per produced output.
+    // Returns the number of inputs consumed.
+    template <class Sink>
+        requires std::invocable<Sink&, Output_t&&>
+    std::size_t dispatch_all(Sink&& sink, DrainLimit limit = {})
+    {
+        return drain_pending(sink, limit, [] { return false; });
+    }
+
+    // Dispatches `inputs` in order, passing every output to `sink`. Cheaper
+    // than calling dispatch() in a loop: the current state's route row is
+    // looked up once and reused until the state changes, and machines with
+    // neither completions nor deferral skip the post-transition bookkeeping.
+    template <class Sink>
+        requires std::invocable<Sink&, Output_t&&>
+    std::size_t dispatch_batch(std::span<const Input_t> inputs, Sink&& sink)
+    {
+        const Definition& def = *def_;
+        const bool settle = def.completion_limit || def.deferral_enabled;
+        const auto slots = def.index.size();
+        const auto* any_row = def.route_offsets.data() + slots * route_count;
+        const std::uint32_t* row = nullptr;
+        auto row_slot = StateIndex::npos;
+
+        for(const auto& in : inputs)
         {
-            Input_t next = std::move(pending_inputs_.front());
-            pending_inputs_.pop_front();
-            if(auto out = handle_input(next))
+            const auto started = metrics_.stamp();
+            if(row_slot != current_slot_)
+            {
+                row_slot = current_slot_;
+                row = row_slot < slots ? def.route_offsets.data() + row_slot * route_count : nullptr;
+            }
+            const auto* transition = match_rows(row, any_row, in);
+            if(!transition)
+            {
+                notify_unhandled(in);
+            }
+            else if(!settle)
             {
-                outputs.push_back(std::move(*out));
+                if(auto out = apply_transition(*transition, &in)) sink(std::move(*out));
             }
+            else if(def.deferral_enabled && transition->defer)
+            {
+                if(!defer_input(*transition, in))
+                {
+                    notify_unhandled(in);
+                }
+                else
+                {
+                    apply_transition(*transition, &in, false);
+                    if(auto out = finalize_transition(std::nullopt)) sink(std::move(*out));
+                }
+            }
+            else if(auto out = finalize_transition(apply_transition(*transition, &in)))
+            {
+                sink(std::move(*out));
+            }
+            metrics_.record(detail::Phase::dispatch, started);
         }
-        return outputs;
+        return inputs.size();
+    }
+
+    // Writes outputs through `out` and returns the advanced iterator.
+    template <class OutputIt>
+        requires(std::output_iterator<OutputIt, Output_t> && !std::invocable<OutputIt&, Output_t &&>)
+    OutputIt dispatch_all(OutputIt out, DrainLimit limit = {})
+    {
+        drain_pending([&out](Output_t&& value) { *out++ = std::move(value); }, limit, [] { return false; });
+        return out;
+    }
+
+    // Fills `out` from the front and returns the number of outputs written.
+    // Draining stops once the span is full; remaining inputs stay queued.
+    std::size_t dispatch_all(std::span<Output_t> out, DrainLimit limit = {})
+    {
+        std::size_t written = 0;
+        drain_pending([&](Output_t&& value) { out[written++] = std::move(value); }, limit,
+                      [&] { return written == out.size(); });
+        return written;
     }
 
     std::optional<Output_t> update()
     {
-        if(auto it = handlers_.find(current_); it != handlers_.end())
+        if(const auto* handlers = handlers_at(current_slot_))
         {
-            return Effect::invoke_state_action(*this, it->second.on_do, ctx_, current_);
+            return Effect::invoke_state_action(*this, handlers->on_do, ctx_, current_);
         }
         return std::nullopt;
     }
@@ -802,131 +1234,365 @@ public:
     }
     void set_state_direct(State_t next)
     {
+        current_slot_ = def_->index.find(next);
+        metrics_.entered(current_slot_);
+        current_ = std::move(next);
+    }
+    // As above, for a state kept elsewhere (see the adopt constructor): the
+    // move is not counted as an entry.
+    void set_state_direct(detail::adopt_t, State_t next)
+    {
+        current_slot_ = def_->index.find(next);
         current_ = std::move(next);
     }
 
-    const auto& handlers_table() const noexcept
+    const std::shared_ptr<const Definition>& definition() const noexcept
+    {
+        return def_;
+    }
+    const StateIndex& state_index() const noexcept
     {
-        return handlers_;
+        return def_->index;
     }
-    auto& handlers_table() noexcept
+    const auto& handlers_table() const noexcept
     {
-        return handlers_;
+        return def_->handlers;
     }
     const auto& transitions_table() const noexcept
     {
-        return transitions_;
+        return def_->transitions;
     }
-    const auto& any_transitions_table() const noexcept
+    std::span<const Transition> any_transitions_table() const noexcept
     {
-        return any_transitions_;
+        const auto row = def_->any_row;
+        return {def_->transitions.data() + row.begin, row.end - row.begin};
     }
     const auto& completions_table() const noexcept
     {
-        return completion_transitions_;
+        return def_->completions;
     }
 
+    // Async effects are counted, not flagged: several dispatches may have
+    // effects in flight while the machine keeps processing input.
     void begin_async_effect()
     {
-        async_inflight_ = true;
+        ++async_inflight_;
     }
     void end_async_effect()
     {
-        async_inflight_ = false;
+        assert(async_inflight_ > 0);
+        --async_inflight_;
     }
     bool async_state() const
+    {
+        return async_inflight_ != 0;
+    }
+    std::size_t async_inflight() const noexcept
     {
         return async_inflight_;
     }
 
-private:
-    MachineImpl(State_t init,
-                std::unordered_map<State_t, StateHandlers> handlers,
-                std::unordered_map<State_t, std::vector<Transition>> transitions,
-                std::vector<Transition> any,
-                std::unordered_map<State_t, std::vector<Completion>> completions,
-                Ctx_t ctx,
-                Callable<void(Ctx_t&, const State_t&, const Input_t&)> unhandled,
-                Publisher_t publisher,
-                bool deferral_enabled)
-        : current_(init), handlers_(std::move(handlers)), transitions_(std::move(transitions)), any_transitions_(std::move(any)), completion_transitions_(std::move(completions)), ctx_(std::move(ctx)), machine_unhandled_(std::move(unhandled)), publisher_(std::move(publisher)), deferral_enabled_(deferral_enabled)
+    // Records every transition and completion into `ring`, tagged with
+    // `source`; null turns tracing off. The ring must outlive the machine or
+    // be detached first, and is written from the machine's thread only.
+    void set_trace(detail::TraceRing* ring, std::uint32_t source = 0) noexcept
     {
-        if(auto it = handlers_.find(current_); it != handlers_.end())
+        trace_ = ring;
+        trace_source_ = source;
+    }
+    detail::TraceRing* trace_ring() const noexcept
+    {
+        return trace_;
+    }
+    std::uint32_t trace_source() const noexcept
+    {
+        return trace_source_;
+    }
+
+    // Appends the current state, context, pending inputs and deferral queues
+    // to `out`. State, context and inputs are written by `codec`; publisher,
+    // metrics and trace attachment are not part of a snapshot.
+    template <class Codec = detail::TrivialCodec>
+        requires detail::SnapshotCodecFor<Codec, State_t> && detail::SnapshotCodecFor<Codec, Ctx_t> &&
+                 detail::SnapshotCodecFor<Codec, Input_t>
+    void snapshot(detail::SnapshotWriter& out, const Codec& codec = {}) const
+    {
+        out.put(detail::snapshot_magic);
+        out.put(static_cast<std::uint32_t>(def_->index.size()));
+        out.put(static_cast<std::uint32_t>(def_->transitions.size()));
+        codec.encode(out, current_);
+        codec.encode(out, ctx_);
+        write_queue(out, pending_inputs_, codec);
+        std::uint32_t queued = 0;
+        for(const auto& queue : deferrals_) queued += queue.empty() ? 0 : 1;
+        out.put(queued);
+        for(std::size_t slot = 0; slot < deferrals_.size(); ++slot)
+        {
+            if(deferrals_[slot].empty()) continue;
+            out.put(static_cast<std::uint32_t>(slot));
+            write_queue(out, deferrals_[slot], codec);
+        }
+    }
+
+    template <class Codec = detail::TrivialCodec>
+        requires detail::SnapshotCodecFor<Codec, State_t> && detail::SnapshotCodecFor<Codec, Ctx_t> &&
+                 detail::SnapshotCodecFor<Codec, Input_t>
+    std::vector<std::byte> snapshot(const Codec& codec = {}) const
+    {
+        std::vector<std::byte> blob;
+        detail::SnapshotWriter out(blob);
+        snapshot(out, codec);
+        return blob;
+    }
+
+    // Replaces state, context and queues with a snapshot taken from a machine
+    // with the same definition. Returns false and leaves the machine untouched
+    // unless the whole snapshot decodes. No enter/exit hooks run. Must not be
+    // called from inside a dispatch.
+    template <class Codec = detail::TrivialCodec>
+        requires detail::SnapshotCodecFor<Codec, State_t> && detail::SnapshotCodecFor<Codec, Ctx_t> &&
+                 detail::SnapshotCodecFor<Codec, Input_t> && std::default_initializable<Ctx_t>
+    bool restore(detail::SnapshotReader& in, const Codec& codec = {})
+    {
+        assert(!draining_deferrals_ && !processing_completions_);
+        std::uint32_t magic = 0;
+        std::uint32_t states = 0;
+        std::uint32_t transitions = 0;
+        if(!in.get(magic) || !in.get(states) || !in.get(transitions)) return false;
+        if(magic != detail::snapshot_magic || states != def_->index.size() || transitions != def_->transitions.size())
+        {
+            return false;
+        }
+
+        State_t state{};
+        Ctx_t ctx{};
+        Queue<Input_t> pending;
+        if(!codec.decode(in, state) || !codec.decode(in, ctx) || !read_queue(in, pending, codec)) return false;
+
+        std::uint32_t queued = 0;
+        if(!in.get(queued) || queued > def_->index.size()) return false;
+        std::vector<Queue<Input_t>> deferrals;
+        if(queued) deferrals.resize(def_->index.size());
+        for(std::uint32_t i = 0; i < queued; ++i)
         {
-            if(it->second.on_enter) it->second.on_enter(ctx_, current_, current_, nullptr);
+            std::uint32_t slot = 0;
+            if(!in.get(slot) || slot >= deferrals.size() || !read_queue(in, deferrals[slot], codec)) return false;
         }
-        completion_limit_ = 0;
-        for(const auto& entry : completion_transitions_)
+
+        current_slot_ = def_->index.find(state);
+        current_ = std::move(state);
+        ctx_ = std::move(ctx);
+        pending_inputs_ = std::move(pending);
+        deferrals_ = std::move(deferrals);
+        metrics_.entered(current_slot_);
+        return true;
+    }
+
+    template <class Codec = detail::TrivialCodec>
+        requires detail::SnapshotCodecFor<Codec, State_t> && detail::SnapshotCodecFor<Codec, Ctx_t> &&
+                 detail::SnapshotCodecFor<Codec, Input_t> && std::default_initializable<Ctx_t>
+    bool restore(std::span<const std::byte> blob, const Codec& codec = {})
+    {
+        detail::SnapshotReader in(blob);
+        return restore(in, codec);
+    }
+
+    // Only available with an enabled metrics policy.
+    const Metrics& metrics() const noexcept
+        requires Metrics::enabled
+    {
+        return metrics_;
+    }
+    void reset_metrics()
+        requires Metrics::enabled
+    {
+        metrics_.reset();
+    }
+
+    // Resumes an instance whose state and context were kept elsewhere (see
+    // MachinePool): nothing is entered and no completions run.
+    MachineImpl(detail::adopt_t, std::shared_ptr<const Definition> definition, State_t state, Ctx_t ctx = {})
+        : def_(std::move(definition)), current_(std::move(state)), ctx_(std::move(ctx)), publisher_(Effect::default_publisher())
+    {
+        assert(def_);
+        current_slot_ = def_->index.find(current_);
+        metrics_.start(def_->transitions.size(), def_->completions.size(), def_->index.size(), current_slot_);
+    }
+
+    explicit MachineImpl(std::shared_ptr<const Definition> definition, Ctx_t ctx = {})
+        : MachineImpl(std::move(definition), std::move(ctx), Effect::default_publisher())
+    {
+    }
+
+    MachineImpl(std::shared_ptr<const Definition> definition, Ctx_t ctx, Publisher_t publisher)
+        : def_(std::move(definition)), ctx_(std::move(ctx)), publisher_(std::move(publisher))
+    {
+        assert(def_);
+        current_ = def_->initial;
+        current_slot_ = def_->index.find(current_);
+        metrics_.start(def_->transitions.size(), def_->completions.size(), def_->index.size(), current_slot_);
+        if(def_->hierarchical())
         {
-            completion_limit_ += entry.second.size();
+            enter_states(Definition::root, current_, current_, nullptr);
         }
-        if(completion_limit_)
+        else if(const auto* handlers = handlers_at(current_slot_))
         {
-            completion_limit_ += 1;
+            if(handlers->on_enter) handlers->on_enter(ctx_, current_, current_, nullptr);
         }
         finalize_transition(std::nullopt);
     }
 
+private:
+    template <class Emit, class Full>
+    std::size_t drain_pending(Emit&& emit, const DrainLimit& limit, Full&& full)
+    {
+        auto next = [this](Input_t& in) {
+            if(pending_inputs_.empty()) return false;
+            in = std::move(pending_inputs_.front());
+            pending_inputs_.pop_front();
+            return true;
+        };
+        return drain_from(next, emit, limit, full);
+    }
+
+    // Feeds inputs from `next` through handle_input() until it runs dry or the
+    // limit is reached. At least one input is attempted per call, even with a
+    // `max_inputs` of 0, unless the output is already full.
+    template <class Next, class Emit, class Full>
+    std::size_t drain_from(Next&& next, Emit&& emit, const DrainLimit& limit, Full&& full)
+    {
+        using Clock = std::chrono::steady_clock;
+        const bool timed = limit.budget != std::chrono::nanoseconds::max();
+        const auto deadline = timed ? Clock::now() + limit.budget : Clock::time_point{};
+        const auto max_inputs = std::max<std::size_t>(limit.max_inputs, 1);
+
+        std::size_t consumed = 0;
+        std::optional<Input_t> in;
+        while(consumed < max_inputs && !full())
+        {
+            if(!in) in.emplace();
+            if(!next(*in)) break;
+            ++consumed;
+            if(auto out = handle_input(*in))
+            {
+                emit(std::move(*out));
+            }
+            if(timed && Clock::now() >= deadline) break;
+        }
+        return consumed;
+    }
+
+    const StateHandlers* handlers_at(std::size_t slot) const noexcept
+    {
+        return slot < def_->handlers.size() ? &def_->handlers[slot] : nullptr;
+    }
+
     std::optional<Output_t> handle_input(const Input_t& in)
     {
+        const auto started = metrics_.stamp();
+        std::optional<Output_t> out;
         if(const auto* transition = find_transition(in))
         {
-            if(deferral_enabled_ && transition->defer)
+            if(def_->deferral_enabled && transition->defer)
+            {
+                if(!defer_input(*transition, in))
+                {
+                    notify_unhandled(in);
+                }
+                else
+                {
+                    apply_transition(*transition, &in, false);
+                    out = finalize_transition(std::nullopt);
+                }
+            }
+            else
             {
-                deferrals_[transition->to].push_back(in);
-                apply_transition(*transition, &in, false);
-                return finalize_transition(std::nullopt);
+                out = finalize_transition(apply_transition(*transition, &in));
             }
-            auto out = apply_transition(*transition, &in);
-            return finalize_transition(std::move(out));
         }
+        else
+        {
+            notify_unhandled(in);
+        }
+        metrics_.record(detail::Phase::dispatch, started);
+        return out;
+    }
 
+    void notify_unhandled(const Input_t& in)
+    {
+        metrics_.unhandled(current_slot_);
         try
         {
-            if(auto it = handlers_.find(current_); it != handlers_.end())
+            if(const auto* handlers = handlers_at(current_slot_))
             {
-                if(it->second.on_unhandled)
+                if(handlers->on_unhandled)
                 {
-                    it->second.on_unhandled(ctx_, current_, in);
-                    return std::nullopt;
+                    handlers->on_unhandled(ctx_, current_, in);
+                    return;
                 }
             }
-            if(machine_unhandled_)
+            if(def_->unhandled)
             {
-                machine_unhandled_(ctx_, current_, in);
+                def_->unhandled(ctx_, current_, in);
             }
         } catch(...)
         {
         }
-        return std::nullopt;
     }
 
     const Transition* find_transition(const Input_t& input) const
     {
-        const auto& ctx = context();
-        const auto& current = state();
+        const auto started = metrics_.stamp();
+        const auto alternative = detail::input_route(input);
+        const auto slots = def_->index.size();
 
-        const auto& tmap = transitions_table();
-        if(auto it = tmap.find(current); it != tmap.end())
+        const Transition* found = nullptr;
+        if(current_slot_ < slots)
         {
-            for(const auto& candidate : it->second)
-            {
-                if(!candidate.guard || candidate.guard(input, ctx))
-                {
-                    return &candidate;
-                }
-            }
+            found = match_route(def_->route(current_slot_, alternative), input);
         }
+        if(!found)
+        {
+            found = match_route(def_->route(slots, alternative), input);
+        }
+        metrics_.record(detail::Phase::select, started);
+        return found;
+    }
+
+    // find_transition() for dispatch_batch(), with the route rows of the
+    // current state (null if it has none) and of the any-state pseudo-slot
+    // already resolved.
+    const Transition* match_rows(const std::uint32_t* row, const std::uint32_t* any_row, const Input_t& input) const
+    {
+        const auto started = metrics_.stamp();
+        const auto alternative = detail::input_route(input);
+        const Transition* found = nullptr;
+        if(row)
+        {
+            found = match_route({row[alternative], row[alternative + 1]}, input);
+        }
+        if(!found)
+        {
+            found = match_route({any_row[alternative], any_row[alternative + 1]}, input);
+        }
+        metrics_.record(detail::Phase::select, started);
+        return found;
+    }
 
-        const auto& any = any_transitions_table();
-        for(const auto& candidate : any)
+    const Transition* match_route(detail::Span route, const Input_t& input) const
+    {
+        const auto& ctx = context();
+        const auto* routes = def_->routes.data();
+        const auto* transitions = def_->transitions.data();
+        for(auto i = route.begin; i != route.end; ++i)
         {
+            const auto& candidate = transitions[routes[i]];
             if(!candidate.guard || candidate.guard(input, ctx))
             {
                 return &candidate;
             }
+            metrics_.rejected(routes[i]);
         }
-
         return nullptr;
     }
 
@@ -935,40 +1601,44 @@ private:
                                              bool invoke_action = true)
     {
         auto& ctx = context();
-        auto& table = handlers_table();
 
+        const auto id = static_cast<std::size_t>(&transition - def_->transitions.data());
         const auto from = state();
         const auto to = transition.to;
-        const bool skip_hooks = transition.suppress_enter_exit && to == from;
+        const auto domain = def_->hierarchical() ? def_->domain(current_slot_, id) : Definition::root;
+        const bool stay = domain == Definition::internal;
+        const auto to_slot = stay ? current_slot_ : transition.to_slot;
+        const bool skip_hooks = stay || (!def_->hierarchical() && transition.suppress_enter_exit && to == from);
 
         if(!skip_hooks)
         {
-            if(auto it = table.find(from); it != table.end())
-            {
-                if(it->second.on_exit)
-                {
-                    it->second.on_exit(ctx, from, to, input);
-                }
-            }
+            exit_states(domain, from, to, input);
         }
 
         std::optional<Output_t> output;
         if(invoke_action && input)
         {
+            const auto started = metrics_.stamp();
             output = Effect::invoke_transition_action(*this, transition.action, *input, ctx);
+            if(transition.action) metrics_.record(detail::Phase::action, started);
         }
 
-        set_state_direct(to);
+        if(trace_)
+        {
+            const std::uint8_t flags = (output ? detail::TraceRecord::output : 0) | (invoke_action ? 0 : detail::TraceRecord::deferred);
+            trace(id, to_slot, input ? static_cast<std::uint16_t>(detail::input_route(*input)) : detail::TraceRecord::no_input, flags);
+        }
+        metrics_.fired(id);
+        metrics_.entered(to_slot);
+        if(!stay)
+        {
+            current_ = to;
+            current_slot_ = to_slot;
+        }
 
         if(!skip_hooks)
         {
-            if(auto it = table.find(to); it != table.end())
-            {
-                if(it->second.on_enter)
-                {
-                    it->second.on_enter(ctx, from, to, input);
-                }
-            }
+            enter_states(domain, from, to, input);
         }
 
         return output;
@@ -976,19 +1646,21 @@ private:
 
     const Completion* find_completion() const
     {
-        const auto& ctx = context();
-        const auto& current = state();
+        if(current_slot_ >= def_->completion_rows.size())
+        {
+            return nullptr;
+        }
 
-        const auto& cmap = completions_table();
-        if(auto it = cmap.find(current); it != cmap.end())
+        const auto& ctx = context();
+        const auto row = def_->completion_rows[current_slot_];
+        for(auto i = row.begin; i != row.end; ++i)
         {
-            for(const auto& candidate : it->second)
+            const auto& candidate = def_->completions[i];
+            if(!candidate.guard || candidate.guard(ctx))
             {
-                if(!candidate.guard || candidate.guard(ctx))
-                {
-                    return &candidate;
-                }
+                return &candidate;
             }
+            metrics_.completion_rejected(i);
         }
 
         return nullptr;
@@ -997,41 +1669,87 @@ private:
     std::optional<Output_t> apply_completion(const Completion& completion)
     {
         auto& ctx = context();
-        auto& table = handlers_table();
 
+        const auto id = static_cast<std::size_t>(&completion - def_->completions.data());
         const auto from = state();
         const auto to = completion.to;
-        const bool skip_hooks = completion.suppress_enter_exit && to == from;
+        const auto to_slot = completion.to_slot;
+        const auto domain = def_->hierarchical() ? def_->completion_domains[id] : Definition::root;
+        const bool skip_hooks = def_->hierarchical() ? domain == Definition::internal
+                                                     : completion.suppress_enter_exit && to == from;
 
         if(!skip_hooks)
         {
-            if(auto it = table.find(from); it != table.end())
-            {
-                if(it->second.on_exit)
-                {
-                    it->second.on_exit(ctx, from, to, nullptr);
-                }
-            }
+            exit_states(domain, from, to, nullptr);
         }
 
         std::optional<Output_t> output = Effect::invoke_completion_action(*this, completion.action, ctx);
 
-        set_state_direct(to);
+        if(trace_)
+        {
+            const std::uint8_t flags = detail::TraceRecord::completion | (output ? detail::TraceRecord::output : 0);
+            trace(id, to_slot, detail::TraceRecord::no_input, flags);
+        }
+        metrics_.completion_fired(id);
+        metrics_.entered(to_slot);
+        current_ = to;
+        current_slot_ = to_slot;
 
         if(!skip_hooks)
         {
-            if(auto it = table.find(to); it != table.end())
-            {
-                if(it->second.on_enter)
-                {
-                    it->second.on_enter(ctx, from, to, nullptr);
-                }
-            }
+            enter_states(domain, from, to, nullptr);
         }
 
         return output;
     }
 
+    // Runs exit hooks from the current state up to, not including, `domain`.
+    // Flat machines only ever exit the current state.
+    void exit_states(std::uint32_t domain, const State_t& from, const State_t& to, const Input_t* input)
+    {
+        auto slot = current_slot_;
+        do
+        {
+            run_hook(slot, false, from, to, input);
+            slot = def_->parent(slot);
+        } while(slot != domain);
+    }
+
+    // Runs enter hooks for the current state's lineage below `domain`,
+    // outermost first.
+    void enter_states(std::uint32_t domain, const State_t& from, const State_t& to, const Input_t* input)
+    {
+        if(!def_->hierarchical() || current_slot_ >= def_->lineage.size())
+        {
+            run_hook(current_slot_, true, from, to, input);
+            return;
+        }
+        const auto line = def_->lineage[current_slot_];
+        for(auto i = line.begin + def_->depth(domain); i != line.end; ++i)
+        {
+            run_hook(def_->lineage_slots[i], true, from, to, input);
+        }
+    }
+
+    void run_hook(std::size_t slot, bool enter, const State_t& from, const State_t& to, const Input_t* input)
+    {
+        const auto* handlers = handlers_at(slot);
+        if(!handlers) return;
+        auto& hook = enter ? handlers->on_enter : handlers->on_exit;
+        if(hook)
+        {
+            const auto started = metrics_.stamp();
+            hook(ctx_, from, to, input);
+            metrics_.record(detail::Phase::hooks, started);
+        }
+    }
+
+    void trace(std::size_t id, std::size_t to_slot, std::uint16_t input, std::uint8_t flags) noexcept
+    {
+        trace_->write({detail::TraceRing::now(), trace_source_, static_cast<std::uint32_t>(current_slot_),
+                       static_cast<std::uint32_t>(to_slot), static_cast<std::uint32_t>(id), input, flags, 0, 0});
+    }
+
     std::optional<Output_t> finalize_transition(std::optional<Output_t> result)
     {
         auto completion_out = process_completions();
@@ -1045,11 +1763,11 @@ private:
 
     std::optional<Output_t> process_completions()
     {
-        if(!completion_limit_ || processing_completions_)
+        if(!def_->completion_limit || processing_completions_)
         {
             return std::nullopt;
         }
-        assert(!async_inflight_);
+        const auto started = metrics_.stamp();
         processing_completions_ = true;
         std::optional<Output_t> output;
         std::size_t steps = 0;
@@ -1057,7 +1775,7 @@ private:
         {
             while(const auto* completion = find_completion())
             {
-                if(steps++ > completion_limit_)
+                if(steps++ > def_->completion_limit)
                 {
                     break;
                 }
@@ -1073,21 +1791,36 @@ private:
             throw;
         }
         processing_completions_ = false;
+        metrics_.record(detail::Phase::completions, started);
         return output;
     }
 
+    // Queues `in` for the target of `transition`. Returns false when the queue policy rejects it
+    // (a full fixed ring with overflow::reject); the caller then leaves the
+    // state unchanged and reports the input as unhandled.
+    bool defer_input(const Transition& transition, const Input_t& in)
+    {
+        const auto slot = transition.to_slot;
+        if(slot == StateIndex::npos) return false;
+        if(deferrals_.size() <= slot)
+        {
+            deferrals_.resize(def_->index.size());
+        }
+        return detail::queue_push(deferrals_[slot], in);
+    }
+
     void drain_deferrals_for_current_state()
     {
-        if(!deferral_enabled_ || draining_deferrals_) return;
+        if(!def_->deferral_enabled || draining_deferrals_) return;
         draining_deferrals_ = true;
         try
         {
-            for(;;)
+            while(current_slot_ < deferrals_.size())
             {
-                auto it = deferrals_.find(current_);
-                if(it == deferrals_.end() || it->second.empty()) break;
-                Input_t next = std::move(it->second.front());
-                it->second.pop_front();
+                auto& queue = deferrals_[current_slot_];
+                if(queue.empty()) break;
+                Input_t next = std::move(queue.front());
+                queue.pop_front();
                 handle_input(next);
             }
         } catch(...)
@@ -1099,21 +1832,40 @@ private:
     }
 
 private:
+    template <class Codec>
+    static void write_queue(detail::SnapshotWriter& out, const Queue<Input_t>& queue, const Codec& codec)
+    {
+        out.put(static_cast<std::uint32_t>(queue.size()));
+        for(std::size_t i = 0; i < queue.size(); ++i) codec.encode(out, queue[i]);
+    }
+
+    template <class Codec>
+    static bool read_queue(detail::SnapshotReader& in, Queue<Input_t>& queue, const Codec& codec)
+    {
+        std::uint32_t count = 0;
+        if(!in.get(count)) return false;
+        for(std::uint32_t i = 0; i < count; ++i)
+        {
+            Input_t value{};
+            if(!codec.decode(in, value) || !detail::queue_push(queue, std::move(value))) return false;
+        }
+        return true;
+    }
+
+    std::shared_ptr<const Definition> def_;
     State_t current_{};
-    std::unordered_map<State_t, StateHandlers> handlers_;
-    std::unordered_map<State_t, std::vector<Transition>> transitions_;
-    std::vector<Transition> any_transitions_;
-    std::unordered_map<State_t, std::vector<Completion>> completion_transitions_;
-    std::deque<Input_t> pending_inputs_;
+    std::size_t current_slot_ = StateIndex::npos;
+    Queue<Input_t> pending_inputs_;
     Ctx_t ctx_;
-    Callable<void(Ctx_t&, const State_t&, const Input_t&)> machine_unhandled_{};
     Publisher_t publisher_{};
-    std::unordered_map<State_t, std::deque<Input_t>> deferrals_;
-    bool deferral_enabled_ = false;
+    std::vector<Queue<Input_t>> deferrals_;
     bool draining_deferrals_ = false;
-    std::size_t completion_limit_ = 0;
     bool processing_completions_ = false;
-    bool async_inflight_ = false;
+    std::size_t async_inflight_ = 0;
+    detail::TraceRing* trace_ = nullptr;
+    std::uint32_t trace_source_ = 0;
+    // Mutable so that select() can count guard rejections and time lookups.
+    [[no_unique_address]] mutable Metrics metrics_;
 };
 
 } // namespace lsm
@@ -0,0 +1,328 @@
+#ifndef LSM_DETAIL_METRICS_HPP
+#define LSM_DETAIL_METRICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace lsm
+{
+namespace detail
+{
+
+struct TransitionCounters
+{
+    std::uint64_t fired = 0;
+    std::uint64_t rejected = 0; // guard returned false
+};
+
+template <class Duration>
+struct StateCounters
+{
+    std::uint64_t entries = 0;
+    std::uint64_t unhandled = 0;
+    Duration dwell{}; // time spent in the state, up to its last exit
+};
+
+// Log-bucketed latency histogram in nanoseconds, in the style of HDR
+// histograms: values below 8 are exact, above that each power of two is split
+// into 8 linear sub-buckets, so any recorded value is reported within 12.5%.
+// Values above `max_trackable` land in the top bucket. Fixed size, no
+// allocation; histograms of the same type merge by adding buckets.
+class LatencyHistogram
+{
+public:
+    static constexpr std::size_t sub_buckets = 8;
+    static constexpr unsigned max_bits = 44; // ~4.9 hours
+    static constexpr std::uint64_t max_trackable = (std::uint64_t{1} << max_bits) - 1;
+    static constexpr std::size_t bucket_count = (max_bits - 2) * sub_buckets;
+
+    void record(std::uint64_t ns) noexcept
+    {
+        ++buckets_[bucket_of(ns)];
+        ++count_;
+        min_ = std::min(min_, ns);
+        max_ = std::max(max_, ns);
+    }
+
+    template <class Rep, class Period>
+    void record(std::chrono::duration<Rep, Period> elapsed) noexcept
+    {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        record(ns > 0 ? static_cast<std::uint64_t>(ns) : 0);
+    }
+
+    std::uint64_t count() const noexcept
+    {
+        return count_;
+    }
+    std::uint64_t min() const noexcept
+    {
+        return count_ ? min_ : 0;
+    }
+    std::uint64_t max() const noexcept
+    {
+        return max_;
+    }
+
+    // Smallest bucket bound that covers `percentile` (0..100) of the recorded
+    // values, clamped to the largest value seen.
+    std::uint64_t percentile(double percentile) const noexcept
+    {
+        if(!count_) return 0;
+        const auto rank = std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(count_));
+        const auto target = std::max<std::uint64_t>(static_cast<std::uint64_t>(rank), 1);
+        std::uint64_t seen = 0;
+        for(std::size_t bucket = 0; bucket < bucket_count; ++bucket)
+        {
+            seen += buckets_[bucket];
+            if(seen >= target) return std::min(highest_in(bucket), max_);
+        }
+        return max_;
+    }
+
+    void merge(const LatencyHistogram& other) noexcept
+    {
+        for(std::size_t bucket = 0; bucket < bucket_count; ++bucket) buckets_[bucket] += other.buckets_[bucket];
+        if(other.count_)
+        {
+            min_ = std::min(min_, other.min_);
+            max_ = std::max(max_, other.max_);
+        }
+        count_ += other.count_;
+    }
+
+    void reset() noexcept
+    {
+        *this = LatencyHistogram{};
+    }
+
+    static constexpr std::size_t bucket_of(std::uint64_t ns) noexcept
+    {
+        ns = std::min(ns, max_trackable);
+        if(ns < sub_buckets) return static_cast<std::size_t>(ns);
+        const auto msb = static_cast<unsigned>(std::bit_width(ns)) - 1;
+        const auto sub = (ns >> (msb - 3)) & (sub_buckets - 1);
+        return (msb - 2) * sub_buckets + static_cast<std::size_t>(sub);
+    }
+
+    // Largest value that maps to `bucket`.
+    static constexpr std::uint64_t highest_in(std::size_t bucket) noexcept
+    {
+        if(bucket < sub_buckets) return bucket;
+        const auto shift = bucket / sub_buckets - 1;
+        const auto low = (sub_buckets + bucket % sub_buckets) << shift;
+        return low + (std::uint64_t{1} << shift) - 1;
+    }
+
+private:
+    std::array<std::uint64_t, bucket_count> buckets_{};
+    std::uint64_t count_ = 0;
+    std::uint64_t min_ = max_trackable;
+    std::uint64_t max_ = 0;
+};
+
+// Where a latency sample was taken.
+enum class Phase : std::uint8_t
+{
+    dispatch,    // one input, from selection through completions and deferral drains
+    select,      // transition lookup, including guards
+    action,      // transition action
+    hooks,       // a single on_exit or on_enter
+    completions, // the completion pass after a transition
+};
+
+// Exported copy of a machine's latency histograms. Snapshots from several
+// instances merge into one for fleet-wide percentiles.
+struct LatencySnapshot
+{
+    LatencyHistogram dispatch;
+    LatencyHistogram select;
+    LatencyHistogram action;
+    LatencyHistogram hooks;
+    LatencyHistogram completions;
+
+    LatencyHistogram& operator[](Phase phase) noexcept
+    {
+        switch(phase)
+        {
+        case Phase::dispatch: return dispatch;
+        case Phase::select: return select;
+        case Phase::action: return action;
+        case Phase::hooks: return hooks;
+        case Phase::completions: break;
+        }
+        return completions;
+    }
+
+    LatencySnapshot& merge(const LatencySnapshot& other) noexcept
+    {
+        dispatch.merge(other.dispatch);
+        select.merge(other.select);
+        action.merge(other.action);
+        hooks.merge(other.hooks);
+        completions.merge(other.completions);
+        return *this;
+    }
+
+    void reset() noexcept
+    {
+        *this = LatencySnapshot{};
+    }
+};
+
+// Returned by stamp() when latency is not tracked.
+struct NoStamp
+{
+};
+
+// Counters kept by a machine built with policy::metrics. Each array is flat
+// and indexed like the matching Definition table: transitions() like
+// transitions_table(), completions() like completions_table(), states() by
+// state_index() slot. With `Timed`, latency samples go to a LatencySnapshot.
+template <class Clock, bool Timed>
+class MachineMetrics
+{
+public:
+    static constexpr bool enabled = true;
+    static constexpr bool timed = Timed;
+    using clock = Clock;
+    using duration = typename Clock::duration;
+    using Stamp = std::conditional_t<Timed, typename Clock::time_point, NoStamp>;
+
+    Stamp stamp() const noexcept
+    {
+        if constexpr(Timed)
+            return Clock::now();
+        else
+            return {};
+    }
+
+    void record(Phase phase, Stamp started) noexcept
+    {
+        if constexpr(Timed) latency_[phase].record(Clock::now() - started);
+    }
+
+    const LatencySnapshot& latency() const noexcept
+        requires Timed
+    {
+        return latency_;
+    }
+
+    void start(std::size_t transitions, std::size_t completions, std::size_t states, std::size_t slot)
+    {
+        transitions_.assign(transitions, {});
+        completions_.assign(completions, {});
+        states_.assign(states, {});
+        slot_ = slot;
+        entered_ = Clock::now();
+        if(slot_ < states_.size()) ++states_[slot_].entries;
+    }
+
+    void fired(std::size_t transition) noexcept
+    {
+        ++transitions_[transition].fired;
+    }
+    void rejected(std::size_t transition) noexcept
+    {
+        ++transitions_[transition].rejected;
+    }
+    void completion_fired(std::size_t completion) noexcept
+    {
+        ++completions_[completion].fired;
+    }
+    void completion_rejected(std::size_t completion) noexcept
+    {
+        ++completions_[completion].rejected;
+    }
+    void unhandled(std::size_t slot) noexcept
+    {
+        if(slot < states_.size()) ++states_[slot].unhandled;
+    }
+
+    // Closes the dwell interval of the current state and opens one for `to`.
+    void entered(std::size_t to)
+    {
+        const auto now = Clock::now();
+        if(slot_ < states_.size()) states_[slot_].dwell += now - entered_;
+        if(to < states_.size()) ++states_[to].entries;
+        slot_ = to;
+        entered_ = now;
+    }
+
+    std::span<const TransitionCounters> transitions() const noexcept
+    {
+        return transitions_;
+    }
+    std::span<const TransitionCounters> completions() const noexcept
+    {
+        return completions_;
+    }
+    std::span<const StateCounters<duration>> states() const noexcept
+    {
+        return states_;
+    }
+
+    // Total dwell time of `slot`, including the interval still open if it is
+    // the current state.
+    duration dwell(std::size_t slot) const
+    {
+        if(slot >= states_.size()) return {};
+        auto total = states_[slot].dwell;
+        if(slot == slot_) total += Clock::now() - entered_;
+        return total;
+    }
+
+    // Zeroes every counter; the current state's dwell restarts now.
+    void reset()
+    {
+        for(auto& counters : transitions_) counters = {};
+        for(auto& counters : completions_) counters = {};
+        for(auto& counters : states_) counters = {};
+        if constexpr(Timed) latency_.reset();
+        entered_ = Clock::now();
+    }
+
+private:
+    std::vector<TransitionCounters> transitions_;
+    std::vector<TransitionCounters> completions_;
+    std::vector<StateCounters<duration>> states_;
+    std::size_t slot_ = static_cast<std::size_t>(-1);
+    typename Clock::time_point entered_{};
+    [[no_unique_address]] std::conditional_t<Timed, LatencySnapshot, NoStamp> latency_{};
+};
+
+// Stand-in for policy::no_metrics. Every hook is an empty inline function, so
+// instrumented call sites compile away.
+struct NoMetrics
+{
+    static constexpr bool enabled = false;
+    static constexpr bool timed = false;
+    using Stamp = NoStamp;
+
+    Stamp stamp() const noexcept
+    {
+        return {};
+    }
+    void record(Phase, Stamp) noexcept {}
+
+    void start(std::size_t, std::size_t, std::size_t, std::size_t) noexcept {}
+    void fired(std::size_t) noexcept {}
+    void rejected(std::size_t) noexcept {}
+    void completion_fired(std::size_t) noexcept {}
+    void completion_rejected(std::size_t) noexcept {}
+    void unhandled(std::size_t) noexcept {}
+    void entered(std::size_t) noexcept {}
+};
+
+} // namespace detail
+} // namespace lsm
+
+#endif
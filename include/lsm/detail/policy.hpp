@@ -1,7 +1,15 @@
 #ifndef LSM_DETAIL_POLICY_HPP
 #define LSM_DETAIL_POLICY_HPP
 
+#include <chrono>
+#include <cstddef>
 #include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <lsm/detail/metrics.hpp>
+#include <lsm/detail/queue.hpp>
 
 namespace lsm
 {
@@ -20,6 +28,140 @@ struct policy_move
     using Callable = std::move_only_function<Sig>;
 };
 
+template <class Sig, std::size_t Capacity>
+class InplaceFunction;
+
+// Move-only callable stored in a fixed inline buffer. Callables larger than
+// `Capacity` are rejected at compile time, so construction never allocates and
+// a call is a single indirect jump into the stored object.
+template <class R, class... Args, std::size_t Capacity>
+class InplaceFunction<R(Args...), Capacity>
+{
+    static_assert(Capacity > 0, "policy::inplace<N> requires N > 0");
+
+public:
+    InplaceFunction() noexcept = default;
+    InplaceFunction(std::nullptr_t) noexcept {}
+
+    template <class F>
+        requires(!std::is_same_v<std::remove_cvref_t<F>, InplaceFunction> &&
+                 std::is_invocable_r_v<R, std::decay_t<F>&, Args...>)
+    InplaceFunction(F&& fn)
+    {
+        using Fn = std::decay_t<F>;
+        static_assert(sizeof(Fn) <= Capacity, "callable does not fit policy::inplace<N>; increase N");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "over-aligned callables are not supported by policy::inplace<N>");
+        static_assert(std::is_nothrow_move_constructible_v<Fn>, "policy::inplace<N> requires nothrow-movable callables");
+
+        // Functions passed by reference decay to pointers that cannot be null.
+        using Arg = std::remove_cvref_t<F>;
+        if constexpr(std::is_pointer_v<Arg> || std::is_member_pointer_v<Arg>)
+        {
+            if(fn == nullptr) return;
+        }
+        ::new(static_cast<void*>(storage_)) Fn(std::forward<F>(fn));
+        invoke_ = [](void* self, Args&&... args) -> R {
+            return std::invoke_r<R>(*static_cast<Fn*>(self), std::forward<Args>(args)...);
+        };
+        relocate_ = [](void* dst, void* src) noexcept {
+            auto* from = static_cast<Fn*>(src);
+            if(dst) ::new(dst) Fn(std::move(*from));
+            from->~Fn();
+        };
+    }
+
+    InplaceFunction(InplaceFunction&& other) noexcept
+    {
+        take(other);
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other) noexcept
+    {
+        if(this != &other)
+        {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    InplaceFunction(const InplaceFunction&) = delete;
+    InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+    ~InplaceFunction()
+    {
+        reset();
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return invoke_ != nullptr;
+    }
+
+    R operator()(Args... args)
+    {
+        return invoke_(static_cast<void*>(storage_), std::forward<Args>(args)...);
+    }
+
+private:
+    void take(InplaceFunction& other) noexcept
+    {
+        if(!other.invoke_) return;
+        other.relocate_(static_cast<void*>(storage_), static_cast<void*>(other.storage_));
+        invoke_ = std::exchange(other.invoke_, nullptr);
+        relocate_ = std::exchange(other.relocate_, nullptr);
+    }
+
+    void reset() noexcept
+    {
+        if(!invoke_) return;
+        relocate_(nullptr, static_cast<void*>(storage_));
+        invoke_ = nullptr;
+        relocate_ = nullptr;
+    }
+
+    R (*invoke_)(void*, Args&&...) = nullptr;
+    void (*relocate_)(void*, void*) noexcept = nullptr;
+    alignas(std::max_align_t) unsigned char storage_[Capacity];
+};
+
+template <std::size_t N>
+struct policy_inplace
+{
+    template <typename Sig>
+    using Callable = InplaceFunction<Sig, N>;
+};
+
+struct policy_deque_queue
+{
+    template <typename T>
+    using Queue = std::deque<T>;
+};
+
+template <std::size_t Capacity, class Overflow>
+struct policy_ring_queue
+{
+    template <typename T>
+    using Queue = RingQueue<T, Capacity, Overflow>;
+};
+
+struct policy_no_metrics
+{
+    using Metrics = NoMetrics;
+};
+
+template <class Clock, bool Timed>
+struct policy_metrics
+{
+    using Metrics = MachineMetrics<Clock, Timed>;
+};
+
 } // namespace detail
 
 namespace policy
@@ -28,6 +170,37 @@ namespace policy
 using copy = detail::policy_copy;
 using move = detail::policy_move;
 
+// Stores guards, actions and hooks in N-byte inline buffers; captures that do
+// not fit fail to compile instead of falling back to the heap.
+template <std::size_t N>
+using inplace = detail::policy_inplace<N>;
+
+namespace overflow
+{
+using reject = detail::overflow_reject;
+using drop_oldest = detail::overflow_drop_oldest;
+} // namespace overflow
+
+// Queue policies select the container behind the input and deferral queues.
+// `ring_queue<0>` is a growable power-of-two ring; a non-zero capacity is fixed
+// and handles overflow as requested.
+using deque_queue = detail::policy_deque_queue;
+
+template <std::size_t Capacity = 0, class Overflow = overflow::reject>
+using ring_queue = detail::policy_ring_queue<Capacity, Overflow>;
+
+// Metrics policies decide whether a machine counts transition fires, guard
+// rejections, unhandled inputs and per-state dwell time. `no_metrics` stores
+// nothing and compiles every hook away. `latency_metrics` adds latency
+// histograms for dispatch, selection, actions, enter/exit hooks and
+// completions, at the cost of two clock reads per timed phase.
+using no_metrics = detail::policy_no_metrics;
+
+template <class Clock = std::chrono::steady_clock, bool Timed = false>
+using basic_metrics = detail::policy_metrics<Clock, Timed>;
+using metrics = basic_metrics<>;
+using latency_metrics = basic_metrics<std::chrono::steady_clock, true>;
+
 template <class Output>
 struct ReturnOutput
 {
@@ -0,0 +1,206 @@
+#ifndef LSM_DETAIL_QUEUE_HPP
+#define LSM_DETAIL_QUEUE_HPP
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace lsm
+{
+namespace detail
+{
+
+// Overflow behaviour of a fixed-capacity RingQueue.
+struct overflow_reject
+{
+};
+struct overflow_drop_oldest
+{
+};
+
+// Contiguous FIFO over a power-of-two buffer. `Capacity == 0` grows by
+// doubling; any other capacity is fixed and applies `Overflow` when full.
+// Storage is allocated on first push and reused afterwards, so a queue in
+// steady state never touches the allocator.
+template <class T, std::size_t Capacity = 0, class Overflow = overflow_reject>
+class RingQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "ring_queue capacity must be a power of two");
+    static_assert(std::is_same_v<Overflow, overflow_reject> || std::is_same_v<Overflow, overflow_drop_oldest>,
+                  "ring_queue overflow must be overflow::reject or overflow::drop_oldest");
+
+public:
+    using value_type = T;
+    static constexpr bool growable = Capacity == 0;
+    static constexpr std::size_t initial_capacity = growable ? 8 : Capacity;
+
+    RingQueue() noexcept = default;
+
+    RingQueue(const RingQueue& other)
+    {
+        for(std::size_t i = 0; i < other.size(); ++i)
+        {
+            push_back(other.at(i));
+        }
+    }
+
+    RingQueue(RingQueue&& other) noexcept
+        : slots_(std::exchange(other.slots_, nullptr)),
+          capacity_(std::exchange(other.capacity_, 0)),
+          head_(std::exchange(other.head_, 0)),
+          tail_(std::exchange(other.tail_, 0))
+    {
+    }
+
+    RingQueue& operator=(RingQueue other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~RingQueue()
+    {
+        clear();
+        if(slots_) std::allocator<T>{}.deallocate(slots_, capacity_);
+    }
+
+    void swap(RingQueue& other) noexcept
+    {
+        std::swap(slots_, other.slots_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(head_, other.head_);
+        std::swap(tail_, other.tail_);
+    }
+
+    bool empty() const noexcept
+    {
+        return head_ == tail_;
+    }
+    std::size_t size() const noexcept
+    {
+        return tail_ - head_;
+    }
+    std::size_t capacity() const noexcept
+    {
+        return growable ? capacity_ : Capacity;
+    }
+
+    T& front() noexcept
+    {
+        return at(0);
+    }
+    const T& front() const noexcept
+    {
+        return at(0);
+    }
+
+    // Counted from the front, as for std::deque.
+    T& operator[](std::size_t i) noexcept
+    {
+        return at(i);
+    }
+    const T& operator[](std::size_t i) const noexcept
+    {
+        return at(i);
+    }
+
+    // Returns false when a fixed, rejecting queue is full.
+    template <class U>
+    bool push_back(U&& value)
+    {
+        if(!slots_) reserve(initial_capacity);
+        if(size() == capacity_)
+        {
+            if constexpr(growable)
+            {
+                reserve(capacity_ * 2);
+            }
+            else if constexpr(std::is_same_v<Overflow, overflow_drop_oldest>)
+            {
+                pop_front();
+            }
+            else
+            {
+                return false;
+            }
+        }
+        ::new(static_cast<void*>(slots_ + (tail_ & (capacity_ - 1)))) T(std::forward<U>(value));
+        ++tail_;
+        return true;
+    }
+
+    void pop_front() noexcept
+    {
+        std::destroy_at(std::addressof(at(0)));
+        ++head_;
+    }
+
+    void clear() noexcept
+    {
+        while(!empty()) pop_front();
+    }
+
+    // Allocates room for at least `n` elements; fixed queues use their capacity.
+    void reserve(std::size_t n)
+    {
+        if constexpr(!growable)
+        {
+            n = Capacity;
+        }
+        if(n <= capacity_) return;
+        std::size_t cap = 1;
+        while(cap < n) cap <<= 1;
+
+        T* next = std::allocator<T>{}.allocate(cap);
+        const auto count = size();
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            ::new(static_cast<void*>(next + i)) T(std::move_if_noexcept(at(i)));
+        }
+        clear();
+        if(slots_) std::allocator<T>{}.deallocate(slots_, capacity_);
+        slots_ = next;
+        capacity_ = cap;
+        head_ = 0;
+        tail_ = count;
+    }
+
+private:
+    T& at(std::size_t i) noexcept
+    {
+        return slots_[(head_ + i) & (capacity_ - 1)];
+    }
+    const T& at(std::size_t i) const noexcept
+    {
+        return slots_[(head_ + i) & (capacity_ - 1)];
+    }
+
+    T* slots_ = nullptr;
+    std::size_t capacity_ = 0;
+    std::size_t head_ = 0;
+    std::size_t tail_ = 0;
+};
+
+// Pushes into any queue type selected by a queue policy; unbounded queues
+// always accept.
+template <class Queue, class U>
+bool queue_push(Queue& queue, U&& value)
+{
+    if constexpr(std::is_void_v<decltype(queue.push_back(std::forward<U>(value)))>)
+    {
+        queue.push_back(std::forward<U>(value));
+        return true;
+    }
+    else
+    {
+        return queue.push_back(std::forward<U>(value));
+    }
+}
+
+} // namespace detail
+} // namespace lsm
+
+#endif
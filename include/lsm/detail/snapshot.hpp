@@ -0,0 +1,125 @@
+#ifndef LSM_DETAIL_SNAPSHOT_HPP
+#define LSM_DETAIL_SNAPSHOT_HPP
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace lsm
+{
+namespace detail
+{
+
+// Appends raw bytes in native byte order. Snapshots are meant for the same
+// build on the same host (checkpoint and restart), not as an exchange format.
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(std::vector<std::byte>& out) noexcept : out_(out) {}
+
+    void bytes(const void* data, std::size_t size)
+    {
+        const auto at = out_.size();
+        out_.resize(at + size);
+        if(size) std::memcpy(out_.data() + at, data, size);
+    }
+
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    void put(const T& value)
+    {
+        bytes(&value, sizeof(T));
+    }
+
+    std::size_t size() const noexcept
+    {
+        return out_.size();
+    }
+
+private:
+    std::vector<std::byte>& out_;
+};
+
+// Reads what SnapshotWriter wrote. Every read is bounds-checked; once one
+// fails the reader stays failed, so callers may check once at the end.
+class SnapshotReader
+{
+public:
+    explicit SnapshotReader(std::span<const std::byte> data) noexcept : data_(data) {}
+
+    bool bytes(void* out, std::size_t size) noexcept
+    {
+        if(!ok_ || data_.size() - pos_ < size)
+        {
+            ok_ = false;
+            return false;
+        }
+        if(size) std::memcpy(out, data_.data() + pos_, size);
+        pos_ += size;
+        return true;
+    }
+
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    bool get(T& value) noexcept
+    {
+        return bytes(&value, sizeof(T));
+    }
+
+    bool ok() const noexcept
+    {
+        return ok_;
+    }
+    // Bytes consumed so far; machines can be packed back to back in one blob.
+    std::size_t position() const noexcept
+    {
+        return pos_;
+    }
+    std::size_t remaining() const noexcept
+    {
+        return data_.size() - pos_;
+    }
+
+private:
+    std::span<const std::byte> data_;
+    std::size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+// Default snapshot codec: copies trivially copyable values byte for byte.
+// That covers enum states, plain-struct contexts and variants of plain
+// inputs. Anything else needs a codec with matching encode/decode overloads;
+// deriving from this one keeps the trivial cases.
+struct TrivialCodec
+{
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    void encode(SnapshotWriter& out, const T& value) const
+    {
+        out.put(value);
+    }
+
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    bool decode(SnapshotReader& in, T& value) const
+    {
+        return in.get(value);
+    }
+};
+
+template <class Codec, class T>
+concept SnapshotCodecFor = requires(const Codec& codec, SnapshotWriter& out, SnapshotReader& in, const T& value, T& target) {
+    codec.encode(out, value);
+    { codec.decode(in, target) } -> std::convertible_to<bool>;
+};
+
+inline constexpr std::uint32_t snapshot_magic = 0x314D534C; // "LSM1"
+
+} // namespace detail
+} // namespace lsm
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef LSM_DETAIL_STATE_INDEX_HPP
+#define LSM_DETAIL_STATE_INDEX_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lsm
+{
+namespace detail
+{
+
+// States whose values map onto an integer range can be addressed by offset.
+template <class State>
+inline constexpr bool is_dense_state_v =
+    std::is_enum_v<State> || (std::is_integral_v<State> && !std::is_same_v<State, bool>);
+
+template <class State>
+constexpr std::uint64_t state_ordinal(const State& s) noexcept
+{
+    if constexpr(std::is_enum_v<State>)
+    {
+        return static_cast<std::uint64_t>(static_cast<std::underlying_type_t<State>>(s));
+    }
+    else
+    {
+        return static_cast<std::uint64_t>(s);
+    }
+}
+
+// Half-open range into one of the flat tables built by MachineImpl::Builder.
+struct Span
+{
+    std::uint32_t begin = 0;
+    std::uint32_t end = 0;
+
+    constexpr bool empty() const noexcept
+    {
+        return begin == end;
+    }
+};
+
+// Maps every state known to a machine onto a compact slot so that per-state
+// tables can live in contiguous arrays. Enum (and integral) states whose values
+// form a reasonably compact range are addressed by offset from the smallest
+// value; everything else falls back to a hash lookup.
+template <class State>
+class StateIndex
+{
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // Ranges up to this size are always dense; larger ones must be at least
+    // one-eighth occupied.
+    static constexpr std::uint64_t dense_floor = 256;
+    static constexpr std::uint64_t dense_ratio = 8;
+
+    StateIndex() = default;
+
+    explicit StateIndex(const std::vector<State>& states)
+    {
+        if constexpr(is_dense_state_v<State>)
+        {
+            if(!states.empty())
+            {
+                // Ordinals are compared in the signed domain so negative
+                // enumerators order correctly.
+                auto lo = static_cast<std::int64_t>(state_ordinal(states.front()));
+                auto hi = lo;
+                for(const auto& s : states)
+                {
+                    const auto v = static_cast<std::int64_t>(state_ordinal(s));
+                    lo = std::min(lo, v);
+                    hi = std::max(hi, v);
+                }
+                const auto span = static_cast<std::uint64_t>(hi) - static_cast<std::uint64_t>(lo) + 1;
+                if(span != 0 && (span <= dense_floor || span <= dense_ratio * states.size()))
+                {
+                    dense_ = true;
+                    base_ = static_cast<std::uint64_t>(lo);
+                    size_ = static_cast<std::size_t>(span);
+                    return;
+                }
+            }
+        }
+        for(const auto& s : states)
+        {
+            hashed_.try_emplace(s, hashed_.size());
+        }
+        size_ = hashed_.size();
+    }
+
+    std::size_t find(const State& s) const noexcept
+    {
+        if constexpr(is_dense_state_v<State>)
+        {
+            if(dense_)
+            {
+                const auto offset = state_ordinal(s) - base_;
+                return offset < size_ ? static_cast<std::size_t>(offset) : npos;
+            }
+        }
+        if(auto it = hashed_.find(s); it != hashed_.end())
+        {
+            return it->second;
+        }
+        return npos;
+    }
+
+    std::size_t size() const noexcept
+    {
+        return size_;
+    }
+
+    bool dense() const noexcept
+    {
+        return dense_;
+    }
+
+private:
+    bool dense_ = false;
+    std::uint64_t base_ = 0;
+    std::size_t size_ = 0;
+    std::unordered_map<State, std::size_t> hashed_;
+};
+
+} // namespace detail
+} // namespace lsm
+
+#endif
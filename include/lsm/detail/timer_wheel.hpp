@@ -0,0 +1,217 @@
+#ifndef LSM_DETAIL_TIMER_WHEEL_HPP
+#define LSM_DETAIL_TIMER_WHEEL_HPP
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+
+namespace lsm
+{
+namespace detail
+{
+
+// Intrusive link for a suspended coroutine. Nodes live inside the awaiters
+// that suspend on them, so queueing and arming timers never allocates. Lists
+// are circular around a sentinel node, which makes unlinking O(1) without
+// knowing which list a node is on; a node destroyed while queued or armed
+// simply drops out.
+struct TimerNode
+{
+    TimerNode* prev = this;
+    TimerNode* next = this;
+    std::coroutine_handle<> handle{};
+    std::uint64_t deadline = 0;
+    std::size_t* armed = nullptr; // wheel counter while the node sits on a wheel
+
+    TimerNode() noexcept = default;
+    // Copies start out unlinked.
+    TimerNode(const TimerNode&) noexcept {}
+    TimerNode& operator=(const TimerNode&) = delete;
+    ~TimerNode()
+    {
+        unlink();
+    }
+
+    bool linked() const noexcept
+    {
+        return next != this;
+    }
+
+    void unlink() noexcept
+    {
+        prev->next = next;
+        next->prev = prev;
+        prev = next = this;
+        if(armed)
+        {
+            --*armed;
+            armed = nullptr;
+        }
+    }
+
+    // Appends `node` to the list headed by this sentinel.
+    void push_back(TimerNode& node) noexcept
+    {
+        node.prev = prev;
+        node.next = this;
+        prev->next = &node;
+        prev = &node;
+    }
+
+    TimerNode* front() const noexcept
+    {
+        return linked() ? next : nullptr;
+    }
+
+    // Moves every node of this list to the back of `to`, preserving order.
+    void splice_to(TimerNode& to) noexcept
+    {
+        if(!linked()) return;
+        next->prev = to.prev;
+        prev->next = &to;
+        to.prev->next = next;
+        to.prev = prev;
+        next = prev = this;
+    }
+};
+
+// Hierarchical timing wheel over integer ticks. Level `l` has 64 slots of
+// 64^l ticks each; a timer sits on the lowest level whose span covers its
+// delay and cascades down as the wheel turns. Arming and cancelling are O(1);
+// advancing costs one slot visit per tick plus the cascades it crosses, and
+// jumps straight to the target while nothing is armed.
+class TimerWheel
+{
+public:
+    static constexpr std::size_t bits = 6;
+    static constexpr std::size_t slots = std::size_t{1} << bits;
+    static constexpr std::size_t levels = 4;
+    static constexpr std::uint64_t mask = slots - 1;
+
+    TimerWheel() = default;
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    ~TimerWheel()
+    {
+        for(auto& level : wheel_)
+        {
+            for(auto& slot : level)
+            {
+                while(auto* node = slot.front()) node->unlink();
+            }
+        }
+    }
+
+    std::uint64_t now() const noexcept
+    {
+        return now_;
+    }
+
+    std::size_t size() const noexcept
+    {
+        return armed_;
+    }
+
+    bool empty() const noexcept
+    {
+        return armed_ == 0;
+    }
+
+    // Arms `node` for `node.deadline`. Deadlines that are already due go
+    // straight to the back of `expired`. Unlinking the node disarms it.
+    void arm(TimerNode& node, TimerNode& expired) noexcept
+    {
+        node.unlink();
+        if(node.deadline <= now_)
+        {
+            expired.push_back(node);
+            return;
+        }
+        slot_for(node.deadline).push_back(node);
+        node.armed = &armed_;
+        ++armed_;
+    }
+
+    // Turns the wheel to tick `target`, moving every timer that falls due on
+    // the way to the back of `expired` in deadline order.
+    void advance(std::uint64_t target, TimerNode& expired) noexcept
+    {
+        while(now_ < target)
+        {
+            if(armed_ == 0)
+            {
+                now_ = target;
+                return;
+            }
+            ++now_;
+            cascade();
+            auto& due = wheel_[0][now_ & mask];
+            for(auto* node = due.next; node != &due; node = node->next)
+            {
+                if(node->armed)
+                {
+                    node->armed = nullptr;
+                    --armed_;
+                }
+            }
+            due.splice_to(expired);
+        }
+    }
+
+    // Earliest tick at which advance() may have work to do: the next occupied
+    // level-0 slot, or the next level-0 wrap if a cascade comes first.
+    std::uint64_t next_event() const noexcept
+    {
+        if(armed_ == 0) return now_;
+        for(std::uint64_t tick = now_ + 1;; ++tick)
+        {
+            if(wheel_[0][tick & mask].linked() || (tick & mask) == 0) return tick;
+        }
+    }
+
+private:
+    TimerNode& slot_for(std::uint64_t deadline) noexcept
+    {
+        const auto delta = deadline - now_;
+        for(std::size_t level = 0; level < levels; ++level)
+        {
+            if(delta < (std::uint64_t{1} << (bits * (level + 1))))
+            {
+                return wheel_[level][(deadline >> (bits * level)) & mask];
+            }
+        }
+        // Beyond the horizon: park in the top-level slot visited last and re-file
+        // on cascade, once the remaining delay fits.
+        return wheel_[levels - 1][((now_ >> (bits * (levels - 1))) - 1) & mask];
+    }
+
+    // When the lower levels wrap, the timers of the next higher slot move down.
+    // Higher levels go first so nothing is re-filed into a slot already emptied
+    // on this tick.
+    void cascade() noexcept
+    {
+        std::size_t top = 0;
+        while(top + 1 < levels && (now_ & ((std::uint64_t{1} << (bits * (top + 1))) - 1)) == 0) ++top;
+        for(std::size_t level = top; level > 0; --level)
+        {
+            TimerNode pending;
+            wheel_[level][(now_ >> (bits * level)) & mask].splice_to(pending);
+            while(auto* node = pending.front())
+            {
+                // Due exactly now: file it on the level-0 slot about to expire.
+                arm(*node, wheel_[0][now_ & mask]);
+            }
+        }
+    }
+
+    std::array<std::array<TimerNode, slots>, levels> wheel_{};
+    std::uint64_t now_ = 0;
+    std::size_t armed_ = 0;
+};
+
+} // namespace detail
+} // namespace lsm
+
+#endif
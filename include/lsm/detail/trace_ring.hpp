@@ -0,0 +1,103 @@
+#ifndef LSM_DETAIL_TRACE_RING_HPP
+#define LSM_DETAIL_TRACE_RING_HPP
+
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace lsm
+{
+namespace detail
+{
+
+// One transition, as stored in a TraceRing. States are recorded by their
+// state_index() slot and transitions by their position in transitions_table()
+// (or completions_table() when `completion` is set), so a record is a fixed
+// 32 bytes whatever the machine's types are.
+struct TraceRecord
+{
+    static constexpr std::uint16_t no_input = 0xFFFF;
+    static constexpr std::uint8_t output = 1;     // the action produced an output
+    static constexpr std::uint8_t completion = 2; // `id` indexes completions_table()
+    static constexpr std::uint8_t deferred = 4;   // the input was deferred to `to`
+
+    std::uint64_t timestamp; // steady_clock nanoseconds
+    std::uint32_t source;    // tag given to set_trace(), tells machines apart
+    std::uint32_t from;
+    std::uint32_t to;
+    std::uint32_t id;
+    std::uint16_t input; // variant index of the input, or no_input
+    std::uint8_t flags;
+    std::uint8_t reserved;
+    std::uint32_t padding;
+};
+
+static_assert(sizeof(TraceRecord) == 32 && std::is_trivially_copyable_v<TraceRecord>);
+
+// Fixed-size ring of TraceRecords that overwrites its oldest entries. Writing
+// is one timestamp read plus one 32-byte store, with no locking: a ring has a
+// single writer (one machine, or every machine on one thread), and records()
+// must be read from that thread or once it has stopped.
+class TraceRing
+{
+public:
+    // Capacity is rounded up to a power of two.
+    explicit TraceRing(std::size_t capacity = 4096)
+        : mask_(std::bit_ceil(capacity ? capacity : 1) - 1), slots_(std::make_unique<TraceRecord[]>(mask_ + 1))
+    {
+    }
+
+    static std::uint64_t now() noexcept
+    {
+        const auto since = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(since).count());
+    }
+
+    void write(const TraceRecord& record) noexcept
+    {
+        slots_[written_ & mask_] = record;
+        ++written_;
+    }
+
+    std::size_t capacity() const noexcept
+    {
+        return mask_ + 1;
+    }
+    std::size_t size() const noexcept
+    {
+        return written_ < capacity() ? static_cast<std::size_t>(written_) : capacity();
+    }
+    // Records ever written, including overwritten ones.
+    std::uint64_t written() const noexcept
+    {
+        return written_;
+    }
+
+    // Retained records, oldest first.
+    std::vector<TraceRecord> records() const
+    {
+        std::vector<TraceRecord> out;
+        out.reserve(size());
+        for(auto i = written_ - size(); i != written_; ++i) out.push_back(slots_[i & mask_]);
+        return out;
+    }
+
+    void clear() noexcept
+    {
+        written_ = 0;
+    }
+
+private:
+    std::size_t mask_;
+    std::unique_ptr<TraceRecord[]> slots_;
+    std::uint64_t written_ = 0;
+};
+
+} // namespace detail
+} // namespace lsm
+
+#endif
@@ -1,7 +1,12 @@
 #ifndef LSM_DETAIL_TYPES_HPP
 #define LSM_DETAIL_TYPES_HPP
 
+#include <chrono>
+#include <cstddef>
+#include <limits>
 #include <optional>
+#include <type_traits>
+#include <variant>
 
 #include <lsm/detail/concepts.hpp>
 
@@ -10,6 +15,55 @@ namespace lsm
 namespace detail
 {
 
+inline constexpr std::size_t unrouted = static_cast<std::size_t>(-1);
+
+template <class T, class Variant>
+struct variant_index;
+template <class T, class... Ts>
+struct variant_index<T, std::variant<Ts...>>
+{
+    static constexpr std::size_t value = [] {
+        constexpr bool matches[] = {std::is_same_v<T, Ts>...};
+        for(std::size_t i = 0; i < sizeof...(Ts); ++i)
+        {
+            if(matches[i]) return i;
+        }
+        return unrouted;
+    }();
+};
+template <class T, class Variant>
+inline constexpr std::size_t variant_index_v = variant_index<T, Variant>::value;
+
+// Number of dispatch buckets for an input type: one per variant alternative
+// plus one for valueless variants, or a single bucket for non-variant inputs.
+template <class Input>
+constexpr std::size_t route_count() noexcept
+{
+    if constexpr(IsVariant<Input>)
+    {
+        return std::variant_size_v<Input> + 1;
+    }
+    else
+    {
+        return 1;
+    }
+}
+
+template <class Input>
+constexpr std::size_t input_route(const Input& in) noexcept
+{
+    if constexpr(IsVariant<Input>)
+    {
+        const auto index = in.index();
+        return index == std::variant_npos ? std::variant_size_v<Input> : index;
+    }
+    else
+    {
+        (void)in;
+        return 0;
+    }
+}
+
 template <typename State, typename Input, typename Output, typename Context, typename CallablePolicy, typename Effect>
 struct Transition
 {
@@ -29,6 +83,15 @@ struct Transition
     bool suppress_enter_exit = true;
     int priority = 0;
     bool defer = false;
+    // Set when `guard` is only the equality test of an on_value() transition,
+    // so its result depends on the input alone.
+    bool value_guard = false;
+    // Variant alternative the transition is routed on. The type check is done by
+    // the dispatch tables, so `guard` only holds user predicates; `unrouted`
+    // transitions are candidates for every input.
+    std::size_t input_index = unrouted;
+    // Slot of `to` in the definition's state index, resolved when it is built.
+    std::size_t to_slot = 0;
     mutable Guard guard{};
     mutable Action action{};
 };
@@ -51,6 +114,8 @@ struct CompletionTransition
     State_t to{};
     bool suppress_enter_exit = true;
     int priority = 0;
+    // Slot of `to` in the definition's state index, resolved when it is built.
+    std::size_t to_slot = 0;
     mutable Guard guard{};
     mutable Action action{};
 };
@@ -59,7 +124,26 @@ struct AnyState_t
 {
 };
 
+// Selects the MachineImpl constructor that takes a state as-is, without
+// running enter hooks or completions.
+struct adopt_t
+{
+    explicit adopt_t() = default;
+};
+inline constexpr adopt_t adopt{};
+
+// Bounds a single queue drain. At least one input is processed per call, so
+// a `max_inputs` of 0 acts as 1; the time budget is checked after each input.
+struct DrainLimit
+{
+    std::size_t max_inputs = std::numeric_limits<std::size_t>::max();
+    std::chrono::nanoseconds budget = std::chrono::nanoseconds::max();
+};
+
 } // namespace detail
+
+using DrainLimit = detail::DrainLimit;
+
 } // namespace lsm
 
 #endif
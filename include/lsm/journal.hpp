@@ -0,0 +1,421 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <lsm/detail/effect.hpp>
+#include <lsm/detail/snapshot.hpp>
+
+#if __has_include(<sys/mman.h>) && __has_include(<unistd.h>)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LSM_JOURNAL_FILE_LOG 1
+#endif
+
+namespace lsm
+{
+namespace detail
+{
+
+// FNV-1a; cheap and good enough to tell a torn write from a whole one.
+inline std::uint32_t journal_checksum(std::span<const std::byte> bytes) noexcept
+{
+    std::uint32_t hash = 2166136261u;
+    for(auto b : bytes)
+    {
+        hash ^= std::to_integer<std::uint32_t>(b);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+inline constexpr std::uint32_t journal_magic = 0x4A4D534C; // "LSMJ"
+inline constexpr std::uint32_t journal_version = 1;
+inline constexpr std::size_t journal_header_size = 8;
+// Frame: payload size (u32), sequence (u64), payload, checksum (u32) over
+// sequence and payload.
+inline constexpr std::size_t journal_frame_head = 12;
+inline constexpr std::size_t journal_frame_overhead = journal_frame_head + 4;
+
+inline void journal_header(std::byte* out) noexcept
+{
+    std::memcpy(out, &journal_magic, 4);
+    std::memcpy(out + 4, &journal_version, 4);
+}
+
+} // namespace detail
+
+namespace journal
+{
+
+// One logged input. `payload` points into the log image.
+struct Entry
+{
+    std::uint64_t sequence = 0;
+    std::span<const std::byte> payload;
+};
+
+// Walks the entries of a log image in order. Iteration stops at the first
+// record that is torn, fails its checksum or breaks the sequence, so a log
+// cut short by a crash yields exactly its durable prefix.
+class Reader
+{
+public:
+    explicit Reader(std::span<const std::byte> log) noexcept : log_(log)
+    {
+        std::uint32_t magic = 0;
+        std::uint32_t version = 0;
+        if(log.size() >= detail::journal_header_size)
+        {
+            std::memcpy(&magic, log.data(), 4);
+            std::memcpy(&version, log.data() + 4, 4);
+        }
+        header_ok_ = magic == detail::journal_magic && version == detail::journal_version;
+        pos_ = header_ok_ ? detail::journal_header_size : 0;
+    }
+
+    bool header_ok() const noexcept
+    {
+        return header_ok_;
+    }
+
+    std::optional<Entry> next() noexcept
+    {
+        if(!header_ok_ || log_.size() - pos_ < detail::journal_frame_overhead) return std::nullopt;
+        std::uint32_t size = 0;
+        Entry entry;
+        std::memcpy(&size, log_.data() + pos_, 4);
+        std::memcpy(&entry.sequence, log_.data() + pos_ + 4, 8);
+        if(size > log_.size() - pos_ - detail::journal_frame_overhead) return std::nullopt;
+        if(last_ && entry.sequence != *last_ + 1) return std::nullopt;
+
+        const auto checked = log_.subspan(pos_ + 4, 8 + size);
+        std::uint32_t checksum = 0;
+        std::memcpy(&checksum, checked.data() + checked.size(), 4);
+        if(checksum != detail::journal_checksum(checked)) return std::nullopt;
+
+        entry.payload = checked.subspan(8);
+        pos_ += detail::journal_frame_overhead + size;
+        last_ = entry.sequence;
+        return entry;
+    }
+
+    // End of the last whole entry read so far.
+    std::size_t position() const noexcept
+    {
+        return pos_;
+    }
+    std::optional<std::uint64_t> last_sequence() const noexcept
+    {
+        return last_;
+    }
+
+private:
+    std::span<const std::byte> log_;
+    std::size_t pos_ = 0;
+    std::optional<std::uint64_t> last_;
+    bool header_ok_ = false;
+};
+
+// Log kept in memory; for tests, and for shipping frames elsewhere.
+class MemoryLog
+{
+public:
+    MemoryLog() : bytes_(detail::journal_header_size)
+    {
+        detail::journal_header(bytes_.data());
+    }
+
+    void append(std::span<const std::byte> frame)
+    {
+        bytes_.insert(bytes_.end(), frame.begin(), frame.end());
+    }
+    void sync() noexcept {}
+
+    std::span<const std::byte> contents() const noexcept
+    {
+        return bytes_;
+    }
+
+private:
+    std::vector<std::byte> bytes_;
+};
+
+#ifdef LSM_JOURNAL_FILE_LOG
+
+// Append-only log in a memory-mapped file. Appends are a memcpy into the
+// mapping; every `sync_every` appends, or on sync(), the dirty range is
+// flushed with msync(MS_SYNC). Entries appended since the last flush may be
+// lost in a crash, never reordered or half-applied. The file is grown in
+// doubling steps and trimmed back to its contents on close.
+//
+// Opening an existing log keeps its valid prefix and appends after it.
+class FileLog
+{
+public:
+    struct Options
+    {
+        std::size_t sync_every = 256;
+        std::size_t initial_size = std::size_t{1} << 20;
+    };
+
+    explicit FileLog(const std::string& path) : FileLog(path, Options{}) {}
+
+    FileLog(const std::string& path, Options options) : options_(options)
+    {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if(fd_ < 0) fail("open");
+        try
+        {
+            struct stat st{};
+            if(::fstat(fd_, &st) != 0) fail("fstat");
+            const auto existing = static_cast<std::size_t>(st.st_size);
+            if(existing < detail::journal_header_size)
+            {
+                resize(std::max(options_.initial_size, detail::journal_header_size));
+                detail::journal_header(base_);
+                used_ = detail::journal_header_size;
+            }
+            else
+            {
+                map(existing);
+                Reader reader({base_, existing});
+                if(!reader.header_ok()) throw std::runtime_error("lsm::journal::FileLog: " + path + " is not a journal");
+                std::uint64_t next = 0;
+                while(auto entry = reader.next()) next = entry->sequence + 1;
+                used_ = reader.position();
+                next_sequence_ = next;
+                // Clear a torn tail so stale bytes can never be read as entries.
+                std::memset(base_ + used_, 0, mapped_ - used_);
+            }
+        } catch(...)
+        {
+            release();
+            throw;
+        }
+        synced_ = used_;
+    }
+
+    ~FileLog()
+    {
+        if(fd_ < 0) return;
+        if(base_) ::msync(base_, used_, MS_SYNC);
+        release();
+    }
+
+    FileLog(const FileLog&) = delete;
+    FileLog& operator=(const FileLog&) = delete;
+
+    void append(std::span<const std::byte> frame)
+    {
+        if(frame.size() > mapped_ - used_) resize(std::max(mapped_ * 2, used_ + frame.size()));
+        std::memcpy(base_ + used_, frame.data(), frame.size());
+        used_ += frame.size();
+        if(++unsynced_ >= options_.sync_every) sync();
+    }
+
+    void sync()
+    {
+        if(used_ == synced_) return;
+        const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        const auto from = synced_ / page * page;
+        if(::msync(base_ + from, used_ - from, MS_SYNC) != 0) fail("msync");
+        synced_ = used_;
+        unsynced_ = 0;
+    }
+
+    std::span<const std::byte> contents() const noexcept
+    {
+        return {base_, used_};
+    }
+    // Sequence following the last entry found when the log was opened.
+    std::uint64_t next_sequence() const noexcept
+    {
+        return next_sequence_;
+    }
+
+private:
+    [[noreturn]] static void fail(const char* what)
+    {
+        throw std::system_error(errno, std::generic_category(), std::string("lsm::journal::FileLog: ") + what);
+    }
+
+    void map(std::size_t size)
+    {
+        void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if(p == MAP_FAILED) fail("mmap");
+        base_ = static_cast<std::byte*>(p);
+        mapped_ = size;
+    }
+
+    void resize(std::size_t size)
+    {
+        if(base_) ::munmap(base_, mapped_);
+        base_ = nullptr;
+        if(::ftruncate(fd_, static_cast<off_t>(size)) != 0) fail("ftruncate");
+        map(size);
+    }
+
+    void release() noexcept
+    {
+        if(base_) ::munmap(base_, mapped_);
+        base_ = nullptr;
+        if(used_ && ::ftruncate(fd_, static_cast<off_t>(used_)) != 0)
+        {
+            // The preallocated tail stays; readers stop at it.
+        }
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    Options options_;
+    int fd_ = -1;
+    std::byte* base_ = nullptr;
+    std::size_t mapped_ = 0;
+    std::size_t used_ = 0;
+    std::size_t synced_ = 0;
+    std::size_t unsynced_ = 0;
+    std::uint64_t next_sequence_ = 0;
+};
+
+#endif
+
+// Write-ahead journaling decorator. Every input is appended to `log` before
+// it is applied, unhandled ones included, since unhandled hooks may change
+// the context too. Dispatch is deterministic in state, context and input, so
+// a snapshot plus the entries logged after it rebuild the machine. Inputs go
+// through `codec`, as for snapshots.
+//
+// Only inputs passed to dispatch() and dispatch_batch() are logged. Inputs
+// queued on the machine with enqueue() and drained by dispatch_all() bypass
+// the journal and are lost on replay.
+template <class Machine, class Log, class Codec = detail::TrivialCodec>
+class Journal
+{
+public:
+    using Input = typename Machine::Input_t;
+    using Output = typename Machine::Output_t;
+
+    // Replay re-runs actions, which would publish historical outputs again.
+    static_assert(std::is_same_v<typename Machine::Publisher_t, detail::NullPublisher>,
+                  "Journal requires the ReturnOutput effect policy");
+
+    Journal(Machine& machine, Log& log, std::uint64_t next_sequence = 0, Codec codec = {})
+        : machine_(machine), log_(log), codec_(std::move(codec)), next_(next_sequence)
+    {
+    }
+
+    std::optional<Output> dispatch(const Input& in)
+    {
+        append(in);
+        return machine_.dispatch(in);
+    }
+
+    // Logs the whole batch, then dispatches it.
+    template <class Sink>
+    std::size_t dispatch_batch(std::span<const Input> inputs, Sink&& sink)
+    {
+        for(const auto& in : inputs) append(in);
+        return machine_.dispatch_batch(inputs, std::forward<Sink>(sink));
+    }
+
+    // Sequence the next logged input will get. Store it next to a snapshot
+    // and pass it to replay() to skip what the snapshot already covers.
+    std::uint64_t sequence() const noexcept
+    {
+        return next_;
+    }
+
+    void sync()
+    {
+        log_.sync();
+    }
+
+    Machine& machine() noexcept
+    {
+        return machine_;
+    }
+
+private:
+    void append(const Input& in)
+    {
+        frame_.resize(detail::journal_frame_head);
+        detail::SnapshotWriter out(frame_);
+        codec_.encode(out, in);
+        const auto size = static_cast<std::uint32_t>(frame_.size() - detail::journal_frame_head);
+        std::memcpy(frame_.data(), &size, 4);
+        std::memcpy(frame_.data() + 4, &next_, 8);
+        out.put(detail::journal_checksum(std::span<const std::byte>(frame_).subspan(4)));
+        log_.append(frame_);
+        ++next_;
+    }
+
+    Machine& machine_;
+    Log& log_;
+    [[no_unique_address]] Codec codec_;
+    std::uint64_t next_;
+    std::vector<std::byte> frame_;
+};
+
+struct ReplayResult
+{
+    std::uint64_t applied = 0;
+    // Sequence to continue the journal with.
+    std::uint64_t next_sequence = 0;
+    // False if an entry failed to decode; replay stops there.
+    bool complete = true;
+};
+
+// Re-applies the entries of `log` with a sequence of at least `from` to
+// `machine`, normally one just restored from the snapshot taken at `from`.
+// Runs at dispatch speed with returned outputs dropped and tracing detached;
+// guards, actions, enter/exit and unhandled hooks run as they did originally,
+// since they are what rebuilds the context, so any side effect they have
+// outside the context happens again.
+template <class Machine, class Codec = detail::TrivialCodec>
+ReplayResult replay(Machine& machine, std::span<const std::byte> log, std::uint64_t from = 0, const Codec& codec = {})
+{
+    static_assert(std::is_same_v<typename Machine::Publisher_t, detail::NullPublisher>,
+                  "replay requires the ReturnOutput effect policy");
+    auto* ring = machine.trace_ring();
+    const auto source = machine.trace_source();
+    machine.set_trace(nullptr);
+
+    ReplayResult result;
+    result.next_sequence = from;
+    Reader reader(log);
+    typename Machine::Input_t in{};
+    while(auto entry = reader.next())
+    {
+        result.next_sequence = std::max(result.next_sequence, entry->sequence + 1);
+        if(entry->sequence < from) continue;
+        detail::SnapshotReader payload(entry->payload);
+        if(!codec.decode(payload, in) || payload.remaining() != 0)
+        {
+            result.next_sequence = entry->sequence;
+            result.complete = false;
+            break;
+        }
+        machine.dispatch(in);
+        ++result.applied;
+    }
+
+    machine.set_trace(ring, source);
+    return result;
+}
+
+} // namespace journal
+} // namespace lsm
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <lsm/detail/effect.hpp>
+#include <lsm/detail/machine_impl.hpp>
+#include <lsm/detail/types.hpp>
+
+namespace lsm
+{
+
+// Many instances of one machine definition stored structure-of-arrays: one
+// contiguous array of state slots and one of contexts, with no per-instance
+// MachineImpl. Meant for fleets of identical machines that mostly receive the
+// same input at once.
+//
+// broadcast() resolves, per input alternative, a slot -> slot table for every
+// state whose transition is trivial: unguarded, no action, no enter/exit hook
+// to run anywhere on its hierarchy path, no completion at the target, or no
+// transition and no unhandled hook. The plain equality guards of on_value()
+// transitions read only the input, so alternatives that have them get their
+// table rebuilt on each broadcast with those guards evaluated once, instead of
+// sending every instance down the scalar path.
+// Instances in such states advance with one table gather each. The rest are
+// loaded into a single worker machine and dispatched normally, so behaviour
+// matches calling dispatch() on each instance.
+//
+// Instances have no input queue, so definitions with deferral are rejected
+// with std::invalid_argument, and outputs are returned, not published.
+template <class Machine>
+class MachinePool
+{
+public:
+    using State = typename Machine::State_t;
+    using Input = typename Machine::Input_t;
+    using Output = typename Machine::Output_t;
+    using Context = typename Machine::Ctx_t;
+    using Definition = typename Machine::Definition;
+
+    static_assert(std::is_same_v<typename Machine::Publisher_t, detail::NullPublisher>,
+                  "MachinePool requires the ReturnOutput effect policy");
+    static_assert(std::default_initializable<Context>, "MachinePool requires a default-constructible context");
+
+    explicit MachinePool(std::shared_ptr<const Definition> definition)
+        : def_(std::move(definition)), worker_(detail::adopt, def_, def_->initial), plans_(Machine::route_count)
+    {
+        // Deferred inputs would queue in the shared worker and leak between instances.
+        if(def_->deferral_enabled) throw std::invalid_argument("lsm::MachinePool: definitions with deferral are not supported");
+        states_.resize(def_->index.size());
+        auto learn = [this](const State& s) {
+            if(const auto slot = def_->index.find(s); slot != Machine::StateIndex::npos) states_[slot] = s;
+        };
+        learn(def_->initial);
+        for(const auto& t : def_->transitions)
+        {
+            learn(t.from);
+            learn(t.to);
+        }
+        for(const auto& c : def_->completions)
+        {
+            learn(c.from);
+            learn(c.to);
+        }
+        initial_slot_ = static_cast<std::uint32_t>(def_->index.find(def_->initial));
+        initial_trivial_ = !enters_hooks(Definition::root, initial_slot_) && !has_completions(initial_slot_);
+    }
+
+    // Adds an instance in the initial state, running its enter hook and
+    // completions as constructing a machine would. Returns its index.
+    std::size_t add(Context ctx = {})
+    {
+        if(initial_trivial_)
+        {
+            slots_.push_back(initial_slot_);
+            contexts_.push_back(std::move(ctx));
+        }
+        else
+        {
+            Machine fresh(def_, std::move(ctx));
+            slots_.push_back(slot_of(fresh.state()));
+            contexts_.push_back(std::move(fresh.context()));
+        }
+        return slots_.size() - 1;
+    }
+
+    void reserve(std::size_t count)
+    {
+        slots_.reserve(count);
+        contexts_.reserve(count);
+    }
+
+    std::size_t size() const noexcept
+    {
+        return slots_.size();
+    }
+
+    const State& state(std::size_t i) const noexcept
+    {
+        return states_[slots_[i]];
+    }
+    Context& context(std::size_t i) noexcept
+    {
+        return contexts_[i];
+    }
+    const Context& context(std::size_t i) const noexcept
+    {
+        return contexts_[i];
+    }
+
+    // Raw columns, indexed by instance. Slots are positions in the
+    // definition's state index.
+    std::span<const std::uint32_t> slots() const noexcept
+    {
+        return slots_;
+    }
+    std::span<Context> contexts() noexcept
+    {
+        return contexts_;
+    }
+
+    // Delivers `in` to every instance. `sink(index, output)` receives the
+    // outputs; trivial transitions never produce one.
+    template <class Sink>
+        requires std::invocable<Sink&, std::size_t, Output&&>
+    void broadcast(const Input& in, Sink&& sink)
+    {
+        const auto count = slots_.size();
+        if(count == 0) return;
+        const auto& cached = plan_for(detail::input_route(in));
+        const auto& plan = cached.by_value ? value_plan(in) : cached;
+        const auto* next = plan.next.data();
+        auto* slots = slots_.data();
+        if(!plan.scalar)
+        {
+            for(std::size_t i = 0; i < count; ++i) slots[i] = next[slots[i]];
+            return;
+        }
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            const auto to = next[slots[i]];
+            if(to != scalar)
+            {
+                slots[i] = to;
+            }
+            else if(auto out = run(i, in))
+            {
+                sink(i, std::move(*out));
+            }
+        }
+    }
+
+    void broadcast(const Input& in)
+    {
+        broadcast(in, [](std::size_t, Output&&) {});
+    }
+
+    // Delivers `in` to one instance.
+    std::optional<Output> dispatch(std::size_t i, const Input& in)
+    {
+        return run(i, in);
+    }
+
+private:
+    static constexpr std::uint32_t scalar = static_cast<std::uint32_t>(-1);
+    static constexpr std::uint32_t no_match = static_cast<std::uint32_t>(-2);
+
+    struct Plan
+    {
+        std::vector<std::uint32_t> next;
+        bool scalar = false;
+        // Some slot's target depends on the value of the input.
+        bool by_value = false;
+    };
+
+    bool has_enter(std::size_t slot) const noexcept
+    {
+        return slot < def_->handlers.size() && static_cast<bool>(def_->handlers[slot].on_enter);
+    }
+    bool has_exit(std::size_t slot) const noexcept
+    {
+        return slot < def_->handlers.size() && static_cast<bool>(def_->handlers[slot].on_exit);
+    }
+    bool has_completions(std::size_t slot) const noexcept
+    {
+        return slot < def_->completion_rows.size() && !def_->completion_rows[slot].empty();
+    }
+    bool has_unhandled(std::size_t slot) const noexcept
+    {
+        return static_cast<bool>(def_->unhandled) ||
+               (slot < def_->handlers.size() && static_cast<bool>(def_->handlers[slot].on_unhandled));
+    }
+
+    std::uint32_t slot_of(const State& s) const noexcept
+    {
+        return static_cast<std::uint32_t>(def_->index.find(s));
+    }
+
+    // Whether entering `to` from below `domain` runs an enter hook.
+    bool enters_hooks(std::uint32_t domain, std::size_t to) const noexcept
+    {
+        if(!def_->hierarchical()) return has_enter(to);
+        const auto line = def_->lineage[to];
+        for(auto i = line.begin + def_->depth(domain); i != line.end; ++i)
+        {
+            if(has_enter(def_->lineage_slots[i])) return true;
+        }
+        return false;
+    }
+
+    // Whether leaving `from` up to `domain` runs an exit hook.
+    bool exits_hooks(std::size_t from, std::uint32_t domain) const noexcept
+    {
+        for(std::size_t s = from; s != domain; s = def_->parent(s))
+        {
+            if(has_exit(s)) return true;
+        }
+        return false;
+    }
+
+    // Target slot if the candidate on `route` that fires has nothing to run,
+    // `scalar` if that cannot be known without an instance, or `no_match`.
+    // Value guards are evaluated against `in`, or mark the plan `by_value`
+    // when it is being built for every value of the alternative.
+    std::uint32_t route_target(std::size_t from, detail::Span route, const Input* in, Plan& plan)
+    {
+        for(auto i = route.begin; i != route.end; ++i)
+        {
+            const auto id = def_->routes[i];
+            const auto& t = def_->transitions[id];
+            if(t.guard && t.value_guard)
+            {
+                if(!in)
+                {
+                    plan.by_value = true;
+                    return scalar;
+                }
+                if(!value_matches(id, *in)) continue;
+            }
+            else if(t.guard)
+            {
+                return scalar;
+            }
+            return t.action ? scalar : trivial_target(from, id);
+        }
+        return no_match;
+    }
+
+    // Value guards ignore the context, so any instance's can be passed.
+    bool value_matches(std::uint32_t id, const Input& in)
+    {
+        auto& verdict = verdicts_[id];
+        if(verdict < 0) verdict = def_->transitions[id].guard(in, contexts_.front()) ? 1 : 0;
+        return verdict != 0;
+    }
+
+    // Target slot of transition `id` taken from `from` if it runs no hook and
+    // no completion; `scalar` otherwise.
+    std::uint32_t trivial_target(std::size_t from, std::uint32_t id) const
+    {
+        const auto& t = def_->transitions[id];
+        if(def_->hierarchical())
+        {
+            const auto domain = def_->domain(from, id);
+            if(domain == Definition::internal) return static_cast<std::uint32_t>(from);
+            const auto to = t.to_slot;
+            if(exits_hooks(from, domain) || enters_hooks(domain, to) || has_completions(to)) return scalar;
+            return static_cast<std::uint32_t>(to);
+        }
+        const auto to = t.to_slot;
+        const bool skip_hooks = t.suppress_enter_exit && to == from;
+        if(!skip_hooks && (has_exit(from) || has_enter(to))) return scalar;
+        if(has_completions(to)) return scalar;
+        return static_cast<std::uint32_t>(to);
+    }
+
+    const Plan& plan_for(std::size_t alternative)
+    {
+        auto& plan = plans_[alternative];
+        if(plan.next.empty()) fill(plan, alternative, nullptr);
+        return plan;
+    }
+
+    // Table for this very input, each value guard evaluated at most once.
+    const Plan& value_plan(const Input& in)
+    {
+        verdicts_.assign(def_->transitions.size(), -1);
+        value_plan_.scalar = false;
+        fill(value_plan_, detail::input_route(in), &in);
+        return value_plan_;
+    }
+
+    void fill(Plan& plan, std::size_t alternative, const Input* in)
+    {
+        const auto slots = def_->index.size();
+        const auto any = def_->route(slots, alternative);
+        plan.next.resize(slots);
+        for(std::size_t s = 0; s < slots; ++s)
+        {
+            auto to = route_target(s, def_->route(s, alternative), in, plan);
+            if(to == no_match) to = route_target(s, any, in, plan);
+            if(to == no_match) to = has_unhandled(s) ? scalar : static_cast<std::uint32_t>(s);
+            plan.next[s] = to;
+            plan.scalar = plan.scalar || to == scalar;
+        }
+    }
+
+    // Loads instance `i` into the worker, dispatches and stores it back.
+    std::optional<Output> run(std::size_t i, const Input& in)
+    {
+        struct Loaded
+        {
+            MachinePool& pool;
+            std::size_t i;
+            ~Loaded()
+            {
+                using std::swap;
+                swap(pool.worker_.context(), pool.contexts_[i]);
+                pool.slots_[i] = pool.slot_of(pool.worker_.state());
+            }
+        };
+        worker_.set_state_direct(detail::adopt, states_[slots_[i]]);
+        using std::swap;
+        swap(worker_.context(), contexts_[i]);
+        Loaded loaded{*this, i};
+        return worker_.dispatch(in);
+    }
+
+    std::shared_ptr<const Definition> def_;
+    Machine worker_;
+    std::vector<Plan> plans_;
+    Plan value_plan_;
+    std::vector<std::int8_t> verdicts_;
+    std::vector<State> states_;
+    std::vector<std::uint32_t> slots_;
+    std::vector<Context> contexts_;
+    std::uint32_t initial_slot_ = 0;
+    bool initial_trivial_ = true;
+};
+
+} // namespace lsm
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <lsm/detail/inbox.hpp>
+#include <lsm/detail/machine_impl.hpp>
+#include <lsm/detail/policy.hpp>
+#include <lsm/detail/types.hpp>
+
+namespace lsm
+{
+
+// Execution layer: a fixed pool of worker threads that runs machines wrapped in
+// actors. Each worker owns a run queue; idle workers steal from the others. An
+// actor is queued at most once at a time, so its machine is never run by two
+// workers concurrently.
+namespace runtime
+{
+
+// Unit of work accepted by the executor.
+class Runnable
+{
+public:
+    virtual void run() = 0;
+
+protected:
+    ~Runnable() = default;
+};
+
+class Executor
+{
+public:
+    explicit Executor(std::size_t workers = 0)
+    {
+        if(workers == 0)
+        {
+            workers = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+        }
+        queues_ = std::vector<WorkerQueue>(workers);
+        threads_.reserve(workers);
+        for(std::size_t i = 0; i < workers; ++i)
+        {
+            threads_.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    ~Executor()
+    {
+        stopping_.store(true);
+        signal_.fetch_add(1);
+        signal_.notify_all();
+        for(auto& t : threads_) t.join();
+    }
+
+    std::size_t worker_count() const noexcept
+    {
+        return queues_.size();
+    }
+
+    // Queues `task`. From a worker thread it lands on that worker's own queue;
+    // from any other thread queues are picked round-robin.
+    void submit(Runnable& task)
+    {
+        outstanding_.fetch_add(1);
+        const auto self = current_worker();
+        const auto index = self != npos ? self : next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        {
+            std::lock_guard lock(queues_[index].mutex);
+            queues_[index].tasks.push_back(&task);
+        }
+        signal_.fetch_add(1);
+        signal_.notify_one();
+    }
+
+    // Blocks until every submitted task, including tasks submitted while it
+    // waits, has finished running.
+    void wait_idle() const noexcept
+    {
+        for(auto n = outstanding_.load(); n != 0; n = outstanding_.load())
+        {
+            outstanding_.wait(n);
+        }
+    }
+
+private:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Runnable*> tasks;
+    };
+
+    std::size_t current_worker() const noexcept
+    {
+        return tls_owner() == this ? tls_index() : npos;
+    }
+
+    static const Executor*& tls_owner() noexcept
+    {
+        thread_local const Executor* owner = nullptr;
+        return owner;
+    }
+    static std::size_t& tls_index() noexcept
+    {
+        thread_local std::size_t index = npos;
+        return index;
+    }
+
+    // Own queue is served FIFO so re-queued actors take turns; thieves take
+    // from the back of a victim's queue to stay away from its owner.
+    Runnable* take(std::size_t self)
+    {
+        {
+            auto& own = queues_[self];
+            std::lock_guard lock(own.mutex);
+            if(!own.tasks.empty())
+            {
+                auto* task = own.tasks.front();
+                own.tasks.pop_front();
+                return task;
+            }
+        }
+        for(std::size_t step = 1; step < queues_.size(); ++step)
+        {
+            auto& victim = queues_[(self + step) % queues_.size()];
+            std::lock_guard lock(victim.mutex);
+            if(!victim.tasks.empty())
+            {
+                auto* task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    void worker_loop(std::size_t self)
+    {
+        tls_owner() = this;
+        tls_index() = self;
+        while(true)
+        {
+            const auto seen = signal_.load();
+            if(auto* task = take(self))
+            {
+                task->run();
+                if(outstanding_.fetch_sub(1) == 1)
+                {
+                    outstanding_.notify_all();
+                }
+                continue;
+            }
+            if(stopping_.load()) break;
+            signal_.wait(seen);
+        }
+        tls_owner() = nullptr;
+        tls_index() = npos;
+    }
+
+    std::vector<WorkerQueue> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> next_{0};
+    alignas(64) std::atomic<std::size_t> signal_{0};
+    alignas(64) mutable std::atomic<std::size_t> outstanding_{0};
+    std::atomic<bool> stopping_{false};
+};
+
+// Binds a machine to an inbox and an executor. post() is safe from any thread;
+// the machine itself only ever runs on one worker at a time, draining up to
+// `batch` inputs per turn before yielding to other actors. An actor must
+// outlive the work it has been posted, e.g. by calling wait_idle() first.
+template <class Machine>
+class Actor final : public Runnable
+{
+public:
+    using Input_t = typename Machine::Input_t;
+    using Output_t = typename Machine::Output_t;
+    using OutputSink = typename Machine::template Callable<void(Output_t&&)>;
+
+    Actor(Executor& executor, Machine machine, OutputSink sink = {}, DrainLimit batch = {64})
+        : executor_(executor), machine_(std::move(machine)), sink_(std::move(sink)), batch_(batch)
+    {
+        inbox_.set_wake([this] { schedule(); });
+    }
+
+    Actor(const Actor&) = delete;
+    Actor& operator=(const Actor&) = delete;
+
+    template <class U>
+    void post(U&& in)
+    {
+        inbox_.post(std::forward<U>(in));
+    }
+
+    // Only safe while the actor is idle (e.g. after Executor::wait_idle()).
+    Machine& machine() noexcept
+    {
+        return machine_;
+    }
+    const Machine& machine() const noexcept
+    {
+        return machine_;
+    }
+
+    void run() override
+    {
+        auto emit = [this](Output_t&& out) {
+            if(sink_) sink_(std::move(out));
+        };
+        machine_.dispatch_inbox(inbox_, emit, batch_);
+        machine_.dispatch_all(emit);
+
+        // Clear the flag before re-checking the inbox: a post that raced with
+        // the drain either sees the flag cleared and schedules, or is seen here.
+        scheduled_.store(false);
+        if(!inbox_.empty()) schedule();
+    }
+
+private:
+    void schedule()
+    {
+        if(!scheduled_.exchange(true))
+        {
+            executor_.submit(*this);
+        }
+    }
+
+    Executor& executor_;
+    Machine machine_;
+    OutputSink sink_;
+    DrainLimit batch_;
+    detail::Inbox<Input_t, typename Machine::Policy> inbox_;
+    std::atomic<bool> scheduled_{false};
+};
+
+} // namespace runtime
+} // namespace lsm
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <lsm/detail/trace_ring.hpp>
+
+namespace lsm
+{
+namespace detail
+{
+
+template <class T>
+void trace_put(std::ostream& os, const T& value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+bool trace_get(std::istream& is, T& value)
+{
+    return static_cast<bool>(is.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+// Appends `count` elements read from `is` to `out`, growing it one bounded
+// chunk at a time, so a corrupt count fails at the end of the stream instead
+// of sizing a huge allocation up front.
+template <class Container>
+bool trace_get_array(std::istream& is, Container& out, std::uint64_t count)
+{
+    using T = typename Container::value_type;
+    constexpr std::uint64_t chunk = 4096;
+    while(count != 0)
+    {
+        const auto n = static_cast<std::size_t>(count < chunk ? count : chunk);
+        const auto at = out.size();
+        out.resize(at + n);
+        if(!is.read(reinterpret_cast<char*>(out.data() + at), static_cast<std::streamsize>(n * sizeof(T)))) return false;
+        count -= n;
+    }
+    return true;
+}
+
+inline void put_json_string(std::ostream& os, std::string_view text)
+{
+    os << '"';
+    for(char c : text)
+    {
+        if(c == '"' || c == '\\')
+            os << '\\' << c;
+        else if(static_cast<unsigned char>(c) < 0x20)
+            os << ' ';
+        else
+            os << c;
+    }
+    os << '"';
+}
+
+} // namespace detail
+
+namespace trace
+{
+
+using Record = detail::TraceRecord;
+using Ring = detail::TraceRing;
+
+// Ring shared by every machine traced on the calling thread. Give each
+// machine its own `source` in set_trace() to tell them apart.
+inline Ring& thread_ring()
+{
+    thread_local Ring ring;
+    return ring;
+}
+
+// A decoded dump: records oldest first plus optional state names by slot.
+struct Dump
+{
+    std::vector<Record> records;
+    std::vector<std::string> state_names;
+};
+
+inline constexpr char dump_magic[4] = {'L', 'S', 'M', 'T'};
+inline constexpr std::uint32_t dump_version = 1;
+
+// Writes records in the binary dump format: magic, version, record size and
+// count, the raw records in host byte order, then the state names. Meant to
+// be read back by read_dump() on a machine of the same endianness.
+inline void write_dump(std::ostream& os, std::span<const Record> records, std::span<const std::string_view> state_names = {})
+{
+    os.write(dump_magic, sizeof(dump_magic));
+    detail::trace_put(os, dump_version);
+    detail::trace_put(os, static_cast<std::uint32_t>(sizeof(Record)));
+    detail::trace_put(os, static_cast<std::uint64_t>(records.size()));
+    os.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size_bytes()));
+    detail::trace_put(os, static_cast<std::uint32_t>(state_names.size()));
+    for(auto name : state_names)
+    {
+        detail::trace_put(os, static_cast<std::uint32_t>(name.size()));
+        os.write(name.data(), static_cast<std::streamsize>(name.size()));
+    }
+}
+
+inline void write_dump(std::ostream& os, const Ring& ring, std::span<const std::string_view> state_names = {})
+{
+    const auto records = ring.records();
+    write_dump(os, records, state_names);
+}
+
+// Returns nullopt if the stream is not a dump this version understands or
+// ends early; counts are not trusted beyond the bytes actually present.
+inline std::optional<Dump> read_dump(std::istream& is)
+{
+    char magic[sizeof(dump_magic)];
+    std::uint32_t version = 0;
+    std::uint32_t record_size = 0;
+    std::uint64_t count = 0;
+    if(!is.read(magic, sizeof(magic)) || std::string_view(magic, sizeof(magic)) != std::string_view(dump_magic, sizeof(dump_magic)))
+        return std::nullopt;
+    if(!detail::trace_get(is, version) || version != dump_version) return std::nullopt;
+    if(!detail::trace_get(is, record_size) || record_size != sizeof(Record)) return std::nullopt;
+    if(!detail::trace_get(is, count)) return std::nullopt;
+
+    Dump dump;
+    if(!detail::trace_get_array(is, dump.records, count)) return std::nullopt;
+    std::uint32_t names = 0;
+    if(!detail::trace_get(is, names)) return std::nullopt;
+    for(std::uint32_t i = 0; i < names; ++i)
+    {
+        std::uint32_t length = 0;
+        if(!detail::trace_get(is, length)) return std::nullopt;
+        std::string name;
+        if(!detail::trace_get_array(is, name, length)) return std::nullopt;
+        dump.state_names.push_back(std::move(name));
+    }
+    return dump;
+}
+
+// Converts records to the Chrome trace event format (chrome://tracing,
+// Perfetto). Each source becomes a thread track. Every transition is an
+// instant event, and the time a source spent in a state between two of its
+// records becomes a duration event named after that state.
+inline void write_chrome_json(std::ostream& os, std::span<const Record> records, std::span<const std::string> state_names = {})
+{
+    auto state_name = [&](std::uint32_t slot) {
+        return slot < state_names.size() ? state_names[slot] : "state " + std::to_string(slot);
+    };
+    auto micros = [](std::uint64_t ns) {
+        return std::to_string(ns / 1000) + '.' + std::to_string(ns % 1000 / 100) + std::to_string(ns % 100 / 10) + std::to_string(ns % 10);
+    };
+
+    os << "{\"traceEvents\":[";
+    bool first = true;
+    auto begin_event = [&] {
+        if(!first) os << ',';
+        first = false;
+    };
+
+    std::unordered_map<std::uint32_t, const Record*> last;
+    for(const auto& record : records)
+    {
+        if(auto it = last.find(record.source); it != last.end())
+        {
+            const auto& previous = *it->second;
+            begin_event();
+            os << "{\"ph\":\"X\",\"pid\":0,\"tid\":" << record.source << ",\"name\":";
+            detail::put_json_string(os, state_name(previous.to));
+            os << ",\"ts\":" << micros(previous.timestamp) << ",\"dur\":" << micros(record.timestamp - previous.timestamp) << '}';
+        }
+        last[record.source] = &record;
+
+        begin_event();
+        os << "{\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":" << record.source << ",\"name\":";
+        detail::put_json_string(os, state_name(record.from) + " -> " + state_name(record.to));
+        os << ",\"ts\":" << micros(record.timestamp) << ",\"args\":{\"" << ((record.flags & Record::completion) ? "completion" : "transition")
+           << "\":" << record.id;
+        if(record.input != Record::no_input) os << ",\"input\":" << record.input;
+        os << ",\"output\":" << ((record.flags & Record::output) ? "true" : "false");
+        if(record.flags & Record::deferred) os << ",\"deferred\":true";
+        os << "}}";
+    }
+    os << "]}";
+}
+
+inline void write_chrome_json(std::ostream& os, const Dump& dump)
+{
+    write_chrome_json(os, dump.records, dump.state_names);
+}
+
+} // namespace trace
+} // namespace lsm
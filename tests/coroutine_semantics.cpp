@@ -51,7 +51,7 @@ static void test_commit_before_effect() {
         });
     auto task = adapter.dispatch_async(Input{Start{}});
     while (!task.await_ready()) {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
     auto out = task.await_resume();
     assert(!out);
@@ -74,14 +74,14 @@ static void test_cancellation_propagates() {
     );
     auto task = adapter.dispatch_async(Input{Start{}});
     if (!task.await_ready()) {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
     source.request_stop();
     auto check = source.token();
     assert(check.stop_requested());
     gate.resume();
     while (!task.await_ready()) {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
     bool caught = false;
     try {
@@ -106,7 +106,7 @@ static void test_exception_propagates() {
     bool caught = false;
     try {
         while (!task.await_ready()) {
-            task.await_suspend(std::noop_coroutine());
+            task.await_suspend(std::noop_coroutine()).resume();
         }
         task.await_resume();
     } catch (const std::runtime_error&) {
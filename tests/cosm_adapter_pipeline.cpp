@@ -40,7 +40,7 @@ static void run(lsm::co::Task<std::optional<Output>>& task)
 {
     while(!task.await_ready())
     {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
 }
 
@@ -48,7 +48,7 @@ static void run(lsm::co::Task<void>& task)
 {
     while(!task.await_ready())
     {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
 }
 
@@ -91,7 +91,7 @@ void drive(Task& task)
 {
     while(!task.await_ready())
     {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
 }
 
@@ -0,0 +1,135 @@
+#include <cassert>
+#include <chrono>
+#include <optional>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+#include <lsm/cosm.hpp>
+
+using namespace std::chrono_literals;
+
+enum class State { Idle };
+struct Fetch
+{
+    int id;
+};
+using Input = std::variant<Fetch>;
+using Output = int;
+
+struct Context
+{
+    std::vector<int> completed;
+    std::vector<int> dropped;
+};
+
+using Machine = lsm::CoMachine<State, Input, Output, Context>;
+
+static Machine make_machine()
+{
+    Machine::Builder builder;
+    builder.set_initial(State::Idle);
+    builder.on<Fetch>(State::Idle, State::Idle);
+    return std::move(builder).build({});
+}
+
+// Sleeps, then reports whether its dispatch was still wanted.
+static void bind_fetch(lsm::co::Adapter<Machine>& adapter, lsm::co::scheduler sched)
+{
+    adapter.bind_async(State::Idle, State::Idle,
+        [sched](const Input& in, Context& ctx, lsm::co::CancelToken token, auto&) -> lsm::co::Task<std::optional<Output>> {
+            const int id = std::get<Fetch>(in).id;
+            co_await sched.sleep_for(10ms);
+            if(token.stop_requested())
+            {
+                ctx.dropped.push_back(id);
+                co_return std::nullopt;
+            }
+            ctx.completed.push_back(id);
+            co_return id;
+        });
+}
+
+template <class T>
+static void start(lsm::co::Task<T>& task)
+{
+    task.await_suspend(std::noop_coroutine()).resume();
+}
+
+static void test_linked_sources()
+{
+    lsm::co::CancelSource root;
+    lsm::co::CancelSource child(&root);
+    lsm::co::CancelSource grandchild(&child);
+    assert(!grandchild.token().stop_requested());
+
+    child.request_stop();
+    assert(grandchild.token().stop_requested());
+    assert(!root.token().stop_requested());
+
+    child.reset();
+    root.request_stop();
+    assert(child.token().stop_requested() && grandchild.token().stop_requested());
+    grandchild.reset();
+    assert(grandchild.token().stop_requested());
+}
+
+static void test_superseded_dispatch_is_dropped()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    lsm::co::CancelSource global;
+    Machine machine = make_machine();
+    lsm::co::Adapter<Machine> adapter(machine, &global);
+    bind_fetch(adapter, sched);
+
+    lsm::co::CancelSource first_scope;
+    lsm::co::CancelSource second_scope;
+    auto first = adapter.dispatch_async(Input{Fetch{1}}, first_scope);
+    assert(first_scope.parent == &global);
+    start(first);
+    loop.advance(5ms);
+    auto second = adapter.dispatch_async(Input{Fetch{2}}, second_scope);
+    start(second);
+    // The newer request makes the first one stale.
+    first_scope.request_stop();
+    loop.advance(10ms);
+
+    assert(first.await_ready() && !first.await_resume());
+    auto out = second.await_resume();
+    assert(out && *out == 2);
+    assert((machine.context().dropped == std::vector<int>{1}));
+    assert((machine.context().completed == std::vector<int>{2}));
+    assert(!global.token().stop_requested());
+}
+
+static void test_global_cancels_every_dispatch()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    lsm::co::CancelSource global;
+    Machine machine = make_machine();
+    lsm::co::Adapter<Machine> adapter(machine, &global);
+    bind_fetch(adapter, sched);
+
+    lsm::co::CancelSource scope;
+    auto scoped = adapter.dispatch_async(Input{Fetch{1}}, scope);
+    auto unscoped = adapter.dispatch_async_all(Input{Fetch{2}});
+    start(scoped);
+    start(unscoped);
+    global.request_stop();
+    loop.advance(10ms);
+
+    assert(!scoped.await_resume());
+    assert(unscoped.await_resume().empty());
+    assert((machine.context().dropped == std::vector<int>{1, 2}));
+    assert(machine.context().completed.empty());
+}
+
+int main()
+{
+    test_linked_sources();
+    test_superseded_dispatch_is_dropped();
+    test_global_cancels_every_dispatch();
+    return 0;
+}
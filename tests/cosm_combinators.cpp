@@ -0,0 +1,183 @@
+#include <cassert>
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include <lsm/cosm.hpp>
+
+using namespace std::chrono_literals;
+
+static lsm::co::Task<int> after(lsm::co::scheduler sched, std::chrono::milliseconds delay, int value)
+{
+    co_await sched.sleep_for(delay);
+    if(value < 0) throw std::runtime_error("failed");
+    co_return value;
+}
+
+static lsm::co::Task<void> tick(lsm::co::scheduler sched, std::chrono::milliseconds delay, int& counter)
+{
+    co_await sched.sleep_for(delay);
+    ++counter;
+}
+
+static lsm::co::Task<int> immediate(int value)
+{
+    co_return value;
+}
+
+template <class T>
+static void start(lsm::co::Task<T>& task)
+{
+    task.await_suspend(std::noop_coroutine()).resume();
+}
+
+static void test_when_any_first_finisher_wins()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    lsm::co::CancelSource losers;
+    std::vector<lsm::co::Task<int>> tasks;
+    tasks.push_back(after(sched, 30ms, 1));
+    tasks.push_back(after(sched, 10ms, 2));
+    tasks.push_back(after(sched, 20ms, 3));
+    {
+        auto race = lsm::co::when_any(std::move(tasks), &losers);
+        start(race);
+        assert(loop.timers() == 3);
+        loop.advance(10ms);
+        assert(race.await_ready());
+        assert(losers.token().stop_requested());
+        auto result = race.await_resume();
+        assert(result.index == 1 && result.value == 2);
+    }
+    // Losers were destroyed when the race was decided and dropped their timers.
+    assert(loop.timers() == 0);
+}
+
+static void test_when_any_losers_outlive_the_race_deadline()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    std::vector<lsm::co::Task<int>> tasks;
+    tasks.push_back(after(sched, 10ms, 1));
+    tasks.push_back(after(sched, 20ms, 2));
+    auto race = lsm::co::when_any(std::move(tasks));
+    start(race);
+    // The race stays alive past the loser's deadline; the loser must already
+    // be gone rather than finish into the race's released join frames.
+    loop.advance(30ms);
+    assert(race.await_ready());
+    assert(loop.timers() == 0);
+    auto result = race.await_resume();
+    assert(result.index == 0 && result.value == 1);
+
+    std::vector<lsm::co::Task<int>> same_tick;
+    same_tick.push_back(after(sched, 5ms, 3));
+    same_tick.push_back(after(sched, 5ms, 4));
+    auto tied = lsm::co::when_any(std::move(same_tick));
+    start(tied);
+    loop.run();
+    assert(tied.await_ready());
+    auto tie = tied.await_resume();
+    assert(tie.index == 0 && tie.value == 3);
+}
+
+static void test_when_any_synchronous_winner()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    std::vector<lsm::co::Task<int>> tasks;
+    tasks.push_back(after(sched, 5ms, 1));
+    tasks.push_back(immediate(7));
+    tasks.push_back(after(sched, 1ms, 3));
+    auto race = lsm::co::when_any(std::move(tasks));
+    start(race);
+    assert(race.await_ready());
+    auto result = race.await_resume();
+    assert(result.index == 1 && result.value == 7);
+    assert(loop.timers() == 0); // the first racer was destroyed, the third never started
+}
+
+static void test_when_any_void_and_exceptions()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    int ticks = 0;
+    std::vector<lsm::co::Task<void>> tasks;
+    tasks.push_back(tick(sched, 4ms, ticks));
+    tasks.push_back(tick(sched, 2ms, ticks));
+    auto race = lsm::co::when_any(std::move(tasks));
+    start(race);
+    loop.advance(2ms);
+    assert(race.await_resume() == 1);
+    assert(ticks == 1);
+
+    std::vector<lsm::co::Task<int>> failing;
+    failing.push_back(after(sched, 1ms, -1));
+    failing.push_back(after(sched, 2ms, 2));
+    auto bad = lsm::co::when_any(std::move(failing));
+    start(bad);
+    loop.advance(1ms);
+    bool caught = false;
+    try
+    {
+        bad.await_resume();
+    } catch(const std::runtime_error&)
+    {
+        caught = true;
+    }
+    assert(caught);
+}
+
+static void test_with_timeout()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+
+    auto fast = lsm::co::with_timeout(after(sched, 10ms, 5), 50ms, sched);
+    start(fast);
+    loop.advance(10ms);
+    assert(fast.await_ready() && fast.await_resume() == 5);
+    assert(loop.timers() == 0);
+
+    lsm::co::CancelSource cancel;
+    auto slow = lsm::co::with_timeout(after(sched, 100ms, 5), 50ms, sched, &cancel);
+    start(slow);
+    loop.advance(49ms);
+    assert(!slow.await_ready());
+    loop.advance(1ms);
+    assert(slow.await_ready());
+    assert(cancel.token().stop_requested());
+    bool timed_out = false;
+    try
+    {
+        slow.await_resume();
+    } catch(const lsm::co::timeout_error&)
+    {
+        timed_out = true;
+    }
+    assert(timed_out);
+    // The timed-out task was destroyed with its timer, so finishing the loop
+    // never resumes it.
+    assert(loop.timers() == 0);
+    loop.advance(100ms);
+
+    int ticks = 0;
+    auto void_task = lsm::co::with_timeout(tick(sched, 1ms, ticks), 5ms, sched);
+    start(void_task);
+    loop.advance(1ms);
+    assert(void_task.await_ready());
+    void_task.await_resume();
+    assert(ticks == 1);
+}
+
+int main()
+{
+    test_when_any_first_finisher_wins();
+    test_when_any_losers_outlive_the_race_deadline();
+    test_when_any_synchronous_winner();
+    test_when_any_void_and_exceptions();
+    test_with_timeout();
+    return 0;
+}
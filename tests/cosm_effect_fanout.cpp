@@ -0,0 +1,180 @@
+#include <cassert>
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+#include <lsm/cosm.hpp>
+
+using namespace std::chrono_literals;
+
+enum class State { Idle, Active };
+struct Go {};
+using Input = std::variant<Go>;
+using Output = int;
+
+struct Context
+{
+    std::vector<int> finished;
+};
+
+using Machine = lsm::CoMachine<State, Input, Output, Context>;
+
+static Machine make_machine(bool transition_output = false)
+{
+    Machine::Builder builder;
+    builder.set_initial(State::Idle);
+    if(transition_output)
+    {
+        builder.on<Go>(State::Idle, State::Active, [](const Go&, Context&) -> std::optional<Output> { return 100; });
+    }
+    else
+    {
+        builder.on<Go>(State::Idle, State::Active);
+    }
+    return std::move(builder).build({});
+}
+
+// Effect that sleeps for `delay` and then produces `value` (or nothing if 0).
+static auto sleeping_effect(lsm::co::scheduler sched, std::chrono::milliseconds delay, int value)
+{
+    return [sched, delay, value](const Input&, Context& ctx, lsm::co::CancelToken, auto&) -> lsm::co::Task<std::optional<Output>> {
+        co_await sched.sleep_for(delay);
+        ctx.finished.push_back(value);
+        if(value == 0) co_return std::nullopt;
+        co_return value;
+    };
+}
+
+template <class T>
+static void start(lsm::co::Task<T>& task)
+{
+    task.await_suspend(std::noop_coroutine()).resume();
+}
+
+static lsm::co::Task<int> after(lsm::co::scheduler sched, std::chrono::milliseconds delay, int value)
+{
+    co_await sched.sleep_for(delay);
+    if(value < 0) throw std::runtime_error("failed");
+    co_return value;
+}
+
+static void test_when_all_overlaps()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    std::vector<lsm::co::Task<int>> tasks;
+    tasks.push_back(after(sched, 30ms, 1));
+    tasks.push_back(after(sched, 10ms, 2));
+    tasks.push_back(after(sched, 20ms, 3));
+    auto all = lsm::co::when_all(std::move(tasks));
+    start(all);
+    loop.advance(29ms);
+    assert(!all.await_ready());
+    loop.advance(1ms);
+    assert(all.await_ready());
+    assert((all.await_resume() == std::vector<int>{1, 2, 3}));
+
+    auto empty = lsm::co::when_all(std::vector<lsm::co::Task<int>>{});
+    start(empty);
+    assert(empty.await_ready() && empty.await_resume().empty());
+}
+
+static void test_when_all_waits_before_rethrowing()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    std::vector<lsm::co::Task<int>> tasks;
+    tasks.push_back(after(sched, 20ms, 1));
+    tasks.push_back(after(sched, 5ms, -1));
+    auto all = lsm::co::when_all(std::move(tasks));
+    start(all);
+    loop.advance(5ms);
+    assert(!all.await_ready());
+    loop.advance(15ms);
+    assert(all.await_ready());
+    bool caught = false;
+    try
+    {
+        all.await_resume();
+    } catch(const std::runtime_error&)
+    {
+        caught = true;
+    }
+    assert(caught);
+}
+
+static void test_adapter_fans_out_effects()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    Machine machine = make_machine();
+    lsm::co::Adapter<Machine> adapter(machine);
+    adapter.bind_async(State::Idle, State::Active, sleeping_effect(sched, 50ms, 1));
+    adapter.bind_async(State::Idle, State::Active, sleeping_effect(sched, 20ms, 2));
+    adapter.bind_async(State::Idle, State::Active, sleeping_effect(sched, 40ms, 0));
+
+    auto task = adapter.dispatch_async(Input{Go{}});
+    start(task);
+    assert(machine.state() == State::Active);
+    assert(machine.async_state());
+    loop.advance(50ms);
+    assert(task.await_ready());
+    assert(!machine.async_state());
+    assert((machine.context().finished == std::vector<int>{2, 0, 1}));
+    auto out = task.await_resume();
+    assert(out && *out == 1);
+}
+
+static void test_merge_policies()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+
+    {
+        Machine machine = make_machine();
+        lsm::co::Adapter<Machine> adapter(machine);
+        adapter.set_merge_policy(lsm::co::merge_policy::last_wins);
+        adapter.bind_async(State::Idle, State::Active, sleeping_effect(sched, 5ms, 1));
+        adapter.bind_async(State::Idle, State::Active, sleeping_effect(sched, 1ms, 2));
+        adapter.bind_async(State::Idle, State::Active, sleeping_effect(sched, 3ms, 0));
+        auto task = adapter.dispatch_async(Input{Go{}});
+        start(task);
+        loop.advance(5ms);
+        auto out = task.await_resume();
+        assert(out && *out == 2);
+    }
+    {
+        Machine machine = make_machine(true);
+        lsm::co::Adapter<Machine> adapter(machine);
+        adapter.bind_async(State::Idle, State::Active, sleeping_effect(sched, 2ms, 0));
+        adapter.bind_async(State::Idle, State::Active, sleeping_effect(sched, 1ms, 0));
+        auto task = adapter.dispatch_async(Input{Go{}});
+        start(task);
+        loop.advance(2ms);
+        auto out = task.await_resume();
+        assert(out && *out == 100);
+    }
+    {
+        Machine machine = make_machine(true);
+        lsm::co::Adapter<Machine> adapter(machine);
+        adapter.bind_async(State::Idle, State::Active, sleeping_effect(sched, 3ms, 7));
+        adapter.bind_async(State::Idle, State::Active, sleeping_effect(sched, 1ms, 0));
+        adapter.bind_async(State::Idle, State::Active, sleeping_effect(sched, 2ms, 9));
+        auto task = adapter.dispatch_async_all(Input{Go{}});
+        start(task);
+        loop.advance(3ms);
+        assert((task.await_resume() == std::vector<int>{100, 7, 9}));
+    }
+}
+
+int main()
+{
+    test_when_all_overlaps();
+    test_when_all_waits_before_rethrowing();
+    test_adapter_fans_out_effects();
+    test_merge_policies();
+    return 0;
+}
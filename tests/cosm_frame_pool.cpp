@@ -0,0 +1,181 @@
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include <variant>
+
+#include <lsm/core.hpp>
+#include <lsm/cosm.hpp>
+
+static std::size_t global_allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    ++global_allocations;
+    if(void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc{};
+}
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+enum class State { Idle, Active };
+struct Ping {};
+struct Reset {};
+using Input = std::variant<Ping, Reset>;
+using Output = int;
+struct Context
+{
+    int effects = 0;
+};
+
+using Machine = lsm::CoMachine<State, Input, Output, Context>;
+
+struct CountingResource : std::pmr::memory_resource
+{
+    std::size_t allocations = 0;
+    std::size_t live = 0;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++allocations;
+        ++live;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        --live;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+static Machine make_machine()
+{
+    Machine::Builder builder;
+    builder.set_initial(State::Idle);
+    builder.on<Ping>(State::Idle, State::Active);
+    builder.on<Reset>(State::Active, State::Idle);
+    return std::move(builder).build({});
+}
+
+static void bind_effect(lsm::co::Adapter<Machine>& adapter)
+{
+    adapter.bind_async(State::Idle, State::Active,
+        [](const Input&, Context& ctx, lsm::co::CancelToken, auto&) -> lsm::co::Task<std::optional<Output>> {
+            co_return ++ctx.effects;
+        });
+}
+
+template <class T>
+static T run(lsm::co::Task<T>& task)
+{
+    while(!task.await_ready())
+    {
+        task.await_suspend(std::noop_coroutine()).resume();
+    }
+    return task.await_resume();
+}
+
+static lsm::co::Task<int> leaf()
+{
+    co_return 1;
+}
+
+static void test_pool_reuses_frames()
+{
+    {
+        auto task = leaf();
+        const int result = run(task);
+        assert(result == 1);
+    }
+    const auto cached = lsm::detail::FramePool::cached();
+    assert(cached > 0);
+    {
+        auto task = leaf();
+        assert(lsm::detail::FramePool::cached() == cached - 1);
+        const int result = run(task);
+        assert(result == 1);
+    }
+    assert(lsm::detail::FramePool::cached() == cached);
+}
+
+static void test_steady_state_dispatch_does_not_allocate()
+{
+    Machine machine = make_machine();
+    lsm::co::Adapter<Machine> adapter(machine);
+    bind_effect(adapter);
+
+    auto round = [&] {
+        auto task = adapter.dispatch_async(Input{Ping{}});
+        auto out = run(task);
+        assert(out);
+        machine.dispatch(Input{Reset{}});
+    };
+    round();
+    const auto before = global_allocations;
+    for(int i = 0; i < 1000; ++i) round();
+    assert(global_allocations == before);
+    assert(machine.context().effects == 1001);
+}
+
+static void test_adapter_frame_resource()
+{
+    Machine machine = make_machine();
+    lsm::co::Adapter<Machine> adapter(machine);
+    bind_effect(adapter);
+    CountingResource resource;
+    adapter.set_frame_resource(&resource);
+    {
+        auto task = adapter.dispatch_async(Input{Ping{}});
+        assert(resource.live == 1);
+        auto out = run(task);
+        assert(out && *out == 1);
+        assert(resource.allocations == 2);
+    }
+    assert(resource.live == 0);
+}
+
+static void test_scope_routes_frames()
+{
+    CountingResource resource;
+    {
+        lsm::co::frame_resource_scope scope(&resource);
+        auto task = leaf();
+        assert(resource.live == 1);
+        {
+            lsm::co::frame_resource_scope inner(nullptr);
+            auto pooled = leaf();
+            assert(resource.live == 1);
+            const int inner_result = run(pooled);
+            assert(inner_result == 1);
+        }
+        const int result = run(task);
+        assert(result == 1);
+    }
+    assert(resource.live == 0);
+    auto after = leaf();
+    assert(resource.allocations == 1);
+    const int result = run(after);
+    assert(result == 1);
+}
+
+int main()
+{
+    test_pool_reuses_frames();
+    test_steady_state_dispatch_does_not_allocate();
+    test_adapter_frame_resource();
+    test_scope_routes_frames();
+    return 0;
+}
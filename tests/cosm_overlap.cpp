@@ -0,0 +1,196 @@
+#include <cassert>
+#include <chrono>
+#include <optional>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+#include <lsm/cosm.hpp>
+
+using namespace std::chrono_literals;
+
+enum class State { Idle, Busy };
+struct Fetch
+{
+    int id;
+    int delay_ms;
+};
+struct Ignored {};
+using Input = std::variant<Fetch, Ignored>;
+using Output = int;
+
+struct Context
+{
+    std::vector<int> started;
+    std::vector<int> completed;
+};
+
+using Machine = lsm::CoMachine<State, Input, Output, Context>;
+
+// Busy completes straight back to Idle, so every Fetch is accepted and the
+// completion runs while earlier effects may still be in flight.
+static Machine make_machine()
+{
+    Machine::Builder builder;
+    builder.set_initial(State::Idle);
+    builder.on<Fetch>(State::Idle, State::Busy);
+    builder.completion(State::Busy).to(State::Idle);
+    return std::move(builder).build({});
+}
+
+static void bind_fetch(lsm::co::Adapter<Machine>& adapter, lsm::co::scheduler sched)
+{
+    adapter.bind_async(State::Idle, State::Busy,
+        [sched](const Input& in, Context& ctx, lsm::co::CancelToken token, auto&) -> lsm::co::Task<std::optional<Output>> {
+            const auto fetch = std::get<Fetch>(in);
+            ctx.started.push_back(fetch.id);
+            if(fetch.delay_ms) co_await sched.sleep_for(std::chrono::milliseconds(fetch.delay_ms));
+            if(token.stop_requested()) co_return std::nullopt;
+            ctx.completed.push_back(fetch.id);
+            co_return fetch.id;
+        });
+}
+
+template <class T>
+static void start(lsm::co::Task<T>& task)
+{
+    task.await_suspend(std::noop_coroutine()).resume();
+}
+
+static void test_process_overlaps_effects()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    Machine machine = make_machine();
+    lsm::co::Adapter<Machine> adapter(machine);
+    bind_fetch(adapter, sched);
+
+    auto first = adapter.dispatch_async(Input{Fetch{1, 20}});
+    auto second = adapter.dispatch_async(Input{Fetch{2, 10}});
+    start(first);
+    start(second);
+    assert(machine.state() == State::Idle);
+    assert(machine.async_inflight() == 2);
+    loop.advance(10ms);
+    assert(second.await_ready() && !first.await_ready());
+    assert(machine.async_inflight() == 1);
+    loop.advance(10ms);
+    assert(!machine.async_state());
+    assert(*first.await_resume() == 1 && *second.await_resume() == 2);
+    assert((machine.context().completed == std::vector<int>{2, 1}));
+}
+
+static void test_queue_serializes_dispatches()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    Machine machine = make_machine();
+    lsm::co::Adapter<Machine> adapter(machine);
+    adapter.set_overlap_policy(lsm::co::overlap_policy::queue);
+    bind_fetch(adapter, sched);
+
+    auto first = adapter.dispatch_async(Input{Fetch{1, 10}});
+    auto second = adapter.dispatch_async(Input{Fetch{2, 0}});
+    auto third = adapter.dispatch_async(Input{Fetch{3, 0}});
+    auto fourth = adapter.dispatch_async(Input{Fetch{4, 5}});
+    start(first);
+    start(second);
+    start(third);
+    start(fourth);
+    assert((machine.context().started == std::vector<int>{1}));
+    assert(machine.async_inflight() == 1);
+
+    // The first finishes and the queue drains in order; the synchronous
+    // second and third complete inside the same wake-up.
+    loop.advance(10ms);
+    assert(first.await_ready() && second.await_ready() && third.await_ready());
+    assert(!fourth.await_ready());
+    assert((machine.context().started == std::vector<int>{1, 2, 3, 4}));
+    loop.advance(5ms);
+    assert(*fourth.await_resume() == 4);
+    assert((machine.context().completed == std::vector<int>{1, 2, 3, 4}));
+
+    // A queued dispatch dropped before its turn leaves the queue.
+    auto busy = adapter.dispatch_async(Input{Fetch{5, 5}});
+    start(busy);
+    {
+        auto dropped = adapter.dispatch_async(Input{Fetch{6, 0}});
+        start(dropped);
+    }
+    auto after = adapter.dispatch_async(Input{Fetch{7, 0}});
+    start(after);
+    loop.advance(5ms);
+    assert(after.await_ready() && *after.await_resume() == 7);
+    assert((machine.context().started == std::vector<int>{1, 2, 3, 4, 5, 7}));
+}
+
+// A dispatch destroyed mid-effect, here by with_timeout, still ends its
+// effect and hands the queue on.
+static void test_timed_out_dispatch_releases_queue()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    Machine machine = make_machine();
+    lsm::co::Adapter<Machine> adapter(machine);
+    adapter.set_overlap_policy(lsm::co::overlap_policy::queue);
+    bind_fetch(adapter, sched);
+
+    auto timed = lsm::co::with_timeout(adapter.dispatch_async(Input{Fetch{1, 50}}), 10ms, sched);
+    auto next = adapter.dispatch_async(Input{Fetch{2, 0}});
+    start(timed);
+    start(next);
+    assert(machine.async_inflight() == 1 && !next.await_ready());
+
+    loop.advance(10ms);
+    bool timed_out = false;
+    try
+    {
+        timed.await_resume();
+    } catch(const lsm::co::timeout_error&)
+    {
+        timed_out = true;
+    }
+    assert(timed_out);
+    assert(next.await_ready() && *next.await_resume() == 2);
+    assert(machine.async_inflight() == 0);
+
+    loop.advance(50ms);
+    assert(loop.idle());
+    assert((machine.context().completed == std::vector<int>{2}));
+}
+
+static void test_supersede_cancels_stale_effects()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    Machine machine = make_machine();
+    lsm::co::Adapter<Machine> adapter(machine);
+    adapter.set_overlap_policy(lsm::co::overlap_policy::supersede);
+    bind_fetch(adapter, sched);
+
+    lsm::co::CancelSource first_scope;
+    auto first = adapter.dispatch_async(Input{Fetch{1, 10}}, first_scope);
+    start(first);
+    // Unhandled input does not supersede anything.
+    auto ignored = adapter.dispatch_async(Input{Ignored{}});
+    start(ignored);
+    assert(!first_scope.token().stop_requested());
+
+    auto second = adapter.dispatch_async(Input{Fetch{2, 10}});
+    start(second);
+    assert(first_scope.token().stop_requested());
+    loop.advance(10ms);
+    assert(!first.await_resume());
+    assert(*second.await_resume() == 2);
+    assert((machine.context().completed == std::vector<int>{2}));
+    assert(!machine.async_state());
+}
+
+int main()
+{
+    test_process_overlaps_effects();
+    test_queue_serializes_dispatches();
+    test_timed_out_dispatch_releases_queue();
+    test_supersede_cancels_stale_effects();
+    return 0;
+}
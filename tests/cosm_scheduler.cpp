@@ -0,0 +1,191 @@
+#include <cassert>
+#include <chrono>
+#include <optional>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+#include <lsm/cosm.hpp>
+
+using namespace std::chrono_literals;
+
+enum class State { Idle, Active };
+struct Kick {};
+using Input = std::variant<Kick>;
+using Output = int;
+
+struct Context
+{
+    int attempts = 0;
+    std::vector<std::chrono::nanoseconds> tried_at;
+};
+
+using Machine = lsm::CoMachine<State, Input, Output, Context>;
+
+static lsm::co::Task<void> sleeper(lsm::co::scheduler sched, std::chrono::milliseconds delay, int id, std::vector<int>& log)
+{
+    co_await sched.sleep_for(delay);
+    log.push_back(id);
+}
+
+static lsm::co::Task<void> yielder(lsm::co::scheduler sched, int id, int rounds, std::vector<int>& log)
+{
+    for(int i = 0; i < rounds; ++i)
+    {
+        log.push_back(id);
+        co_await sched.yield();
+    }
+}
+
+static void start(lsm::co::Task<void>& task)
+{
+    task.await_suspend(std::noop_coroutine()).resume();
+}
+
+static void test_virtual_time_ordering()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    std::vector<int> log;
+
+    // Spread across every wheel level, including one past the horizon.
+    std::vector<lsm::co::Task<void>> tasks;
+    tasks.push_back(sleeper(sched, 300000ms, 5, log));
+    tasks.push_back(sleeper(sched, 5000ms, 4, log));
+    tasks.push_back(sleeper(sched, 20000000ms, 6, log));
+    tasks.push_back(sleeper(sched, 3ms, 1, log));
+    tasks.push_back(sleeper(sched, 64ms, 3, log));
+    tasks.push_back(sleeper(sched, 63ms, 2, log));
+    for(auto& task : tasks) start(task);
+    assert(loop.timers() == 6);
+
+    loop.advance(2ms);
+    assert(log.empty());
+    loop.advance(1ms);
+    assert((log == std::vector<int>{1}));
+    loop.advance(61ms);
+    assert((log == std::vector<int>{1, 2, 3}));
+    loop.advance(4935ms);
+    assert(log.size() == 3);
+    loop.advance(1ms);
+    assert((log == std::vector<int>{1, 2, 3, 4}));
+    loop.advance(295000ms);
+    assert((log == std::vector<int>{1, 2, 3, 4, 5}));
+    loop.advance(20000000ms);
+    assert((log == std::vector<int>{1, 2, 3, 4, 5, 6}));
+    assert(loop.now() == 20300000ms);
+    assert(loop.idle());
+    for(auto& task : tasks) assert(task.await_ready());
+}
+
+static void test_yield_round_robin()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    std::vector<int> log;
+    auto a = yielder(sched, 1, 3, log);
+    auto b = yielder(sched, 2, 3, log);
+    start(a);
+    start(b);
+    assert((log == std::vector<int>{1, 2}));
+    const auto resumed = loop.run_ready();
+    assert(resumed == 2);
+    assert((log == std::vector<int>{1, 2, 1, 2}));
+    loop.run();
+    assert((log == std::vector<int>{1, 2, 1, 2, 1, 2}));
+    assert(a.await_ready() && b.await_ready());
+}
+
+static void test_destroying_sleeper_disarms()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    std::vector<int> log;
+    {
+        auto task = sleeper(sched, 10ms, 1, log);
+        start(task);
+        assert(loop.timers() == 1);
+    }
+    assert(loop.timers() == 0);
+    assert(loop.idle());
+    loop.advance(20ms);
+    assert(log.empty());
+}
+
+static void test_unbound_scheduler_is_inline()
+{
+    lsm::co::scheduler sched;
+    assert(sched.loop() == nullptr);
+    std::vector<int> log;
+    auto task = sleeper(sched, 1000ms, 7, log);
+    start(task);
+    assert(task.await_ready());
+    assert((log == std::vector<int>{7}));
+}
+
+static void test_wall_clock_run()
+{
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    std::vector<int> log;
+    auto slow = sleeper(sched, 20ms, 2, log);
+    auto fast = sleeper(sched, 5ms, 1, log);
+    start(slow);
+    const auto begin = std::chrono::steady_clock::now();
+    const bool finished = loop.run(fast);
+    assert(finished);
+    assert((log == std::vector<int>{1}));
+    loop.run();
+    assert(std::chrono::steady_clock::now() - begin >= 20ms);
+    assert((log == std::vector<int>{1, 2}));
+}
+
+static void test_retry_backoff_sleeps()
+{
+    Machine::Builder builder;
+    builder.set_initial(State::Idle);
+    builder.on<Kick>(State::Idle, State::Active);
+    Machine machine = std::move(builder).build({});
+
+    lsm::co::run_loop loop;
+    lsm::co::scheduler sched(loop);
+    lsm::co::Adapter<Machine> adapter(machine);
+    adapter.from(State::Idle)
+        .on<Kick>()
+        .to(State::Active)
+        .then([&](const Input&, Context& ctx, lsm::co::CancelToken, auto&) -> lsm::co::Task<std::optional<Output>> {
+            ctx.tried_at.push_back(loop.now());
+            if(++ctx.attempts < 3) co_return std::nullopt;
+            co_return 42;
+        })
+        .retry(3, [&](int attempt, const Input&, Context&, lsm::co::CancelToken, auto&) -> lsm::co::Task<void> {
+            co_await sched.sleep_for(std::chrono::milliseconds(100 * attempt));
+        })
+        .attach();
+
+    auto task = adapter.dispatch_async(Input{Kick{}});
+    task.await_suspend(std::noop_coroutine()).resume();
+    assert(machine.context().attempts == 1);
+    assert(!task.await_ready());
+
+    loop.advance(99ms);
+    assert(machine.context().attempts == 1);
+    loop.advance(1ms);
+    assert(machine.context().attempts == 2);
+    loop.advance(200ms);
+    assert(task.await_ready());
+    auto out = task.await_resume();
+    assert(out && *out == 42);
+    assert((machine.context().tried_at == std::vector<std::chrono::nanoseconds>{0ms, 100ms, 300ms}));
+}
+
+int main()
+{
+    test_virtual_time_ordering();
+    test_yield_round_robin();
+    test_destroying_sleeper_disarms();
+    test_unbound_scheduler_is_inline();
+    test_wall_clock_run();
+    test_retry_backoff_sleeps();
+    return 0;
+}
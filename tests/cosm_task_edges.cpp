@@ -28,7 +28,7 @@ void run(TaskT& task)
 {
     if(!task.await_ready())
     {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
     if constexpr(!std::is_same_v<TaskT, lsm::co::Task<void>>)
     {
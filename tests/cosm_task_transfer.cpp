@@ -0,0 +1,104 @@
+#include <cassert>
+#include <optional>
+#include <variant>
+
+#include <lsm/core.hpp>
+#include <lsm/cosm.hpp>
+
+// Each of these would nest one or two native frames per await without
+// symmetric transfer and overflow the default stack.
+
+enum class State { Idle, Done };
+struct Go {};
+using Input = std::variant<Go>;
+using Output = int;
+struct Context
+{
+    int steps = 0;
+};
+
+using Machine = lsm::CoMachine<State, Input, Output, Context>;
+
+static lsm::co::Task<int> one()
+{
+    co_return 1;
+}
+
+static lsm::co::Task<void> nothing()
+{
+    co_return;
+}
+
+static lsm::co::Task<long> sequential(int n)
+{
+    long sum = 0;
+    for(int i = 0; i < n; ++i)
+    {
+        sum += co_await one();
+        co_await nothing();
+    }
+    co_return sum;
+}
+
+static lsm::co::Task<int> nested(int depth)
+{
+    if(depth == 0) co_return 0;
+    co_return 1 + co_await nested(depth - 1);
+}
+
+template <class T>
+static T run(lsm::co::Task<T>& task)
+{
+    while(!task.await_ready())
+    {
+        task.await_suspend(std::noop_coroutine()).resume();
+    }
+    return task.await_resume();
+}
+
+static void test_sequential_awaits()
+{
+    auto task = sequential(1000000);
+    const int result = run(task);
+    assert(result == 1000000);
+}
+
+static void test_nested_awaits()
+{
+    auto task = nested(100000);
+    const int result = run(task);
+    assert(result == 100000);
+}
+
+static void test_long_fragment_chain()
+{
+    Machine::Builder builder;
+    builder.set_initial(State::Idle);
+    builder.on<Go>(State::Idle, State::Done);
+    Machine machine = std::move(builder).build({});
+    lsm::co::Adapter<Machine> adapter(machine);
+
+    constexpr int fragments = 20000;
+    auto stage = adapter.from(State::Idle).on<Go>().to(State::Done);
+    for(int i = 0; i < fragments; ++i)
+    {
+        stage.then([](const Input&, Context& ctx, lsm::co::CancelToken, auto&) -> lsm::co::Task<std::optional<Output>> {
+            co_return ++ctx.steps;
+        });
+    }
+    stage.retry(2, [](int, const Input&, Context&, lsm::co::CancelToken, auto&) -> lsm::co::Task<void> { co_return; });
+    stage.attach();
+
+    auto task = adapter.dispatch_async(Input{Go{}});
+    auto out = run(task);
+    assert(out && *out == fragments);
+    assert(machine.state() == State::Done);
+}
+
+int main()
+{
+    test_sequential_awaits();
+    test_nested_awaits();
+    test_long_fragment_chain();
+    return 0;
+}
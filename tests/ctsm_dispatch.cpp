@@ -0,0 +1,198 @@
+#include <cassert>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+#include <lsm/ctsm.hpp>
+
+enum class S { Idle, Armed, Firing, Cooldown, Done };
+
+struct Arm {};
+struct Fire
+{
+    int power{};
+};
+struct Abort {};
+struct Job
+{
+    int id{};
+};
+
+using Input = std::variant<Arm, Fire, Abort, Job>;
+using Output = std::string;
+
+struct Ctx
+{
+    std::vector<std::string> log;
+    int threshold = 5;
+    bool ready = false;
+};
+
+struct LogEnter
+{
+    void operator()(Ctx& ctx, const S&, const S&, const Input*) const { ctx.log.push_back("enter-armed"); }
+};
+struct LogExit
+{
+    void operator()(Ctx& ctx, const S&, const S&, const Input*) const { ctx.log.push_back("exit-armed"); }
+};
+struct Strong
+{
+    bool operator()(const Fire& f, const Ctx& ctx) const { return f.power >= ctx.threshold; }
+};
+struct FireHigh
+{
+    std::optional<Output> operator()(const Fire&, Ctx&) const { return Output{"high"}; }
+};
+struct FireLow
+{
+    std::optional<Output> operator()(const Fire&, Ctx&) const { return Output{"low"}; }
+};
+struct Cooled
+{
+    std::optional<Output> operator()(Ctx&) const { return Output{"cooled"}; }
+};
+struct Unhandled
+{
+    void operator()(Ctx& ctx, const S&, const Input&) const { ctx.log.push_back("unhandled"); }
+};
+
+using Table = lsm::ct::table<
+    lsm::ct::transition<S::Idle, Arm, S::Armed>,
+    lsm::ct::transition<S::Armed, Fire, S::Firing>::action<FireLow>,
+    lsm::ct::transition<S::Armed, Fire, S::Firing>::action<FireHigh>::guard<Strong>::priority<5>,
+    lsm::ct::completion<S::Firing, S::Cooldown>,
+    lsm::ct::completion<S::Cooldown, S::Idle>::action<Cooled>,
+    lsm::ct::any_transition<Abort, S::Done>::action<lsm::ct::fn<[](const Abort&, Ctx&) -> std::optional<Output> { return Output{"abort"}; }>>,
+    lsm::ct::on_enter<S::Armed, LogEnter>,
+    lsm::ct::on_exit<S::Armed, LogExit>,
+    lsm::ct::any_unhandled<Unhandled>>;
+
+using Machine = lsm::ct::Machine<S, Input, Output, Ctx, Table>;
+
+static void test_priority_completion_and_any()
+{
+    Machine machine(S::Idle);
+    const auto ignored = machine.dispatch(Input{Fire{9}});
+    assert(!ignored);
+    assert(machine.context().log.back() == "unhandled");
+
+    machine.dispatch(Input{Arm{}});
+    assert(machine.state() == S::Armed);
+
+    auto out = machine.dispatch(Input{Fire{9}});
+    assert(out && *out == "high");
+    assert(machine.state() == S::Idle);
+
+    machine.dispatch(Input{Arm{}});
+    out = machine.dispatch(Input{Fire{1}});
+    assert(out && *out == "low");
+
+    assert((machine.context().log == std::vector<std::string>{"unhandled", "enter-armed", "exit-armed", "enter-armed", "exit-armed"}));
+
+    out = machine.dispatch(Input{Abort{}});
+    assert(out && *out == "abort");
+    assert(machine.state() == S::Done);
+}
+
+struct Record
+{
+    std::optional<Output> operator()(const Job& job, Ctx& ctx) const
+    {
+        ctx.log.push_back("job-" + std::to_string(job.id));
+        return Output{"ran"};
+    }
+};
+struct IsReady
+{
+    bool operator()(const Ctx& ctx) const { return ctx.ready; }
+};
+
+using DeferTable = lsm::ct::table<
+    lsm::ct::transition<S::Idle, Job, S::Armed>::defer,
+    lsm::ct::transition<S::Armed, Job, S::Firing>::action<Record>,
+    lsm::ct::transition<S::Firing, Job, S::Firing>::action<Record>::suppress_enter_exit,
+    lsm::ct::completion<S::Firing, S::Done>::guard<IsReady>>;
+
+using DeferMachine = lsm::ct::Machine<S, Input, Output, Ctx, DeferTable>;
+
+static void test_deferral_replays_on_enter()
+{
+    DeferMachine machine(S::Idle);
+    auto out = machine.dispatch(Input{Job{1}});
+    assert(!out);
+    assert(machine.state() == S::Firing);
+    assert((machine.context().log == std::vector<std::string>{"job-1"}));
+
+    out = machine.dispatch(Input{Job{2}});
+    assert(out && *out == "ran");
+    assert(machine.state() == S::Firing);
+
+    machine.context().ready = true;
+    machine.enqueue(Input{Job{3}});
+    auto outputs = machine.dispatch_all();
+    assert(outputs.size() == 1 && outputs[0] == "ran");
+    assert(machine.state() == S::Done);
+}
+
+using Pub = lsm::publisher::Queue<std::vector<int>>;
+
+struct Publish
+{
+    void operator()(const Fire& f, Ctx&, Pub& pub) const { pub.publish(f.power); }
+};
+
+using PubTable = lsm::ct::table<lsm::ct::transition<S::Idle, Fire, S::Idle>::action<Publish>>;
+using PubMachine = lsm::ct::Machine<S, Input, Output, Ctx, PubTable, lsm::policy::Publisher<Pub>>;
+
+static void test_publisher_policy()
+{
+    std::vector<int> sink;
+    PubMachine machine(S::Idle, {}, Pub{sink});
+    machine.dispatch(Input{Fire{3}});
+    machine.dispatch(Input{Fire{4}});
+    assert((sink == std::vector<int>{3, 4}));
+}
+
+struct ArmedUnhandled
+{
+    void operator()(Ctx& ctx, const S&, const Input&) const { ctx.log.push_back("armed-unhandled"); }
+};
+
+using UnhandledTable = lsm::ct::table<
+    lsm::ct::transition<S::Idle, Arm, S::Armed>,
+    lsm::ct::on_unhandled<S::Armed, ArmedUnhandled>,
+    lsm::ct::any_unhandled<Unhandled>>;
+
+using UnhandledMachine = lsm::ct::Machine<S, Input, Output, Ctx, UnhandledTable>;
+
+static void test_state_unhandled_precedence_matches_runtime()
+{
+    lsm::Machine<S, Input, Output, Ctx>::Builder builder;
+    builder.set_initial(S::Idle);
+    builder.on<Arm>(S::Idle, S::Armed);
+    builder.on_unhandled(S::Armed, ArmedUnhandled{});
+    builder.on_unhandled(Unhandled{});
+    auto runtime = std::move(builder).build({});
+    UnhandledMachine machine(S::Idle);
+
+    const Input inputs[] = {Input{Fire{1}}, Input{Arm{}}, Input{Fire{1}}, Input{Abort{}}};
+    for(const auto& in : inputs)
+    {
+        runtime.dispatch(in);
+        machine.dispatch(in);
+    }
+    assert((machine.context().log == std::vector<std::string>{"unhandled", "armed-unhandled", "armed-unhandled"}));
+    assert(machine.context().log == runtime.context().log);
+}
+
+int main()
+{
+    test_priority_completion_and_any();
+    test_deferral_replays_on_enter();
+    test_publisher_policy();
+    test_state_unhandled_precedence_matches_runtime();
+    return 0;
+}
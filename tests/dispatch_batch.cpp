@@ -0,0 +1,81 @@
+#include <cassert>
+#include <optional>
+#include <span>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+
+enum class S { Idle, Busy, Done, Reset };
+struct Work { int n; };
+struct Finish {};
+struct Abort {};
+struct Noise {};
+using Input = std::variant<Work, Finish, Abort, Noise>;
+
+struct Ctx {
+    int total = 0;
+    int unhandled = 0;
+    int entered_done = 0;
+};
+
+using M = lsm::Machine<S, Input, int, Ctx>;
+
+// `settle` adds a completion and deferral so the batch path has to finalize
+// every transition; without it the fast path is taken.
+M make(bool settle) {
+    M::Builder builder;
+    builder.set_initial(S::Idle);
+    builder.enable_deferral(settle);
+    builder.on<Work>(S::Idle, S::Busy, [](const Work& w, Ctx& ctx) -> std::optional<int> {
+        ctx.total += w.n;
+        return ctx.total;
+    });
+    builder.on<Work>(S::Busy, S::Busy, [](const Work& w, Ctx& ctx) -> std::optional<int> {
+        ctx.total += w.n;
+        return std::nullopt;
+    }, [](const Input&, const Ctx& ctx) { return ctx.total < 10; }, 0, true);
+    builder.on<Work>(S::Busy, S::Done, lsm::create_action<Input, Ctx>(), nullptr, 0, false, settle);
+    builder.on<Finish>(S::Busy, S::Done, [](const Finish&, Ctx&) -> std::optional<int> { return -1; });
+    builder.on_enter(S::Done, [](Ctx& ctx, const S&, const S&, const Input*) { ++ctx.entered_done; });
+    builder.on<Work>(S::Done, S::Idle);
+    builder.on_any<Abort>(S::Reset);
+    if (settle) builder.on_completion(S::Reset, S::Idle, [](Ctx&) -> std::optional<int> { return 0; });
+    builder.on_unhandled([](Ctx& ctx, const S&, const Input&) { ++ctx.unhandled; });
+    return std::move(builder).build({});
+}
+
+void matches_loop(bool settle) {
+    const std::vector<Input> inputs{
+        Work{3}, Work{4}, Noise{}, Work{5}, Work{1}, Work{2}, Abort{}, Finish{},
+        Work{7}, Finish{}, Work{1}, Abort{}, Work{2}, Noise{}, Work{9}, Work{9},
+    };
+
+    auto looped = make(settle);
+    std::vector<int> expected;
+    for (const auto& in : inputs) {
+        if (auto out = looped.dispatch(in)) expected.push_back(*out);
+    }
+
+    auto batched = make(settle);
+    std::vector<int> outputs;
+    const auto consumed = batched.dispatch_batch(std::span<const Input>(inputs), [&](int&& out) { outputs.push_back(out); });
+
+    assert(consumed == inputs.size());
+    assert(outputs == expected);
+    assert(batched.state() == looped.state());
+    assert(batched.context().total == looped.context().total);
+    assert(batched.context().unhandled == looped.context().unhandled);
+    assert(batched.context().entered_done == looped.context().entered_done);
+}
+
+int main() {
+    matches_loop(false);
+    matches_loop(true);
+
+    auto machine = make(false);
+    const auto consumed = machine.dispatch_batch(std::span<const Input>{}, [](int&&) {});
+    assert(consumed == 0);
+    assert(machine.state() == S::Idle);
+    return 0;
+}
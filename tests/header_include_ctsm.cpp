@@ -0,0 +1,5 @@
+#include <lsm/ctsm.hpp>
+
+int main() {
+    return 0;
+}
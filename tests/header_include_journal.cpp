@@ -0,0 +1,5 @@
+#include <lsm/journal.hpp>
+
+int main() {
+    return 0;
+}
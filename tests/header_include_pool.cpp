@@ -0,0 +1,5 @@
+#include <lsm/pool.hpp>
+
+int main() {
+    return 0;
+}
@@ -0,0 +1,5 @@
+#include <lsm/runtime.hpp>
+
+int main() {
+    return 0;
+}
@@ -0,0 +1,5 @@
+#include <lsm/trace.hpp>
+
+int main() {
+    return 0;
+}
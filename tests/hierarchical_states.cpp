@@ -0,0 +1,203 @@
+#include <cassert>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+#include <lsm/pool.hpp>
+
+// Online contains Connected, which contains Idle and Busy. Offline and Fault
+// sit at the top level.
+enum class S { Online, Connected, Idle, Busy, Offline, Fault };
+struct Work {};
+struct Done {};
+struct Drop {};
+struct Ping {};
+struct Crash {};
+struct Boot {};
+using Input = std::variant<Work, Done, Drop, Ping, Crash, Boot>;
+
+struct Ctx {
+    std::vector<std::string> log;
+    int pings = 0;
+    bool sticky = false;
+};
+
+using M = lsm::Machine<S, Input, int, Ctx>;
+
+const char* name(S s) {
+    switch (s) {
+    case S::Online: return "Online";
+    case S::Connected: return "Connected";
+    case S::Idle: return "Idle";
+    case S::Busy: return "Busy";
+    case S::Offline: return "Offline";
+    case S::Fault: return "Fault";
+    }
+    return "?";
+}
+
+std::shared_ptr<const M::Definition> make_definition() {
+    M::Builder builder;
+    builder.set_initial(S::Idle);
+    builder.set_parent(S::Connected, S::Online);
+    builder.set_parent(S::Idle, S::Connected);
+    builder.set_parent(S::Busy, S::Connected);
+    for (auto s : {S::Online, S::Connected, S::Idle, S::Busy, S::Offline, S::Fault}) {
+        builder.on_enter(s, [s](Ctx& ctx, const S&, const S&, const Input*) { ctx.log.push_back(std::string("+") + name(s)); });
+        builder.on_exit(s, [s](Ctx& ctx, const S&, const S&, const Input*) { ctx.log.push_back(std::string("-") + name(s)); });
+    }
+    builder.on<Work>(S::Idle, S::Busy);
+    builder.on<Done>(S::Busy, S::Idle, [](const Done&, Ctx&) -> std::optional<int> { return 1; });
+    // Busy refuses to drop while sticky; otherwise Connected's Drop applies.
+    builder.on<Drop>(S::Busy, S::Busy, lsm::create_action<Input, Ctx>(),
+                     [](const Input&, const Ctx& ctx) { return ctx.sticky; }, 0, true);
+    builder.on<Drop>(S::Connected, S::Offline);
+    builder.on<Ping>(S::Online, S::Online, [](const Ping&, Ctx& ctx) -> std::optional<int> {
+        return ++ctx.pings;
+    }, nullptr, 0, true);
+    builder.on<Work>(S::Connected, S::Connected);
+    builder.on<Boot>(S::Offline, S::Busy);
+    builder.on_any<Crash>(S::Fault);
+    builder.on_completion(S::Fault, S::Idle);
+    return std::move(builder).build_definition();
+}
+
+using Log = std::vector<std::string>;
+
+void hooks_follow_the_hierarchy() {
+    M m(make_definition());
+    assert(m.state() == S::Idle);
+    assert((m.context().log == Log{"+Online", "+Connected", "+Idle"}));
+
+    m.context().log.clear();
+    m.dispatch(Input{Work{}});
+    assert(m.state() == S::Busy);
+    assert((m.context().log == Log{"-Idle", "+Busy"}));
+
+    // Inherited internal transition: the action runs, the state is kept.
+    m.context().log.clear();
+    const auto pinged = m.dispatch(Input{Ping{}});
+    assert(pinged == 1);
+    assert(m.state() == S::Busy && m.context().log.empty());
+
+    // Own transition first; when its guard fails, Connected's applies.
+    m.context().sticky = true;
+    m.dispatch(Input{Drop{}});
+    assert(m.state() == S::Busy && m.context().log.empty());
+    m.context().sticky = false;
+    m.dispatch(Input{Drop{}});
+    assert(m.state() == S::Offline);
+    assert((m.context().log == Log{"-Busy", "-Connected", "-Online", "+Offline"}));
+
+    // Entering a nested state enters every ancestor, outermost first.
+    m.context().log.clear();
+    m.dispatch(Input{Boot{}});
+    assert(m.state() == S::Busy);
+    assert((m.context().log == Log{"-Offline", "+Online", "+Connected", "+Busy"}));
+
+    // Ping is not inherited outside Online.
+    m.dispatch(Input{Drop{}});
+    const auto ignored = m.dispatch(Input{Ping{}});
+    assert(!ignored && m.context().pings == 1);
+}
+
+void external_self_transition_and_any_state() {
+    M m(make_definition());
+    m.dispatch(Input{Work{}});
+
+    // Busy inherits Connected -> Connected, which leaves and re-enters Connected.
+    m.context().log.clear();
+    m.dispatch(Input{Work{}});
+    assert(m.state() == S::Connected);
+    assert((m.context().log == Log{"-Busy", "-Connected", "+Connected"}));
+
+    // Any-state transitions leave the whole hierarchy; the completion comes back.
+    m.context().log.clear();
+    m.dispatch(Input{Crash{}});
+    assert(m.state() == S::Idle);
+    assert((m.context().log == Log{"-Connected", "-Online", "+Fault", "-Fault", "+Online", "+Connected", "+Idle"}));
+}
+
+void inherited_transitions_are_not_copied() {
+    const auto def = make_definition();
+    assert(def->hierarchical());
+    assert(def->transitions.size() == 8);
+    const auto busy = def->index.find(S::Busy);
+    const auto drop = def->route(busy, 2);
+    assert(drop.end - drop.begin == 2);
+    assert(def->transitions[def->routes[drop.begin]].from == S::Busy);
+    assert(def->transitions[def->routes[drop.begin + 1]].from == S::Connected);
+}
+
+void pool_matches_machines() {
+    M::Builder builder;
+    builder.set_initial(S::Idle);
+    builder.set_parent(S::Idle, S::Connected);
+    builder.set_parent(S::Busy, S::Connected);
+    builder.on<Work>(S::Idle, S::Busy);
+    builder.on<Done>(S::Busy, S::Idle);
+    builder.on<Drop>(S::Connected, S::Offline);
+    builder.on<Boot>(S::Offline, S::Idle);
+    builder.on<Ping>(S::Connected, S::Connected, [](const Ping&, Ctx& ctx) -> std::optional<int> {
+        return ++ctx.pings;
+    }, nullptr, 0, true);
+    builder.on_enter(S::Connected, [](Ctx& ctx, const S&, const S&, const Input*) { ctx.log.push_back("+Connected"); });
+    const auto def = std::move(builder).build_definition();
+
+    lsm::MachinePool<M> pool(def);
+    std::vector<M> machines;
+    for (int i = 0; i < 6; ++i) {
+        pool.add();
+        machines.emplace_back(def);
+    }
+    const std::vector<Input> script{Work{}, Ping{}, Drop{}, Boot{}, Work{}, Done{}, Drop{}, Ping{}, Boot{}};
+    for (std::size_t step = 0; step < script.size(); ++step) {
+        pool.dispatch(step % machines.size(), Input{Work{}});
+        machines[step % machines.size()].dispatch(Input{Work{}});
+        pool.broadcast(script[step]);
+        for (auto& m : machines) m.dispatch(script[step]);
+        for (std::size_t i = 0; i < machines.size(); ++i) {
+            assert(pool.state(i) == machines[i].state());
+            assert(pool.context(i).pings == machines[i].context().pings);
+            assert(pool.context(i).log == machines[i].context().log);
+        }
+    }
+}
+
+bool builds(M::Builder builder) {
+    try {
+        std::move(builder).build_definition();
+        return true;
+    } catch (const std::invalid_argument&) {
+        return false;
+    }
+}
+
+void parent_cycles_are_rejected() {
+    M::Builder self;
+    self.set_initial(S::Idle);
+    self.set_parent(S::Idle, S::Idle);
+    const bool self_built = builds(std::move(self));
+    assert(!self_built);
+
+    M::Builder loop;
+    loop.set_initial(S::Idle);
+    loop.set_parent(S::Idle, S::Connected);
+    loop.set_parent(S::Connected, S::Online);
+    loop.set_parent(S::Online, S::Idle);
+    loop.on<Work>(S::Offline, S::Busy);
+    const bool loop_built = builds(std::move(loop));
+    assert(!loop_built);
+}
+
+int main() {
+    hooks_follow_the_hierarchy();
+    external_self_transition_and_any_state();
+    inherited_transitions_are_not_copied();
+    pool_matches_machines();
+    parent_cycles_are_rejected();
+    return 0;
+}
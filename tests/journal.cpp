@@ -0,0 +1,180 @@
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+#include <lsm/journal.hpp>
+
+enum class S { Idle, Open, Closed };
+struct Deposit { int amount; };
+struct Close {};
+struct Reopen {};
+using Input = std::variant<Deposit, Close, Reopen>;
+
+struct Ctx {
+    int balance = 0;
+    int opened = 0;
+    int unhandled = 0;
+};
+
+using M = lsm::Machine<S, Input, int, Ctx>;
+
+std::shared_ptr<const M::Definition> make_definition() {
+    M::Builder builder;
+    builder.set_initial(S::Idle);
+    builder.on_enter(S::Open, [](Ctx& ctx, const S&, const S&, const Input*) { ++ctx.opened; });
+    builder.on<Deposit>(S::Idle, S::Open, [](const Deposit& d, Ctx& ctx) -> std::optional<int> {
+        ctx.balance += d.amount;
+        return ctx.balance;
+    });
+    builder.on<Deposit>(S::Open, S::Open, [](const Deposit& d, Ctx& ctx) -> std::optional<int> {
+        ctx.balance += d.amount;
+        return ctx.balance;
+    }, nullptr, 0, true);
+    builder.on<Close>(S::Open, S::Closed);
+    builder.on<Reopen>(S::Closed, S::Open);
+    builder.on_unhandled([](Ctx& ctx, const S&, const Input&) { ++ctx.unhandled; });
+    return std::move(builder).build_definition();
+}
+
+bool same(const M& a, const M& b) {
+    return a.state() == b.state() && a.context().balance == b.context().balance &&
+           a.context().opened == b.context().opened && a.context().unhandled == b.context().unhandled;
+}
+
+void checkpoint_and_replay() {
+    const auto def = make_definition();
+    M live(def);
+    lsm::journal::MemoryLog log;
+    lsm::journal::Journal journal(live, log);
+
+    const auto first = journal.dispatch(Input{Deposit{10}});
+    assert(first == 10);
+    journal.dispatch(Input{Reopen{}}); // unhandled, but its hook counts it
+    assert(live.context().unhandled == 1);
+    assert(journal.sequence() == 2);
+
+    const auto blob = live.snapshot();
+    const auto checkpoint = journal.sequence();
+
+    journal.dispatch(Input{Deposit{5}});
+    journal.dispatch(Input{Close{}});
+    journal.dispatch(Input{Close{}}); // unhandled
+    journal.dispatch(Input{Reopen{}});
+    journal.dispatch(Input{Deposit{1}});
+    assert(journal.sequence() == 7);
+
+    M recovered(def);
+    const bool restored = recovered.restore(blob);
+    assert(restored);
+    const auto result = lsm::journal::replay(recovered, log.contents(), checkpoint);
+    assert(result.complete && result.applied == 5 && result.next_sequence == 7);
+    assert(same(recovered, live));
+    assert(recovered.context().balance == 16 && recovered.context().opened == 2);
+    assert(recovered.context().unhandled == 2);
+
+    // Replay from scratch reaches the same place.
+    M rebuilt(def);
+    const auto full = lsm::journal::replay(rebuilt, log.contents());
+    assert(full.applied == 7);
+    assert(same(rebuilt, live));
+}
+
+void batch_is_journaled() {
+    const auto def = make_definition();
+    M live(def);
+    lsm::journal::MemoryLog log;
+    lsm::journal::Journal journal(live, log);
+
+    const std::vector<Input> batch{Deposit{4}, Close{}, Close{}, Reopen{}, Deposit{2}};
+    std::vector<int> outputs;
+    const auto consumed = journal.dispatch_batch(batch, [&](int&& out) { outputs.push_back(out); });
+    assert(consumed == batch.size());
+    assert((outputs == std::vector<int>{4, 6}));
+    assert(journal.sequence() == batch.size());
+
+    M rebuilt(def);
+    const auto result = lsm::journal::replay(rebuilt, log.contents());
+    assert(result.complete && result.applied == batch.size());
+    assert(same(rebuilt, live));
+}
+
+void torn_tail() {
+    const auto def = make_definition();
+    M live(def);
+    lsm::journal::MemoryLog log;
+    lsm::journal::Journal journal(live, log);
+    journal.dispatch(Input{Deposit{1}});
+    journal.dispatch(Input{Deposit{2}});
+    journal.dispatch(Input{Deposit{4}});
+
+    // Lose the last byte of the last entry, then corrupt the second.
+    std::vector<std::byte> image(log.contents().begin(), log.contents().end() - 1);
+    M partial(def);
+    auto result = lsm::journal::replay(partial, image);
+    assert(result.applied == 2 && result.next_sequence == 2);
+    assert(partial.context().balance == 3);
+
+    lsm::journal::Reader reader(image);
+    const bool first = reader.next().has_value();
+    const bool second = reader.next().has_value();
+    const bool third = reader.next().has_value();
+    assert(first && second && !third);
+    image[reader.position() - 1] ^= std::byte{0xFF};
+    M corrupt(def);
+    const auto prefix = lsm::journal::replay(corrupt, image);
+    assert(prefix.applied == 1);
+    assert(corrupt.context().balance == 1);
+}
+
+#ifdef LSM_JOURNAL_FILE_LOG
+void file_log() {
+    const std::string path = "journal_test.lsmj";
+    std::remove(path.c_str());
+    const auto def = make_definition();
+    M live(def);
+    {
+        lsm::journal::FileLog log(path, {.sync_every = 2, .initial_size = 64});
+        lsm::journal::Journal journal(live, log);
+        for (int i = 1; i <= 20; ++i) journal.dispatch(Input{Deposit{i}});
+        journal.dispatch(Input{Close{}});
+    }
+    M recovered(def);
+    {
+        lsm::journal::FileLog log(path);
+        assert(log.next_sequence() == 21);
+        const auto result = lsm::journal::replay(recovered, log.contents());
+        assert(result.applied == 21);
+        assert(same(recovered, live));
+
+        // Appending continues after the existing entries.
+        lsm::journal::Journal journal(recovered, log, log.next_sequence());
+        journal.dispatch(Input{Reopen{}});
+        journal.sync();
+    }
+    {
+        lsm::journal::FileLog log(path);
+        assert(log.next_sequence() == 22);
+        M again(def);
+        lsm::journal::replay(again, log.contents());
+        assert(same(again, recovered) && again.state() == S::Open);
+    }
+    std::remove(path.c_str());
+}
+#endif
+
+int main() {
+    checkpoint_and_replay();
+    batch_is_journaled();
+    torn_tail();
+#ifdef LSM_JOURNAL_FILE_LOG
+    file_log();
+#endif
+    return 0;
+}
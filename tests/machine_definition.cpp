@@ -0,0 +1,155 @@
+#include <cassert>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+
+enum class S { Idle, Busy, Done };
+
+struct Start {};
+struct Finish {};
+struct Ping {};
+
+using Input = std::variant<Start, Finish, Ping>;
+using Output = std::string;
+
+struct Ctx
+{
+    int id = 0;
+    int enters = 0;
+    int unhandled = 0;
+};
+
+using M = lsm::Machine<S, Input, Output, Ctx>;
+
+static std::shared_ptr<const M::Definition> make_definition()
+{
+    M::Builder builder;
+    builder.set_initial(S::Idle)
+        .enable_deferral(true)
+        .on_enter(S::Busy, [](Ctx& ctx, const S&, const S&, const Input*) { ++ctx.enters; })
+        .on_unhandled([](Ctx& ctx, const S&, const Input&) { ++ctx.unhandled; });
+    builder.on<Start>(S::Idle, S::Busy, [](const Start&, Ctx& ctx) -> std::optional<Output> {
+        return "start-" + std::to_string(ctx.id);
+    });
+    builder.from(S::Idle).on<Finish>().defer(true).to(S::Busy);
+    builder.on<Finish>(S::Busy, S::Done, [](const Finish&, Ctx& ctx) -> std::optional<Output> {
+        return "finish-" + std::to_string(ctx.id);
+    });
+    return std::move(builder).build_definition();
+}
+
+static void test_instances_share_tables()
+{
+    const auto def = make_definition();
+    std::vector<M::Instance> sessions;
+    for(int i = 0; i < 64; ++i)
+    {
+        sessions.emplace_back(def, Ctx{i});
+    }
+    assert(def.use_count() == 65);
+
+    for(auto& session : sessions)
+    {
+        assert(session.definition() == def);
+        assert(&session.transitions_table() == &def->transitions);
+        assert(session.state() == S::Idle);
+    }
+
+    auto out = sessions[3].dispatch(Input{Start{}});
+    assert(out && *out == "start-3");
+    assert(sessions[3].state() == S::Busy);
+    assert(sessions[3].context().enters == 1);
+    assert(sessions[4].state() == S::Idle);
+    assert(sessions[4].context().enters == 0);
+
+    sessions[4].dispatch(Input{Ping{}});
+    assert(sessions[4].context().unhandled == 1);
+    assert(sessions[3].context().unhandled == 0);
+}
+
+static void test_deferral_state_is_per_instance()
+{
+    const auto def = make_definition();
+    M::Instance a(def, Ctx{1});
+    M::Instance b(def, Ctx{2});
+
+    a.dispatch(Input{Finish{}});
+    assert(a.state() == S::Done);
+
+    assert(b.state() == S::Idle);
+    auto out = b.dispatch(Input{Start{}});
+    assert(out && *out == "start-2");
+    assert(b.state() == S::Busy);
+}
+
+static void test_build_still_produces_instance()
+{
+    M::Builder builder;
+    builder.set_initial(S::Idle);
+    builder.on<Start>(S::Idle, S::Done);
+    auto machine = std::move(builder).build({});
+    assert(machine.definition() && machine.definition().use_count() == 1);
+
+    M copy(machine.definition(), Ctx{});
+    machine.dispatch(Input{Start{}});
+    assert(machine.state() == S::Done);
+    assert(copy.state() == S::Idle);
+}
+
+static bool definition_rejected(M::Builder builder)
+{
+    try
+    {
+        (void)std::move(builder).build_definition();
+    }
+    catch(const std::invalid_argument&)
+    {
+        return true;
+    }
+    return false;
+}
+
+static void test_mutable_callables_only_rejected_when_shared()
+{
+    int calls = 0;
+    M::Builder single;
+    single.set_initial(S::Idle)
+        .on_enter(S::Busy, [&calls, n = 0](Ctx&, const S&, const S&, const Input*) mutable { calls = ++n; });
+    single.on<Start>(S::Idle, S::Busy);
+    auto machine = std::move(single).build({});
+    machine.dispatch(Input{Start{}});
+    assert(calls == 1);
+
+    M::Builder hook;
+    hook.set_initial(S::Idle).on_unhandled([n = 0](Ctx&, const S&, const Input&) mutable { ++n; });
+    assert(definition_rejected(std::move(hook)));
+
+    M::Builder guard;
+    guard.set_initial(S::Idle);
+    guard.from(S::Idle).on<Start>().guard([n = 0](const Input&, const Ctx&) mutable { return ++n > 1; }).to(S::Busy);
+    assert(definition_rejected(std::move(guard)));
+
+    M::Builder action;
+    action.set_initial(S::Idle);
+    action.on<Start>(S::Idle, S::Busy, [n = 0](const Start&, Ctx&) mutable -> std::optional<Output> {
+        return std::to_string(++n);
+    });
+    assert(definition_rejected(std::move(action)));
+
+    M::Builder shared;
+    shared.set_initial(S::Idle).on_enter(S::Busy, [&calls](Ctx&, const S&, const S&, const Input*) { ++calls; });
+    assert(!definition_rejected(std::move(shared)));
+}
+
+int main()
+{
+    test_instances_share_tables();
+    test_deferral_state_is_per_instance();
+    test_build_still_produces_instance();
+    test_mutable_callables_only_rejected_when_shared();
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+
+enum class State { Idle, Active };
+struct Start
+{
+    int value{};
+};
+struct Reset
+{
+};
+
+using Input = std::variant<Start, Reset>;
+using Output = int;
+
+struct Context
+{
+};
+
+using Machine = lsm::Machine<State, Input, Output, Context>;
+
+static Machine make_machine()
+{
+    Machine::Builder builder;
+    builder.set_initial(State::Idle);
+    builder.on<Start>(State::Idle, State::Active,
+                      [](const Start& start, Context&) -> std::optional<Output> { return start.value; });
+    builder.on<Reset>(State::Active, State::Idle);
+    return std::move(builder).build({});
+}
+
+static void fill(Machine& machine, int cycles)
+{
+    for(int i = 0; i < cycles; ++i)
+    {
+        machine.enqueue(Input{Start{i}});
+        machine.enqueue(Input{Reset{}});
+    }
+}
+
+static void test_sink_callable()
+{
+    auto machine = make_machine();
+    fill(machine, 3);
+
+    std::vector<Output> outputs;
+    outputs.reserve(8);
+    const auto consumed = machine.dispatch_all([&](Output&& out) { outputs.push_back(out); });
+    assert(consumed == 6);
+    assert((outputs == std::vector<Output>{0, 1, 2}));
+    assert(machine.pending() == 0);
+
+    const auto drained = machine.dispatch_all([&](Output&&) { assert(false); });
+    assert(drained == 0);
+}
+
+static void test_output_iterator()
+{
+    auto machine = make_machine();
+    fill(machine, 2);
+
+    std::vector<Output> outputs;
+    machine.dispatch_all(std::back_inserter(outputs));
+    assert((outputs == std::vector<Output>{0, 1}));
+
+    fill(machine, 2);
+    std::array<Output, 4> buffer{};
+    auto end = machine.dispatch_all(buffer.begin());
+    assert(end == buffer.begin() + 2);
+    assert(buffer[0] == 0 && buffer[1] == 1);
+}
+
+static void test_span_stops_when_full()
+{
+    auto machine = make_machine();
+    fill(machine, 3);
+
+    std::array<Output, 2> buffer{};
+    auto written = machine.dispatch_all(std::span<Output>(buffer));
+    assert(written == 2);
+    assert(buffer[0] == 0 && buffer[1] == 1);
+    assert(machine.pending() == 3);
+    assert(machine.state() == State::Active);
+
+    written = machine.dispatch_all(std::span<Output>(buffer));
+    assert(written == 1);
+    assert(buffer[0] == 2);
+    assert(machine.pending() == 0);
+}
+
+static void test_bounded_drain()
+{
+    auto machine = make_machine();
+    fill(machine, 4);
+
+    std::vector<Output> outputs;
+    auto sink = [&](Output&& out) { outputs.push_back(out); };
+
+    auto consumed = machine.dispatch_all(sink, lsm::DrainLimit{3});
+    assert(consumed == 3);
+    assert(machine.pending() == 5);
+    assert((outputs == std::vector<Output>{0, 1}));
+
+    // An exhausted budget still makes progress on one input per call.
+    consumed = machine.dispatch_all(sink, lsm::DrainLimit{.budget = std::chrono::nanoseconds{0}});
+    assert(consumed == 1);
+    assert(machine.pending() == 4);
+
+    // So does a zero input count.
+    consumed = machine.dispatch_all(sink, lsm::DrainLimit{0});
+    assert(consumed == 1);
+    assert(machine.pending() == 3);
+
+    consumed = machine.dispatch_all(sink, lsm::DrainLimit{.budget = std::chrono::seconds{10}});
+    assert(consumed == 3);
+    assert((outputs == std::vector<Output>{0, 1, 2, 3}));
+}
+
+int main()
+{
+    test_sink_callable();
+    test_output_iterator();
+    test_span_stops_when_full();
+    test_bounded_drain();
+    return 0;
+}
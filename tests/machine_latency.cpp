@@ -0,0 +1,138 @@
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <variant>
+
+#include <lsm/core.hpp>
+
+using namespace std::chrono_literals;
+
+struct FakeClock
+{
+    using duration = std::chrono::nanoseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<FakeClock>;
+    static constexpr bool is_steady = true;
+
+    static inline time_point current{};
+    static time_point now() noexcept
+    {
+        return current;
+    }
+};
+
+enum class S { Idle, Busy, Done };
+struct Go {};
+struct Stop {};
+using Input = std::variant<Go, Stop>;
+using Output = int;
+struct Ctx
+{
+};
+
+using Timed = lsm::Machine<S, Input, Output, Ctx, lsm::policy::copy, lsm::policy::ReturnOutput<Output>,
+                           lsm::policy::deque_queue, lsm::policy::basic_metrics<FakeClock, true>>;
+using Counted = lsm::Machine<S, Input, Output, Ctx, lsm::policy::copy, lsm::policy::ReturnOutput<Output>,
+                             lsm::policy::deque_queue, lsm::policy::metrics>;
+
+static_assert(Timed::Metrics::timed);
+static_assert(!Counted::Metrics::timed);
+static_assert(sizeof(Counted::Metrics) < sizeof(lsm::LatencyHistogram));
+
+static void test_histogram_buckets()
+{
+    using H = lsm::LatencyHistogram;
+    for(std::uint64_t v = 0; v < 100000; v += 7)
+    {
+        const auto bucket = H::bucket_of(v);
+        const auto high = H::highest_in(bucket);
+        assert(high >= v);
+        assert(high - v <= v / 8);
+        assert(bucket == 0 || H::highest_in(bucket - 1) < v);
+    }
+    assert(H::bucket_of(~std::uint64_t{0}) == H::bucket_count - 1);
+
+    H h;
+    assert(h.count() == 0 && h.percentile(99) == 0);
+    for(std::uint64_t v = 1; v <= 1000; ++v) h.record(v);
+    assert(h.count() == 1000 && h.min() == 1 && h.max() == 1000);
+    const auto p50 = h.percentile(50);
+    assert(p50 >= 500 && p50 <= 500 + 500 / 8);
+    const auto p999 = h.percentile(99.9);
+    assert(p999 >= 999 && p999 <= 1000);
+    assert(h.percentile(100) == 1000);
+
+    H slow;
+    slow.record(std::chrono::microseconds(50));
+    h.merge(slow);
+    assert(h.count() == 1001 && h.max() == 50000 && h.min() == 1);
+    assert(h.percentile(100) == 50000);
+}
+
+static Timed make_machine()
+{
+    Timed::Builder builder;
+    builder.set_initial(S::Idle);
+    builder.on_enter(S::Busy, [](Ctx&, const S&, const S&, const Input*) { FakeClock::current += 10ns; });
+    builder.from(S::Idle)
+        .on<Go>()
+        .guard([](const Input&, const Ctx&) {
+            FakeClock::current += 100ns;
+            return true;
+        })
+        .action([](const Go&, Ctx&) -> std::optional<Output> {
+            FakeClock::current += 1000ns;
+            return 1;
+        })
+        .to(S::Busy);
+    builder.on<Stop>(S::Busy, S::Done);
+    builder.completion(S::Done)
+        .action([](Ctx&) -> std::optional<Output> {
+            FakeClock::current += 5000ns;
+            return 2;
+        })
+        .to(S::Idle);
+    return std::move(builder).build({});
+}
+
+static void test_machine_records_phases()
+{
+    auto machine = make_machine();
+    machine.dispatch(Input{Go{}});
+    const auto& latency = machine.metrics().latency();
+    assert(latency.select.count() == 1 && latency.select.max() == 100);
+    assert(latency.action.count() == 1 && latency.action.max() == 1000);
+    assert(latency.hooks.count() == 1 && latency.hooks.max() == 10);
+    assert(latency.dispatch.count() == 1 && latency.dispatch.max() == 1110);
+
+    // Entering Done runs a completion back to Idle inside the same dispatch.
+    machine.dispatch(Input{Stop{}});
+    assert(machine.state() == S::Idle);
+    assert(latency.completions.max() == 5000);
+    assert(latency.dispatch.count() == 2 && latency.dispatch.max() == 5000);
+
+    // Queued inputs are timed the same way.
+    machine.enqueue(Input{Go{}});
+    machine.dispatch_all();
+    assert(latency.dispatch.count() == 3);
+
+    lsm::LatencySnapshot fleet;
+    auto other = make_machine();
+    other.dispatch(Input{Go{}});
+    fleet.merge(machine.metrics().latency()).merge(other.metrics().latency());
+    assert(fleet.dispatch.count() == 4);
+    assert(fleet.action.count() == 3);
+    assert(fleet[lsm::detail::Phase::completions].count() == latency.completions.count() + other.metrics().latency().completions.count());
+
+    machine.reset_metrics();
+    assert(machine.metrics().latency().dispatch.count() == 0);
+}
+
+int main()
+{
+    test_histogram_buckets();
+    test_machine_records_phases();
+    return 0;
+}
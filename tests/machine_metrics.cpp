@@ -0,0 +1,149 @@
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <variant>
+
+#include <lsm/core.hpp>
+
+using namespace std::chrono_literals;
+
+struct FakeClock
+{
+    using duration = std::chrono::nanoseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<FakeClock>;
+    static constexpr bool is_steady = true;
+
+    static inline time_point current{};
+    static time_point now() noexcept
+    {
+        return current;
+    }
+};
+
+enum class S { Idle, Busy, Done };
+struct Go {};
+struct Stop {};
+using Input = std::variant<Go, Stop>;
+using Output = int;
+
+struct Ctx
+{
+    bool ready = false;
+};
+
+using Plain = lsm::Machine<S, Input, Output, Ctx>;
+using Metered = lsm::Machine<S, Input, Output, Ctx, lsm::policy::copy, lsm::policy::ReturnOutput<Output>,
+                             lsm::policy::deque_queue, lsm::policy::basic_metrics<FakeClock>>;
+
+static_assert(!Plain::Metrics::enabled);
+static_assert(std::is_empty_v<Plain::Metrics>);
+static_assert(Metered::Metrics::enabled);
+
+template <class M>
+static M make_machine()
+{
+    typename M::Builder builder;
+    builder.set_initial(S::Idle);
+    builder.from(S::Idle)
+        .template on<Go>()
+        .priority(5)
+        .guard([](const Input&, const Ctx& ctx) { return ctx.ready; })
+        .to(S::Busy);
+    builder.template on<Go>(S::Idle, S::Idle);
+    builder.template on<Stop>(S::Busy, S::Done);
+    builder.completion(S::Done).to(S::Idle);
+    return std::move(builder).build({});
+}
+
+template <class M>
+static std::size_t transition_to(const M& machine, S to)
+{
+    const auto& table = machine.transitions_table();
+    for(std::size_t i = 0; i < table.size(); ++i)
+    {
+        if(table[i].to == to) return i;
+    }
+    return table.size();
+}
+
+static void test_counts_and_dwell()
+{
+    FakeClock::current = {};
+    auto machine = make_machine<Metered>();
+    const auto& metrics = machine.metrics();
+    const auto& index = machine.state_index();
+    const auto idle = index.find(S::Idle);
+    const auto busy = index.find(S::Busy);
+    const auto done = index.find(S::Done);
+    const auto guarded = transition_to(machine, S::Busy);
+    const auto fallback = transition_to(machine, S::Idle);
+    const auto stop = transition_to(machine, S::Done);
+
+    assert(metrics.states()[idle].entries == 1);
+
+    // Guard rejects, so the lower-priority self-loop fires.
+    FakeClock::current += 5ms;
+    machine.dispatch(Input{Go{}});
+    assert(metrics.transitions()[guarded].rejected == 1);
+    assert(metrics.transitions()[guarded].fired == 0);
+    assert(metrics.transitions()[fallback].fired == 1);
+
+    machine.dispatch(Input{Stop{}});
+    assert(metrics.states()[idle].unhandled == 1);
+
+    machine.context().ready = true;
+    FakeClock::current += 5ms;
+    machine.dispatch(Input{Go{}});
+    assert(machine.state() == S::Busy);
+    assert(metrics.transitions()[guarded].fired == 1);
+    assert(metrics.states()[idle].dwell == 10ms);
+
+    FakeClock::current += 20ms;
+    assert(metrics.dwell(busy) == 20ms);
+    machine.dispatch(Input{Stop{}});
+    assert(machine.state() == S::Idle);
+    assert(metrics.transitions()[stop].fired == 1);
+    assert(metrics.completions()[0].fired == 1);
+    assert(metrics.states()[busy].dwell == 20ms);
+    assert(metrics.states()[done].entries == 1);
+    assert(metrics.states()[done].dwell == 0ms);
+    assert(metrics.states()[idle].entries == 3);
+
+    FakeClock::current += 1ms;
+    machine.reset_metrics();
+    assert(metrics.transitions()[guarded].fired == 0);
+    assert(metrics.states()[idle].entries == 0);
+    FakeClock::current += 2ms;
+    assert(metrics.dwell(idle) == 2ms);
+}
+
+static void test_select_counts_rejections()
+{
+    auto machine = make_machine<Metered>();
+    const auto guarded = transition_to(machine, S::Busy);
+    auto sel = machine.select(Input{Go{}});
+    assert(sel);
+    assert(machine.metrics().transitions()[guarded].rejected == 1);
+}
+
+static void test_disabled_machine_behaves_the_same()
+{
+    auto plain = make_machine<Plain>();
+    auto metered = make_machine<Metered>();
+    for(auto* ready : {&plain.context().ready, &metered.context().ready}) *ready = true;
+    plain.dispatch(Input{Go{}});
+    metered.dispatch(Input{Go{}});
+    assert(plain.state() == metered.state());
+}
+
+int main()
+{
+    test_counts_and_dwell();
+    test_select_counts_rejections();
+    test_disabled_machine_behaves_the_same();
+    return 0;
+}
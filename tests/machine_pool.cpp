@@ -0,0 +1,162 @@
+#include <cassert>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+#include <lsm/pool.hpp>
+
+enum class S { Off, Warm, Hot, Alarm, Cool };
+struct Tick {};
+struct Heat { int by; };
+struct Reset {};
+using Input = std::variant<Tick, Heat, Reset>;
+
+struct Ctx {
+    int heat = 0;
+    int alarms = 0;
+    int ignored = 0;
+    int entered_hot = 0;
+};
+
+using M = lsm::Machine<S, Input, int, Ctx>;
+
+// Tick is trivial from Off and Warm, runs an action from Hot, is guarded in
+// Alarm and unhandled (with a hook) in Cool. Cool completes back to Off.
+std::shared_ptr<const M::Definition> make_definition(bool enter_hook_on_initial) {
+    M::Builder builder;
+    builder.set_initial(S::Off);
+    builder.on<Tick>(S::Off, S::Warm);
+    builder.on<Tick>(S::Warm, S::Warm);
+    builder.on<Heat>(S::Warm, S::Hot, [](const Heat& h, Ctx& ctx) -> std::optional<int> {
+        ctx.heat += h.by;
+        return std::nullopt;
+    });
+    builder.on_enter(S::Hot, [](Ctx& ctx, const S&, const S&, const Input*) { ++ctx.entered_hot; });
+    builder.on<Tick>(S::Hot, S::Alarm, [](const Tick&, Ctx& ctx) -> std::optional<int> {
+        ++ctx.alarms;
+        return ctx.heat;
+    });
+    builder.on<Tick>(S::Alarm, S::Cool, lsm::create_action<Input, Ctx>(),
+                     [](const Input&, const Ctx& ctx) { return ctx.heat > 5; });
+    builder.on<Reset>(S::Alarm, S::Off);
+    builder.on_completion(S::Cool, S::Off);
+    builder.on_any<Reset>(S::Off);
+    builder.on_unhandled([](Ctx& ctx, const S&, const Input&) { ++ctx.ignored; });
+    if (enter_hook_on_initial) {
+        builder.on_enter(S::Off, [](Ctx& ctx, const S&, const S&, const Input*) { ctx.heat = 0; });
+    }
+    return std::move(builder).build_definition();
+}
+
+void matches_individual_machines(bool enter_hook_on_initial) {
+    const auto def = make_definition(enter_hook_on_initial);
+    lsm::MachinePool<M> pool(def);
+    std::vector<M> machines;
+    for (int i = 0; i < 12; ++i) {
+        pool.add(Ctx{i, 0, 0, 0});
+        machines.emplace_back(def, Ctx{i, 0, 0, 0});
+    }
+
+    const std::vector<Input> script{Tick{}, Heat{1}, Tick{}, Tick{}, Tick{}, Heat{2}, Reset{}, Tick{}, Tick{}};
+    for (std::size_t step = 0; step < script.size(); ++step) {
+        // Stagger instances so they are in different states at each broadcast.
+        for (std::size_t i = 0; i < machines.size(); ++i) {
+            if (i % 3 == step % 3) {
+                pool.dispatch(i, Input{Heat{4}});
+                machines[i].dispatch(Input{Heat{4}});
+            }
+        }
+        std::vector<int> pool_out(machines.size(), -1);
+        std::vector<int> expected(machines.size(), -1);
+        pool.broadcast(script[step], [&](std::size_t i, int&& out) { pool_out[i] = out; });
+        for (std::size_t i = 0; i < machines.size(); ++i) {
+            if (auto out = machines[i].dispatch(script[step])) expected[i] = *out;
+        }
+        assert(pool_out == expected);
+        for (std::size_t i = 0; i < machines.size(); ++i) {
+            const auto& a = pool.context(i);
+            const auto& b = machines[i].context();
+            assert(pool.state(i) == machines[i].state());
+            assert(a.heat == b.heat && a.alarms == b.alarms && a.ignored == b.ignored && a.entered_hot == b.entered_hot);
+        }
+    }
+}
+
+void trivial_broadcast() {
+    M::Builder builder;
+    builder.set_initial(S::Off);
+    builder.on<Tick>(S::Off, S::Warm);
+    builder.on<Tick>(S::Warm, S::Hot);
+    builder.on<Tick>(S::Hot, S::Off);
+    lsm::MachinePool<M> pool(std::move(builder).build_definition());
+    pool.reserve(1000);
+    for (int i = 0; i < 1000; ++i) pool.add();
+    pool.dispatch(7, Input{Tick{}});
+
+    pool.broadcast(Input{Tick{}});
+    assert(pool.state(0) == S::Warm && pool.state(7) == S::Hot);
+    pool.broadcast(Input{Heat{1}}); // unhandled without a hook: nothing changes
+    pool.broadcast(Input{Tick{}});
+    assert(pool.state(0) == S::Hot && pool.state(7) == S::Off);
+    assert(pool.slots().size() == 1000 && pool.contexts().size() == 1000);
+}
+
+// Plain on_value() transitions stay on the table path; the guarded one from
+// Hot still needs the instance's context.
+enum class Cmd { Up, Down, Stop, Noise };
+using V = lsm::Machine<S, Cmd, int, Ctx>;
+
+void value_broadcast() {
+    V::Builder builder;
+    builder.set_initial(S::Off);
+    builder.on_value(S::Off, S::Warm, Cmd::Up);
+    builder.on_value(S::Warm, S::Hot, Cmd::Up);
+    builder.on_value(S::Warm, S::Off, Cmd::Down);
+    builder.on_value(S::Hot, S::Warm, Cmd::Down);
+    builder.on_value(S::Hot, S::Alarm, Cmd::Up, lsm::create_action<Cmd, Ctx>(),
+                     [](const Cmd&, const Ctx& ctx) { return ctx.heat % 2 == 1; });
+    builder.on_any_value(S::Off, Cmd::Stop);
+    const auto def = std::move(builder).build_definition();
+
+    lsm::MachinePool<V> pool(def);
+    std::vector<V> machines;
+    for (int i = 0; i < 8; ++i) {
+        pool.add(Ctx{i, 0, 0, 0});
+        machines.emplace_back(def, Ctx{i, 0, 0, 0});
+    }
+    const std::vector<Cmd> script{Cmd::Up, Cmd::Noise, Cmd::Up, Cmd::Up, Cmd::Down, Cmd::Stop, Cmd::Up, Cmd::Down};
+    for (std::size_t step = 0; step < script.size(); ++step) {
+        pool.dispatch(step % machines.size(), Cmd::Up);
+        machines[step % machines.size()].dispatch(Cmd::Up);
+        pool.broadcast(script[step]);
+        for (auto& m : machines) m.dispatch(script[step]);
+        for (std::size_t i = 0; i < machines.size(); ++i) assert(pool.state(i) == machines[i].state());
+    }
+}
+
+void rejects_deferral() {
+    M::Builder builder;
+    builder.set_initial(S::Off);
+    builder.enable_deferral();
+    builder.on<Tick>(S::Off, S::Warm, lsm::create_action<Input, Ctx>(), nullptr, 0, false, true);
+    const auto def = std::move(builder).build_definition();
+    bool rejected = false;
+    try {
+        lsm::MachinePool<M> pool(def);
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    assert(rejected);
+}
+
+int main() {
+    matches_individual_machines(false);
+    matches_individual_machines(true);
+    trivial_broadcast();
+    value_broadcast();
+    rejects_deferral();
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+
+enum class S { Idle, Stage, Hold, Done };
+struct Job { int id; };
+struct Resume {};
+struct Reset {};
+using Input = std::variant<Job, Resume, Reset>;
+
+struct Ctx {
+    int total = 0;
+    bool hold = true;
+};
+
+using M = lsm::Machine<S, Input, int, Ctx>;
+
+// Idle defers a Job into Stage, whose completion moves on to Hold while
+// ctx.hold is set, so the Job stays queued for Stage until Resume.
+std::shared_ptr<const M::Definition> make_definition(bool extra = false) {
+    M::Builder builder;
+    builder.set_initial(S::Idle);
+    builder.enable_deferral(true);
+    builder.on<Job>(S::Idle, S::Stage, lsm::create_action<Input, Ctx>(), nullptr, 0, false, true);
+    builder.on_completion(S::Stage, S::Hold, lsm::detail::no_action_t{}, false, 0,
+                          [](const Ctx& ctx) { return ctx.hold; });
+    builder.on<Resume>(S::Hold, S::Stage, [](const Resume&, Ctx& ctx) -> std::optional<int> {
+        ctx.hold = false;
+        return std::nullopt;
+    });
+    builder.on<Job>(S::Stage, S::Done, [](const Job& job, Ctx& ctx) -> std::optional<int> {
+        ctx.total += job.id;
+        return job.id;
+    });
+    builder.on<Reset>(S::Done, S::Idle);
+    if (extra) builder.on<Reset>(S::Hold, S::Idle);
+    return std::move(builder).build_definition();
+}
+
+void round_trip() {
+    const auto def = make_definition();
+    M source(def);
+    source.dispatch(Input{Job{5}});
+    assert(source.state() == S::Hold);
+    source.enqueue(Input{Resume{}});
+    source.enqueue(Input{Reset{}});
+
+    const auto blob = source.snapshot();
+
+    M restored(def);
+    const bool ok = restored.restore(blob);
+    assert(ok);
+    assert(restored.state() == S::Hold);
+    assert(restored.context().hold);
+    assert(restored.pending() == 2);
+
+    // Resume re-enters Stage and replays the deferred Job; Reset then returns to Idle.
+    restored.dispatch_all();
+    assert(restored.context().total == 5);
+    assert(restored.state() == S::Idle);
+    assert(restored.pending() == 0);
+}
+
+void rejects_bad_input() {
+    const auto def = make_definition();
+    M source(def);
+    source.dispatch(Input{Job{1}});
+    auto blob = source.snapshot();
+
+    M target(def);
+    target.context().total = 42;
+
+    // Truncated: nothing is applied.
+    const bool truncated = target.restore(std::span<const std::byte>(blob.data(), blob.size() - 1));
+    assert(!truncated);
+    assert(target.state() == S::Idle && target.context().total == 42);
+
+    // Different definition.
+    M other(make_definition(true));
+    const bool mismatched = other.restore(blob);
+    assert(!mismatched);
+    assert(other.state() == S::Idle);
+
+    // Corrupt header.
+    blob[0] = std::byte{0};
+    const bool corrupt = target.restore(blob);
+    assert(!corrupt);
+    assert(target.state() == S::Idle);
+}
+
+// Non-trivial contexts need a codec; deriving from TrivialCodec keeps the
+// byte-wise encoding for states and inputs.
+struct Named {
+    std::string name;
+    int count = 0;
+};
+
+struct NamedCodec : lsm::TrivialCodec {
+    using lsm::TrivialCodec::decode;
+    using lsm::TrivialCodec::encode;
+
+    void encode(lsm::SnapshotWriter& out, const Named& ctx) const {
+        out.put(static_cast<std::uint32_t>(ctx.name.size()));
+        out.bytes(ctx.name.data(), ctx.name.size());
+        out.put(ctx.count);
+    }
+    bool decode(lsm::SnapshotReader& in, Named& ctx) const {
+        std::uint32_t size = 0;
+        if (!in.get(size) || size > in.remaining()) return false;
+        ctx.name.resize(size);
+        return in.bytes(ctx.name.data(), size) && in.get(ctx.count);
+    }
+};
+
+using Ring = lsm::Machine<S, Input, int, Named, lsm::policy::copy, lsm::policy::ReturnOutput<int>,
+                          lsm::policy::ring_queue<4>>;
+
+void custom_codec_back_to_back() {
+    Ring::Builder builder;
+    builder.set_initial(S::Idle);
+    builder.on<Job>(S::Idle, S::Done, [](const Job& job, Named& ctx) -> std::optional<int> {
+        ctx.count += job.id;
+        return std::nullopt;
+    });
+    const auto def = std::move(builder).build_definition();
+
+    Ring a(def, Named{"alpha", 0});
+    Ring b(def, Named{"beta", 0});
+    a.dispatch(Input{Job{3}});
+    b.enqueue(Input{Job{4}});
+    b.enqueue(Input{Job{6}});
+
+    std::vector<std::byte> blob;
+    lsm::SnapshotWriter out(blob);
+    a.snapshot(out, NamedCodec{});
+    b.snapshot(out, NamedCodec{});
+
+    Ring ra(def);
+    Ring rb(def);
+    lsm::SnapshotReader in(blob);
+    const bool first = ra.restore(in, NamedCodec{});
+    const bool second = rb.restore(in, NamedCodec{});
+    assert(first && second);
+    assert(in.remaining() == 0);
+
+    assert(ra.state() == S::Done && ra.context().name == "alpha" && ra.context().count == 3);
+    assert(rb.state() == S::Idle && rb.context().name == "beta" && rb.pending() == 2);
+    rb.dispatch_all();
+    assert(rb.state() == S::Done && rb.context().count == 4);
+}
+
+int main() {
+    round_trip();
+    rejects_bad_input();
+    custom_codec_back_to_back();
+    return 0;
+}
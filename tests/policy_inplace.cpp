@@ -0,0 +1,118 @@
+#include <array>
+#include <cassert>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+
+enum class S { Idle, Armed, Done };
+struct Arm
+{
+    friend bool operator==(const Arm&, const Arm&) noexcept { return true; }
+};
+struct Fire
+{
+    int power{};
+    friend bool operator==(const Fire&, const Fire&) noexcept = default;
+};
+using Input = std::variant<Arm, Fire, int>;
+using Output = int;
+
+struct Ctx
+{
+    int value = 0;
+    std::vector<std::string> log;
+};
+
+using Inplace = lsm::policy::inplace<32>;
+using M = lsm::Machine<S, Input, Output, Ctx, Inplace>;
+
+static_assert(lsm::PolicyHasCallableTemplate<Inplace>);
+static_assert(std::is_same_v<M::Guard, lsm::detail::InplaceFunction<bool(const Input&, const Ctx&), 32>>);
+static_assert(!std::is_copy_constructible_v<M::Action>);
+static_assert(std::is_nothrow_move_constructible_v<M::Action>);
+
+static int twice(int v)
+{
+    return v * 2;
+}
+
+static void test_inplace_function()
+{
+    lsm::detail::InplaceFunction<int(int), 16> fn;
+    assert(!fn);
+
+    fn = twice;
+    assert(fn && fn(4) == 8);
+
+    int (*null_fn)(int) = nullptr;
+    lsm::detail::InplaceFunction<int(int), 16> empty(null_fn);
+    assert(!empty);
+
+    auto owned = std::make_shared<int>(3);
+    lsm::detail::InplaceFunction<int(int), 16> capture([owned](int v) { return v + *owned; });
+    assert(owned.use_count() == 2);
+    assert(capture(1) == 4);
+
+    auto moved = std::move(capture);
+    assert(!capture);
+    assert(moved(2) == 5);
+    assert(owned.use_count() == 2);
+
+    moved = nullptr;
+    assert(!moved);
+    assert(owned.use_count() == 1);
+}
+
+static void test_machine_with_inplace_callables()
+{
+    M::Builder builder;
+    builder.set_initial(S::Idle)
+        .on_enter(S::Armed, [](Ctx& ctx, const S&, const S&, const Input*) { ctx.log.push_back("armed"); })
+        .on_unhandled([](Ctx& ctx, const S&, const Input&) { ctx.log.push_back("unhandled"); });
+
+    const std::array<int, 3> bonus{1, 2, 3};
+    builder.on<Arm>(S::Idle, S::Armed);
+    builder.from(S::Armed)
+        .on<Fire>()
+        .guard([](const Input& in, const Ctx&) { return std::get<Fire>(in).power > 2; })
+        .action([bonus](const Fire& f, Ctx& ctx) -> std::optional<Output> {
+            ctx.value = f.power + bonus[2];
+            return ctx.value;
+        })
+        .to(S::Done);
+    builder.from(S::Done)
+        .on_value(Input{7})
+        .guard([](const Input&, const Ctx& ctx) { return ctx.value > 0; })
+        .to(S::Idle);
+    builder.on_completion(S::Idle, S::Idle, [](Ctx&) -> std::optional<Output> { return std::nullopt; }, true, 0,
+                          M::CompletionGuard{[](const Ctx& ctx) { return ctx.value < 0; }});
+
+    auto machine = std::move(builder).build({});
+    machine.dispatch(Input{Arm{}});
+    assert(machine.state() == S::Armed);
+
+    const auto rejected = machine.dispatch(Input{Fire{1}});
+    assert(!rejected);
+    auto out = machine.dispatch(Input{Fire{5}});
+    assert(out && *out == 8);
+    assert(machine.state() == S::Done);
+
+    machine.dispatch(Input{6});
+    assert(machine.state() == S::Done);
+    machine.dispatch(Input{7});
+    assert(machine.state() == S::Idle);
+
+    assert((machine.context().log == std::vector<std::string>{"armed", "unhandled", "unhandled"}));
+}
+
+int main()
+{
+    test_inplace_function();
+    test_machine_with_inplace_callables();
+    return 0;
+}
@@ -60,7 +60,7 @@ int main() {
     adapter.bind_async(S::Idle, S::Next, std::move(async_action));
     auto task = adapter.dispatch_async(Input{Kick{}});
     while (!task.await_ready()) {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
     auto async_out = task.await_resume();
     assert(async_out && *async_out == 9);
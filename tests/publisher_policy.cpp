@@ -60,7 +60,7 @@ int main() {
 
     auto task = adapter.dispatch_async(Input{Emit{0}});
     while (!task.await_ready()) {
-        task.await_suspend(std::noop_coroutine());
+        task.await_suspend(std::noop_coroutine()).resume();
     }
     auto out = task.await_resume();
     assert(!out);
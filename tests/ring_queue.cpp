@@ -0,0 +1,195 @@
+#include <cassert>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+
+static void test_growable_ring()
+{
+    lsm::detail::RingQueue<std::string> queue;
+    assert(queue.empty() && queue.capacity() == 0);
+
+    for(int i = 0; i < 20; ++i)
+    {
+        const bool pushed = queue.push_back(std::to_string(i));
+        assert(pushed);
+        if(i % 3 == 0)
+        {
+            queue.pop_front();
+        }
+    }
+    assert(queue.size() == 13);
+    assert(queue.capacity() == 16);
+    assert(queue.front() == "7");
+
+    auto copy = queue;
+    auto moved = std::move(queue);
+    assert(queue.empty());
+    assert(copy.size() == 13 && moved.size() == 13);
+    assert(copy.front() == moved.front());
+}
+
+static void test_fixed_ring_overflow()
+{
+    lsm::detail::RingQueue<int, 4, lsm::policy::overflow::reject> reject;
+    for(int i = 0; i < 4; ++i)
+    {
+        const bool pushed = reject.push_back(i);
+        assert(pushed);
+    }
+    const bool overflowed = reject.push_back(4);
+    assert(!overflowed);
+    assert(reject.size() == 4 && reject.front() == 0);
+
+    lsm::detail::RingQueue<int, 4, lsm::policy::overflow::drop_oldest> drop;
+    for(int i = 0; i < 6; ++i)
+    {
+        const bool pushed = drop.push_back(i);
+        assert(pushed);
+    }
+    assert(drop.size() == 4 && drop.front() == 2);
+
+    auto owned = std::make_shared<int>(1);
+    {
+        lsm::detail::RingQueue<std::shared_ptr<int>, 2, lsm::policy::overflow::drop_oldest> ptrs;
+        ptrs.push_back(owned);
+        ptrs.push_back(owned);
+        ptrs.push_back(owned);
+        assert(owned.use_count() == 3);
+    }
+    assert(owned.use_count() == 1);
+}
+
+enum class S { Idle, Busy };
+struct Job
+{
+    int id{};
+};
+using Input = std::variant<Job>;
+using Output = int;
+struct Ctx
+{
+};
+
+template <class QueuePolicy>
+using M = lsm::Machine<S, Input, Output, Ctx, lsm::policy::copy, lsm::policy::ReturnOutput<Output>, QueuePolicy>;
+
+// The first job is deferred from Idle into Busy and replayed there; later jobs
+// are handled by Busy directly.
+template <class Machine>
+static Machine make_machine()
+{
+    typename Machine::Builder builder;
+    builder.set_initial(S::Idle).enable_deferral(true);
+    builder.from(S::Idle).template on<Job>().defer(true).to(S::Busy);
+    builder.template on<Job>(S::Busy, S::Busy, [](const Job& job, Ctx&) -> std::optional<Output> { return job.id; });
+    return std::move(builder).build({});
+}
+
+static void test_machine_fixed_queue()
+{
+    auto machine = make_machine<M<lsm::policy::ring_queue<4>>>();
+    for(int i = 0; i < 4; ++i)
+    {
+        const bool queued = machine.enqueue(Input{Job{i}});
+        assert(queued);
+    }
+    const bool overflowed = machine.enqueue(Input{Job{99}});
+    assert(!overflowed);
+    assert(machine.pending() == 4);
+
+    std::vector<Output> outputs;
+    machine.dispatch_all([&](Output&& out) { outputs.push_back(out); });
+    assert((outputs == std::vector<Output>{1, 2, 3}));
+    assert(machine.state() == S::Busy);
+    const bool requeued = machine.enqueue(Input{Job{4}});
+    assert(requeued);
+}
+
+static void test_machine_drop_oldest_queue()
+{
+    auto machine = make_machine<M<lsm::policy::ring_queue<2, lsm::policy::overflow::drop_oldest>>>();
+    machine.enqueue(Input{Job{1}});
+    machine.enqueue(Input{Job{2}});
+    const bool queued = machine.enqueue(Input{Job{3}});
+    assert(queued);
+
+    auto outputs = machine.dispatch_all();
+    assert((outputs == std::vector<Output>{3}));
+}
+
+static void test_machine_growable_queue()
+{
+    auto machine = make_machine<M<lsm::policy::ring_queue<>>>();
+    for(int i = 0; i < 100; ++i)
+    {
+        machine.enqueue(Input{Job{i}});
+    }
+    auto outputs = machine.dispatch_all();
+    assert(outputs.size() == 99);
+    assert(outputs.front() == 1 && outputs.back() == 99);
+}
+
+// Jobs are deferred into Parked, whose completion returns to Idle until
+// Release, so they pile up in Parked's fixed deferral ring. The third does not
+// fit: it is reported as unhandled and the transition is not taken.
+enum class Lot { Idle, Parked };
+struct Release
+{
+};
+using LotInput = std::variant<Job, Release>;
+struct LotCtx
+{
+    bool parking = true;
+    int unhandled = 0;
+    std::vector<int> handled;
+};
+using LotMachine = lsm::Machine<Lot, LotInput, Output, LotCtx, lsm::policy::copy, lsm::policy::ReturnOutput<Output>,
+                                lsm::policy::ring_queue<2>>;
+
+static void test_full_deferral_ring()
+{
+    LotMachine::Builder builder;
+    builder.set_initial(Lot::Idle).enable_deferral(true);
+    builder.from(Lot::Idle).on<Job>().defer(true).to(Lot::Parked);
+    builder.on<Release>(Lot::Idle, Lot::Parked, [](const Release&, LotCtx& ctx) -> std::optional<Output> {
+        ctx.parking = false;
+        return std::nullopt;
+    });
+    builder.on<Job>(Lot::Parked, Lot::Parked, [](const Job& job, LotCtx& ctx) -> std::optional<Output> {
+        ctx.handled.push_back(job.id);
+        return job.id;
+    });
+    builder.completion(Lot::Parked).guard([](const LotCtx& ctx) { return ctx.parking; }).to(Lot::Idle);
+    builder.on_unhandled([](LotCtx& ctx, const Lot&, const LotInput&) { ++ctx.unhandled; });
+    auto machine = std::move(builder).build({});
+
+    for(int i = 1; i <= 3; ++i) machine.dispatch(LotInput{Job{i}});
+    assert(machine.state() == Lot::Idle);
+    assert(machine.context().unhandled == 1);
+
+    const auto selection = machine.select(LotInput{Job{4}});
+    assert(selection && selection.deferred());
+    const LotInput rejected{Job{4}};
+    const auto out = machine.commit(selection, &rejected);
+    assert(!out && machine.context().unhandled == 2);
+
+    machine.dispatch(LotInput{Release{}});
+    assert(machine.state() == Lot::Parked);
+    assert((machine.context().handled == std::vector<int>{1, 2}));
+}
+
+int main()
+{
+    test_growable_ring();
+    test_fixed_ring_overflow();
+    test_machine_fixed_queue();
+    test_machine_drop_oldest_queue();
+    test_machine_growable_queue();
+    test_full_deferral_ring();
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+#include <lsm/runtime.hpp>
+
+enum class S { Running, Stopped };
+struct Bump
+{
+    int amount{};
+};
+struct Stop {};
+
+using Input = std::variant<Bump, Stop>;
+using Output = int;
+
+struct Ctx
+{
+    long long total = 0;
+    std::shared_ptr<std::atomic<bool>> busy = std::make_shared<std::atomic<bool>>(false);
+    std::shared_ptr<std::atomic<int>> overlaps;
+};
+
+using M = lsm::Machine<S, Input, Output, Ctx>;
+
+static M make_machine(std::shared_ptr<std::atomic<int>> overlaps)
+{
+    M::Builder builder;
+    builder.set_initial(S::Running);
+    builder.on<Bump>(S::Running, S::Running, [](const Bump& bump, Ctx& ctx) -> std::optional<Output> {
+        if(ctx.busy->exchange(true)) ctx.overlaps->fetch_add(1);
+        ctx.total += bump.amount;
+        std::this_thread::yield();
+        ctx.busy->store(false);
+        return std::nullopt;
+    });
+    builder.on<Stop>(S::Running, S::Stopped, [](const Stop&, Ctx& ctx) -> std::optional<Output> {
+        return static_cast<Output>(ctx.total);
+    });
+    Ctx ctx;
+    ctx.overlaps = std::move(overlaps);
+    return std::move(builder).build(std::move(ctx));
+}
+
+static void test_actors_across_workers()
+{
+    constexpr int actors = 64;
+    constexpr int producers = 3;
+    constexpr int per_producer = 200;
+
+    auto overlaps = std::make_shared<std::atomic<int>>(0);
+    std::atomic<long long> stopped_sum{0};
+
+    lsm::runtime::Executor executor(4);
+    assert(executor.worker_count() == 4);
+
+    std::vector<std::unique_ptr<lsm::runtime::Actor<M>>> pool;
+    for(int i = 0; i < actors; ++i)
+    {
+        pool.push_back(std::make_unique<lsm::runtime::Actor<M>>(
+            executor, make_machine(overlaps),
+            [&stopped_sum](Output&& out) { stopped_sum.fetch_add(out); },
+            lsm::DrainLimit{8}));
+    }
+
+    std::vector<std::thread> threads;
+    for(int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&] {
+            for(int i = 0; i < per_producer; ++i)
+            {
+                for(auto& actor : pool) actor->post(Input{Bump{1}});
+            }
+        });
+    }
+    for(auto& t : threads) t.join();
+    executor.wait_idle();
+
+    for(auto& actor : pool)
+    {
+        assert(actor->machine().context().total == producers * per_producer);
+        actor->post(Input{Stop{}});
+    }
+    executor.wait_idle();
+
+    assert(overlaps->load() == 0);
+    assert(stopped_sum.load() == static_cast<long long>(actors) * producers * per_producer);
+    for(auto& actor : pool) assert(actor->machine().state() == S::Stopped);
+}
+
+struct Counter final : lsm::runtime::Runnable
+{
+    lsm::runtime::Executor* executor = nullptr;
+    std::atomic<int> runs{0};
+    int respawn = 0;
+
+    void run() override
+    {
+        runs.fetch_add(1);
+        if(respawn-- > 0) executor->submit(*this);
+    }
+};
+
+static void test_resubmission_from_worker()
+{
+    lsm::runtime::Executor executor(2);
+    Counter counter;
+    counter.executor = &executor;
+    counter.respawn = 10;
+    executor.submit(counter);
+    executor.wait_idle();
+    assert(counter.runs.load() == 11);
+}
+
+int main()
+{
+    test_actors_across_workers();
+    test_resubmission_from_worker();
+    return 0;
+}
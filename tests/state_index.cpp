@@ -0,0 +1,118 @@
+#include <cassert>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+
+enum class Dense { A, B, C };
+enum class Signed : int { Low = -3, Mid = 0, High = 4 };
+enum class Sparse : unsigned { First = 1, Far = 1u << 20, Farther = 1u << 30 };
+
+struct Go {};
+struct Back {};
+
+using Input = std::variant<Go, Back>;
+
+static void test_dense_index()
+{
+    lsm::detail::StateIndex<Dense> index({Dense::C, Dense::A});
+    assert(index.dense());
+    assert(index.size() == 3);
+    assert(index.find(Dense::A) == 0);
+    assert(index.find(Dense::B) == 1);
+    assert(index.find(Dense::C) == 2);
+
+    lsm::detail::StateIndex<Signed> signed_index({Signed::High, Signed::Low, Signed::Mid});
+    assert(signed_index.dense());
+    assert(signed_index.size() == 8);
+    assert(signed_index.find(Signed::Low) == 0);
+    assert(signed_index.find(Signed::Mid) == 3);
+    assert(signed_index.find(Signed::High) == 7);
+    assert(signed_index.find(static_cast<Signed>(9)) == lsm::detail::StateIndex<Signed>::npos);
+    assert(signed_index.find(static_cast<Signed>(-4)) == lsm::detail::StateIndex<Signed>::npos);
+}
+
+static void test_hashed_fallback()
+{
+    lsm::detail::StateIndex<Sparse> sparse({Sparse::First, Sparse::Far, Sparse::Farther});
+    assert(!sparse.dense());
+    assert(sparse.size() == 3);
+    assert(sparse.find(Sparse::Far) != lsm::detail::StateIndex<Sparse>::npos);
+    assert(sparse.find(static_cast<Sparse>(2)) == lsm::detail::StateIndex<Sparse>::npos);
+
+    lsm::detail::StateIndex<std::string> names({"idle", "busy", "idle"});
+    assert(!names.dense());
+    assert(names.size() == 2);
+    assert(names.find("idle") != names.find("busy"));
+    assert(names.find("gone") == lsm::detail::StateIndex<std::string>::npos);
+}
+
+struct Ctx
+{
+    std::vector<std::string> log;
+};
+
+static void test_sparse_machine()
+{
+    using M = lsm::Machine<Sparse, Input, int, Ctx>;
+    M::Builder builder;
+    builder.set_initial(Sparse::First)
+        .on_exit(Sparse::First, [](Ctx& ctx, const Sparse&, const Sparse&, const Input*) {
+            ctx.log.push_back("exit-first");
+        })
+        .on_enter(Sparse::Farther, [](Ctx& ctx, const Sparse&, const Sparse&, const Input*) {
+            ctx.log.push_back("enter-farther");
+        });
+    builder.on<Go>(Sparse::First, Sparse::Far);
+    builder.on_completion(Sparse::Far, Sparse::Farther,
+                          [](Ctx&) -> std::optional<int> { return 7; });
+    builder.on<Back>(Sparse::Farther, Sparse::First);
+
+    auto machine = std::move(builder).build({});
+    assert(!machine.state_index().dense());
+
+    auto out = machine.dispatch(Input{Go{}});
+    assert(out && *out == 7);
+    assert(machine.state() == Sparse::Farther);
+    assert((machine.context().log == std::vector<std::string>{"exit-first", "enter-farther"}));
+
+    machine.dispatch(Input{Back{}});
+    assert(machine.state() == Sparse::First);
+}
+
+static void test_string_machine()
+{
+    using M = lsm::Machine<std::string, Input, int, Ctx>;
+    M::Builder builder;
+    builder.set_initial("idle")
+        .on_unhandled("busy", [](Ctx& ctx, const std::string& s, const Input&) {
+            ctx.log.push_back("unhandled-" + s);
+        });
+    builder.on<Go>("idle", "busy");
+    builder.on<Back>("busy", "idle");
+
+    auto machine = std::move(builder).build({});
+    machine.dispatch(Input{Go{}});
+    assert(machine.state() == "busy");
+    machine.dispatch(Input{Go{}});
+    assert(machine.context().log.size() == 1 && machine.context().log[0] == "unhandled-busy");
+
+    machine.set_state_direct("elsewhere");
+    const auto ignored = machine.dispatch(Input{Back{}});
+    assert(!ignored);
+    assert(machine.state() == "elsewhere");
+    machine.set_state_direct("busy");
+    machine.dispatch(Input{Back{}});
+    assert(machine.state() == "idle");
+}
+
+int main()
+{
+    test_dense_index();
+    test_hashed_fallback();
+    test_sparse_machine();
+    test_string_machine();
+    return 0;
+}
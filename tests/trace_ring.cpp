@@ -0,0 +1,141 @@
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include <lsm/core.hpp>
+#include <lsm/trace.hpp>
+
+enum class S { Locked, Unlocked, Alarm };
+struct Coin {};
+struct Push {};
+struct Kick {};
+using Input = std::variant<Coin, Push, Kick>;
+using Output = int;
+using Machine = lsm::Machine<S, Input, Output>;
+
+static Machine make_machine()
+{
+    Machine::Builder builder;
+    builder.set_initial(S::Locked);
+    builder.from(S::Locked)
+        .on<Coin>()
+        .action([](const Coin&, std::monostate&) -> std::optional<Output> { return 1; })
+        .to(S::Unlocked);
+    builder.on<Push>(S::Unlocked, S::Locked);
+    builder.on<Kick>(S::Locked, S::Alarm);
+    builder.completion(S::Alarm).to(S::Locked);
+    return std::move(builder).build({});
+}
+
+static void test_ring_wraps()
+{
+    lsm::trace::Ring ring(3);
+    assert(ring.capacity() == 4);
+    for(std::uint32_t i = 0; i < 6; ++i)
+    {
+        lsm::trace::Record record{};
+        record.id = i;
+        ring.write(record);
+    }
+    assert(ring.written() == 6 && ring.size() == 4);
+    const auto records = ring.records();
+    assert(records.size() == 4 && records.front().id == 2 && records.back().id == 5);
+    ring.clear();
+    assert(ring.size() == 0 && ring.records().empty());
+}
+
+static void test_machine_writes_records()
+{
+    auto machine = make_machine();
+    lsm::trace::Ring ring(16);
+    machine.set_trace(&ring, 7);
+    const auto& index = machine.state_index();
+
+    machine.dispatch(Input{Coin{}});
+    machine.dispatch(Input{Push{}});
+    machine.dispatch(Input{Coin{}});
+    machine.dispatch(Input{Push{}});
+    machine.dispatch(Input{Kick{}});
+    machine.dispatch(Input{Push{}}); // unhandled, not traced
+
+    const auto records = ring.records();
+    assert(records.size() == 6);
+    const auto& coin = records[0];
+    assert(coin.source == 7);
+    assert(coin.from == index.find(S::Locked) && coin.to == index.find(S::Unlocked));
+    assert(coin.input == 0 && (coin.flags & lsm::trace::Record::output));
+    assert(!(records[1].flags & lsm::trace::Record::output) && records[1].input == 1);
+
+    const auto& kick = records[4];
+    assert(kick.to == index.find(S::Alarm) && kick.input == 2);
+    const auto& completion = records[5];
+    assert((completion.flags & lsm::trace::Record::completion) && completion.id == 0);
+    assert(completion.input == lsm::trace::Record::no_input);
+    assert(completion.from == index.find(S::Alarm) && completion.to == index.find(S::Locked));
+    for(std::size_t i = 1; i < records.size(); ++i) assert(records[i - 1].timestamp <= records[i].timestamp);
+
+    machine.set_trace(nullptr);
+    machine.dispatch(Input{Coin{}});
+    assert(ring.written() == 6);
+}
+
+static void test_dump_round_trip_and_chrome_json()
+{
+    auto machine = make_machine();
+    auto& ring = lsm::trace::thread_ring();
+    ring.clear();
+    machine.set_trace(&ring, 3);
+    machine.dispatch(Input{Coin{}});
+    machine.dispatch(Input{Push{}});
+
+    const auto& index = machine.state_index();
+    std::vector<std::string_view> names(index.size());
+    names[index.find(S::Locked)] = "Locked";
+    names[index.find(S::Unlocked)] = "Unlocked";
+    names[index.find(S::Alarm)] = "Alarm";
+
+    std::stringstream bytes;
+    lsm::trace::write_dump(bytes, ring, names);
+    auto dump = lsm::trace::read_dump(bytes);
+    assert(dump);
+    assert(dump->records.size() == 2);
+    assert(dump->records[1].timestamp == ring.records()[1].timestamp);
+    assert(dump->state_names.size() == index.size() && dump->state_names[index.find(S::Unlocked)] == "Unlocked");
+
+    std::ostringstream json;
+    lsm::trace::write_chrome_json(json, *dump);
+    const auto text = json.str();
+    assert(text.starts_with("{\"traceEvents\":[") && text.ends_with("]}"));
+    assert(text.find("\"name\":\"Locked -> Unlocked\"") != std::string::npos);
+    assert(text.find("\"ph\":\"X\",\"pid\":0,\"tid\":3,\"name\":\"Unlocked\"") != std::string::npos);
+    assert(text.find("\"output\":true") != std::string::npos);
+
+    std::stringstream garbage("not a dump");
+    const auto rejected = lsm::trace::read_dump(garbage);
+    assert(!rejected);
+
+    // A header claiming far more records than follow is rejected without
+    // allocating for the claimed count.
+    std::stringstream truncated;
+    lsm::trace::write_dump(truncated, ring, names);
+    auto image = truncated.str();
+    const std::uint64_t huge = std::uint64_t{1} << 60;
+    image.replace(sizeof(lsm::trace::dump_magic) + 2 * sizeof(std::uint32_t), sizeof(huge), reinterpret_cast<const char*>(&huge), sizeof(huge));
+    std::stringstream corrupt(image);
+    const auto partial = lsm::trace::read_dump(corrupt);
+    assert(!partial);
+    machine.set_trace(nullptr);
+}
+
+int main()
+{
+    test_ring_wraps();
+    test_machine_writes_records();
+    test_dump_round_trip_and_chrome_json();
+    return 0;
+}
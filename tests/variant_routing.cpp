@@ -0,0 +1,142 @@
+#include <cassert>
+#include <optional>
+#include <string>
+#include <variant>
+
+#include <lsm/core.hpp>
+
+enum class S { Idle, Busy, Done };
+
+template <int N>
+struct Ev
+{
+    friend bool operator==(const Ev&, const Ev&) noexcept { return true; }
+};
+
+struct Code
+{
+    int value{};
+    friend bool operator==(const Code&, const Code&) noexcept = default;
+};
+
+using Input = std::variant<Ev<0>, Ev<1>, Ev<2>, Ev<3>, Ev<4>, Ev<5>, Ev<6>, Ev<7>, Code>;
+using Output = std::string;
+
+struct Ctx
+{
+    int guard_calls = 0;
+};
+
+using M = lsm::Machine<S, Input, Output, Ctx>;
+
+static_assert(lsm::detail::variant_index_v<Ev<3>, Input> == 3);
+static_assert(lsm::detail::variant_index_v<Code, Input> == 8);
+static_assert(lsm::detail::variant_index_v<int, Input> == lsm::detail::unrouted);
+
+template <int N>
+static auto counting_guard()
+{
+    return [](const Input&, const Ctx& ctx) {
+        ++const_cast<Ctx&>(ctx).guard_calls;
+        return true;
+    };
+}
+
+template <int N>
+static auto tag()
+{
+    return [](const Ev<N>&, Ctx&) -> std::optional<Output> { return std::to_string(N); };
+}
+
+static void test_only_matching_alternative_is_evaluated()
+{
+    M::Builder builder;
+    builder.set_initial(S::Idle);
+    builder.on<Ev<0>>(S::Idle, S::Idle, tag<0>(), counting_guard<0>());
+    builder.on<Ev<1>>(S::Idle, S::Idle, tag<1>(), counting_guard<1>());
+    builder.on<Ev<2>>(S::Idle, S::Idle, tag<2>(), counting_guard<2>());
+    builder.on<Ev<3>>(S::Idle, S::Idle, tag<3>(), counting_guard<3>());
+    builder.on<Ev<4>>(S::Idle, S::Idle, tag<4>(), counting_guard<4>());
+    builder.on<Ev<5>>(S::Idle, S::Idle, tag<5>(), counting_guard<5>());
+    builder.on<Ev<6>>(S::Idle, S::Idle, tag<6>(), counting_guard<6>());
+    builder.on<Ev<7>>(S::Idle, S::Busy, tag<7>(), counting_guard<7>());
+
+    auto machine = std::move(builder).build({});
+    auto out = machine.dispatch(Input{Ev<7>{}});
+    assert(out && *out == "7");
+    assert(machine.state() == S::Busy);
+    assert(machine.context().guard_calls == 1);
+
+    machine.set_state_direct(S::Idle);
+    out = machine.dispatch(Input{Ev<4>{}});
+    assert(out && *out == "4");
+    assert(machine.context().guard_calls == 2);
+
+    const auto unmatched = machine.dispatch(Input{Code{1}});
+    assert(!unmatched);
+    assert(machine.context().guard_calls == 2);
+}
+
+static void test_unrouted_transitions_keep_priority_order()
+{
+    M::Builder builder;
+    builder.set_initial(S::Idle);
+
+    M::Transition catch_all;
+    catch_all.from = S::Idle;
+    catch_all.to = S::Done;
+    catch_all.priority = 5;
+    catch_all.guard = [](const Input& in, const Ctx&) { return std::holds_alternative<Ev<2>>(in); };
+    catch_all.action = [](const Input&, Ctx&) -> std::optional<Output> { return Output{"catch-all"}; };
+    builder.add_transition(std::move(catch_all));
+
+    builder.from(S::Idle).on<Ev<2>>().priority(9).guard([](const Input&, const Ctx& ctx) { return ctx.guard_calls > 0; }).action(tag<2>()).to(S::Busy);
+    builder.from(S::Idle).on<Ev<2>>().priority(1).action(tag<2>()).to(S::Idle);
+
+    auto machine = std::move(builder).build({});
+    auto out = machine.dispatch(Input{Ev<2>{}});
+    assert(out && *out == "catch-all");
+    assert(machine.state() == S::Done);
+
+    machine.set_state_direct(S::Idle);
+    machine.context().guard_calls = 1;
+    out = machine.dispatch(Input{Ev<2>{}});
+    assert(out && *out == "2");
+    assert(machine.state() == S::Busy);
+}
+
+static void test_value_and_any_routes()
+{
+    M::Builder builder;
+    builder.set_initial(S::Idle);
+    builder.on_value(S::Idle, S::Busy, Input{Code{42}},
+                     [](const Input&, Ctx&) -> std::optional<Output> { return Output{"code"}; });
+    builder.any().on<Ev<0>>().action(tag<0>()).to(S::Done);
+    builder.any().on_value(Input{Code{7}}).to(S::Idle);
+
+    auto machine = std::move(builder).build({});
+    const auto unmatched = machine.dispatch(Input{Code{1}});
+    assert(!unmatched);
+    assert(machine.state() == S::Idle);
+
+    auto out = machine.dispatch(Input{Code{42}});
+    assert(out && *out == "code");
+    assert(machine.state() == S::Busy);
+
+    const auto unrouted = machine.dispatch(Input{Ev<1>{}});
+    assert(!unrouted);
+    out = machine.dispatch(Input{Ev<0>{}});
+    assert(out && *out == "0");
+    assert(machine.state() == S::Done);
+
+    machine.dispatch(Input{Code{7}});
+    assert(machine.state() == S::Idle);
+}
+
+int main()
+{
+    test_only_matching_alternative_is_evaluated();
+    test_unrouted_transitions_keep_priority_order();
+    test_value_and_any_routes();
+    return 0;
+}